@@ -0,0 +1,99 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   BitDepth.h
+ *
+ * Pixel types of the histogram data buffers and dispatch of templated kernels
+ */
+
+#ifndef BITDEPTH_H
+#define	BITDEPTH_H
+
+#include <stdint.h>
+#include <utility>
+
+// The scTDC pipes write unsigned counts of 8, 16, 32 or 64 bit per pixel
+// (depth in bits, see GeneralHistogram::depth). Kernels that work on the data
+// buffers are written as class templates with a static Run function over the
+// pixel type(s) and called via DispatchBitDepth / DispatchBitDepths.
+
+inline bool IsSupportedBitDepth(long depth) {
+    return depth==8 || depth==16 || depth==32 || depth==64;
+}
+
+// values above INT32_MAX (Tango::DevLong) are clipped
+template<typename T>
+inline int32_t SaturatedInt32(T v) {
+    return (uint64_t) v > (uint64_t) INT32_MAX ? INT32_MAX : (int32_t) v;
+}
+
+template<typename T>
+inline uint32_t SaturatedUInt32(T v) {
+    return (uint64_t) v > (uint64_t) UINT32_MAX ? UINT32_MAX : (uint32_t) v;
+}
+
+/**
+ * calls Kernel<T>::Run(args...) with the pixel type T of the bit depth
+ * @return the return value of Run, -1 if the bit depth is not supported
+ */
+template<template<typename> class Kernel, typename... Args>
+int DispatchBitDepth(long depth, Args&&... args) {
+    switch (depth) {
+        case 8:  return Kernel<uint8_t>::Run(std::forward<Args>(args)...);
+        case 16: return Kernel<uint16_t>::Run(std::forward<Args>(args)...);
+        case 32: return Kernel<uint32_t>::Run(std::forward<Args>(args)...);
+        case 64: return Kernel<uint64_t>::Run(std::forward<Args>(args)...);
+        default: return -1;
+    }
+}
+
+template<template<typename, typename> class Kernel, typename S, typename... Args>
+int _DispatchTargetBitDepth(long depth, Args&&... args) {
+    switch (depth) {
+        case 8:  return Kernel<S, uint8_t>::Run(std::forward<Args>(args)...);
+        case 16: return Kernel<S, uint16_t>::Run(std::forward<Args>(args)...);
+        case 32: return Kernel<S, uint32_t>::Run(std::forward<Args>(args)...);
+        case 64: return Kernel<S, uint64_t>::Run(std::forward<Args>(args)...);
+        default: return -1;
+    }
+}
+
+/**
+ * calls Kernel<S, D>::Run(args...) with the pixel types S and D of the
+ * source and the destination bit depth
+ * @return the return value of Run, -1 if a bit depth is not supported
+ */
+template<template<typename, typename> class Kernel, typename... Args>
+int DispatchBitDepths(long src_depth, long dst_depth, Args&&... args) {
+    switch (src_depth) {
+        case 8:  return _DispatchTargetBitDepth<Kernel, uint8_t>(dst_depth, std::forward<Args>(args)...);
+        case 16: return _DispatchTargetBitDepth<Kernel, uint16_t>(dst_depth, std::forward<Args>(args)...);
+        case 32: return _DispatchTargetBitDepth<Kernel, uint32_t>(dst_depth, std::forward<Args>(args)...);
+        case 64: return _DispatchTargetBitDepth<Kernel, uint64_t>(dst_depth, std::forward<Args>(args)...);
+        default: return -1;
+    }
+}
+
+#endif	/* BITDEPTH_H */
@@ -0,0 +1,532 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "BufferKernels.h"
+#include <string.h>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BUFFERKERNELS_X86
+#endif
+
+namespace BufferKernels {
+
+    // #########################################################################
+    // scalar implementations (also used for the remainders of the SIMD loops)
+    // #########################################################################
+
+    static inline int32_t _sat(uint32_t v) {
+        return v>(uint32_t)INT32_MAX ? INT32_MAX : (int32_t) v;
+    }
+
+    static void copy_sat_scalar(const uint32_t* src, int32_t* dst, long n) {
+        for (long i=0; i<n; i++)
+            dst[i] = _sat(src[i]);
+    }
+
+    static void add_int32_scalar(const uint32_t* src, const int32_t* in, int32_t* dst, long n) {
+        if (in==NULL) {
+            copy_sat_scalar(src, dst, n);
+            return;
+        }
+        for (long i=0; i<n; i++)
+            dst[i] = (int32_t) ((uint32_t) in[i] + (uint32_t) _sat(src[i])); // wraps like a plain DevLong addition
+    }
+
+    static uint64_t sum_scalar(const uint32_t* src, long n) {
+        uint64_t sum = 0;
+        for (long i=0; i<n; i++)
+            sum += src[i];
+        return sum;
+    }
+
+    static void minmax_scalar(const uint32_t* src, long n, uint32_t& min, uint32_t& max) {
+        uint32_t mn = UINT32_MAX;
+        uint32_t mx = 0;
+        for (long i=0; i<n; i++) {
+            mn = src[i]<mn ? src[i] : mn;
+            mx = src[i]>mx ? src[i] : mx;
+        }
+        min = mn;
+        max = mx;
+    }
+
+    static uint32_t max_scalar(const uint32_t* src, long n) {
+        uint32_t mx = 0;
+        for (long i=0; i<n; i++)
+            mx = src[i]>mx ? src[i] : mx;
+        return mx;
+    }
+
+    static void scale_scalar(const uint32_t* src, long n, uint32_t whiteval, uint64_t scale, uint8_t* out) {
+        for (long i=0; i<n; i++) {
+            uint32_t v = src[i];
+            if (v>=whiteval) {
+                out[i] = 255;
+                continue;
+            }
+            uint64_t q = (v*scale) >> 32;
+            if (q*whiteval>(uint64_t) v*255) q--; // see scale_uint32_to_uint8
+            out[i] = (uint8_t) q;
+        }
+    }
+
+    static void byteswap32_scalar(const uint32_t* src, uint32_t* dst, long n) {
+        for (long i=0; i<n; i++)
+            dst[i] = __builtin_bswap32(src[i]);
+    }
+
+#ifdef BUFFERKERNELS_X86
+    // #########################################################################
+    // SSE2 (always available on x86-64), unsigned comparisons are done on
+    // values with flipped sign bits
+    // #########################################################################
+
+    static void copy_sat_sse2(const uint32_t* src, int32_t* dst, long n) {
+        const __m128i m7f = _mm_set1_epi32(INT32_MAX);
+        long i = 0;
+        for (; i+4<=n; i+=4) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src+i));
+            __m128i m = _mm_srai_epi32(v, 31); // all ones where the value exceeds INT32_MAX
+            v = _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, m7f));
+            _mm_storeu_si128((__m128i*) (dst+i), v);
+        }
+        copy_sat_scalar(src+i, dst+i, n-i);
+    }
+
+    static void add_int32_sse2(const uint32_t* src, const int32_t* in, int32_t* dst, long n) {
+        if (in==NULL) {
+            copy_sat_sse2(src, dst, n);
+            return;
+        }
+        const __m128i m7f = _mm_set1_epi32(INT32_MAX);
+        long i = 0;
+        for (; i+4<=n; i+=4) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src+i));
+            __m128i m = _mm_srai_epi32(v, 31);
+            v = _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, m7f));
+            v = _mm_add_epi32(v, _mm_loadu_si128((const __m128i*) (in+i)));
+            _mm_storeu_si128((__m128i*) (dst+i), v);
+        }
+        add_int32_scalar(src+i, in+i, dst+i, n-i);
+    }
+
+    static uint64_t sum_sse2(const uint32_t* src, long n) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        long i = 0;
+        for (; i+4<=n; i+=4) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src+i));
+            acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+            acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i*) lanes, acc);
+        return lanes[0] + lanes[1] + sum_scalar(src+i, n-i);
+    }
+
+    static void minmax_sse2(const uint32_t* src, long n, uint32_t& min, uint32_t& max) {
+        const __m128i sign = _mm_set1_epi32(INT32_MIN);
+        __m128i mn = _mm_set1_epi32(INT32_MAX); // = UINT32_MAX with flipped sign bit
+        __m128i mx = _mm_set1_epi32(INT32_MIN); // = 0 with flipped sign bit
+        long i = 0;
+        for (; i+4<=n; i+=4) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src+i)), sign);
+            __m128i lt = _mm_cmplt_epi32(v, mn);
+            mn = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, mn));
+            __m128i gt = _mm_cmpgt_epi32(v, mx);
+            mx = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, mx));
+        }
+        uint32_t a[4], b[4];
+        _mm_storeu_si128((__m128i*) a, _mm_xor_si128(mn, sign));
+        _mm_storeu_si128((__m128i*) b, _mm_xor_si128(mx, sign));
+        minmax_scalar(src+i, n-i, min, max);
+        for (int k=0; k<4; k++) {
+            min = a[k]<min ? a[k] : min;
+            max = b[k]>max ? b[k] : max;
+        }
+    }
+
+    static uint32_t max_sse2(const uint32_t* src, long n) {
+        uint32_t mn, mx;
+        minmax_sse2(src, n, mn, mx);
+        return mx;
+    }
+
+    // #########################################################################
+    // AVX2
+    // #########################################################################
+
+    __attribute__((target("avx2")))
+    static void copy_sat_avx2(const uint32_t* src, int32_t* dst, long n) {
+        const __m256i m7f = _mm256_set1_epi32(INT32_MAX);
+        long i = 0;
+        for (; i+8<=n; i+=8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (src+i));
+            _mm256_storeu_si256((__m256i*) (dst+i), _mm256_min_epu32(v, m7f));
+        }
+        copy_sat_scalar(src+i, dst+i, n-i);
+    }
+
+    __attribute__((target("avx2")))
+    static void add_int32_avx2(const uint32_t* src, const int32_t* in, int32_t* dst, long n) {
+        if (in==NULL) {
+            copy_sat_avx2(src, dst, n);
+            return;
+        }
+        const __m256i m7f = _mm256_set1_epi32(INT32_MAX);
+        long i = 0;
+        for (; i+8<=n; i+=8) {
+            __m256i v = _mm256_min_epu32(_mm256_loadu_si256((const __m256i*) (src+i)), m7f);
+            v = _mm256_add_epi32(v, _mm256_loadu_si256((const __m256i*) (in+i)));
+            _mm256_storeu_si256((__m256i*) (dst+i), v);
+        }
+        add_int32_scalar(src+i, in+i, dst+i, n-i);
+    }
+
+    __attribute__((target("avx2")))
+    static uint64_t sum_avx2(const uint32_t* src, long n) {
+        __m256i acc = _mm256_setzero_si256();
+        long i = 0;
+        for (; i+8<=n; i+=8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (src+i));
+            acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+            acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, acc);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar(src+i, n-i);
+    }
+
+    __attribute__((target("avx2")))
+    static void minmax_avx2(const uint32_t* src, long n, uint32_t& min, uint32_t& max) {
+        __m256i mn = _mm256_set1_epi32(-1);
+        __m256i mx = _mm256_setzero_si256();
+        long i = 0;
+        for (; i+8<=n; i+=8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (src+i));
+            mn = _mm256_min_epu32(mn, v);
+            mx = _mm256_max_epu32(mx, v);
+        }
+        uint32_t a[8], b[8];
+        _mm256_storeu_si256((__m256i*) a, mn);
+        _mm256_storeu_si256((__m256i*) b, mx);
+        minmax_scalar(src+i, n-i, min, max);
+        for (int k=0; k<8; k++) {
+            min = a[k]<min ? a[k] : min;
+            max = b[k]>max ? b[k] : max;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static uint32_t max_avx2(const uint32_t* src, long n) {
+        __m256i mx = _mm256_setzero_si256();
+        long i = 0;
+        for (; i+8<=n; i+=8)
+            mx = _mm256_max_epu32(mx, _mm256_loadu_si256((const __m256i*) (src+i)));
+        uint32_t b[8];
+        _mm256_storeu_si256((__m256i*) b, mx);
+        uint32_t m = max_scalar(src+i, n-i);
+        for (int k=0; k<8; k++)
+            m = b[k]>m ? b[k] : m;
+        return m;
+    }
+
+    __attribute__((target("avx2")))
+    static void scale_avx2(const uint32_t* src, long n, uint32_t whiteval, uint64_t scale, uint8_t* out) {
+        // (v*scale)>>32 = v*hi + (v*lo)>>32 with scale = hi*2^32+lo, hi<=255;
+        // for v<whiteval the result is <256, so v*hi fits into 32 bit
+        const __m256i hi = _mm256_set1_epi32((int32_t) (scale >> 32));
+        const __m256i lo = _mm256_set1_epi32((int32_t) (uint32_t) scale);
+        const __m256i white = _mm256_set1_epi32((int32_t) whiteval);
+        const __m256i ff = _mm256_set1_epi32(255);
+        const __m256i c255 = ff;
+        const __m256i himask = _mm256_set1_epi64x((int64_t) 0xFFFFFFFF00000000LL);
+        long i = 0;
+        for (; i+8<=n; i+=8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (src+i));
+            __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(v, lo), 32);
+            __m256i odd = _mm256_and_si256(_mm256_mul_epu32(_mm256_srli_epi64(v, 32), lo), himask);
+            __m256i r = _mm256_add_epi32(_mm256_mullo_epi32(v, hi), _mm256_or_si256(even, odd));
+            // q = quotient+1 where q*whiteval > v*255: compare the 64-bit
+            // products of the even and the odd lanes (< 2^40, signed compare)
+            __m256i ce = _mm256_cmpgt_epi64(_mm256_mul_epu32(r, white), _mm256_mul_epu32(v, c255));
+            __m256i co = _mm256_cmpgt_epi64(_mm256_mul_epu32(_mm256_srli_epi64(r, 32), white),
+                    _mm256_mul_epu32(_mm256_srli_epi64(v, 32), c255));
+            r = _mm256_add_epi32(r, _mm256_blend_epi32(ce, co, 0xAA)); // -1 where too big
+            __m256i ge = _mm256_cmpeq_epi32(_mm256_max_epu32(v, white), v); // v>=whiteval
+            r = _mm256_blendv_epi8(r, ff, ge);
+            __m256i p = _mm256_packus_epi32(r, r);
+            p = _mm256_packus_epi16(p, p);
+            uint32_t b0 = (uint32_t) _mm_cvtsi128_si32(_mm256_castsi256_si128(p));
+            uint32_t b1 = (uint32_t) _mm_cvtsi128_si32(_mm256_extracti128_si256(p, 1));
+            memcpy(out+i, &b0, 4);
+            memcpy(out+i+4, &b1, 4);
+        }
+        scale_scalar(src+i, n-i, whiteval, scale, out+i);
+    }
+
+    __attribute__((target("avx2")))
+    static void byteswap32_avx2(const uint32_t* src, uint32_t* dst, long n) {
+        const __m256i shuf = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12,
+                                              3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+        long i = 0;
+        for (; i+8<=n; i+=8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (src+i));
+            _mm256_storeu_si256((__m256i*) (dst+i), _mm256_shuffle_epi8(v, shuf));
+        }
+        byteswap32_scalar(src+i, dst+i, n-i);
+    }
+
+    // #########################################################################
+    // AVX-512 (foundation instructions only)
+    // #########################################################################
+
+    // some GCC versions warn about the undefined vectors inside of the
+    // AVX-512 intrinsics headers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+    __attribute__((target("avx512f")))
+    static void copy_sat_avx512(const uint32_t* src, int32_t* dst, long n) {
+        const __m512i m7f = _mm512_set1_epi32(INT32_MAX);
+        long i = 0;
+        for (; i+16<=n; i+=16) {
+            __m512i v = _mm512_loadu_si512((const void*) (src+i));
+            _mm512_storeu_si512((void*) (dst+i), _mm512_min_epu32(v, m7f));
+        }
+        copy_sat_scalar(src+i, dst+i, n-i);
+    }
+
+    __attribute__((target("avx512f")))
+    static void add_int32_avx512(const uint32_t* src, const int32_t* in, int32_t* dst, long n) {
+        if (in==NULL) {
+            copy_sat_avx512(src, dst, n);
+            return;
+        }
+        const __m512i m7f = _mm512_set1_epi32(INT32_MAX);
+        long i = 0;
+        for (; i+16<=n; i+=16) {
+            __m512i v = _mm512_min_epu32(_mm512_loadu_si512((const void*) (src+i)), m7f);
+            v = _mm512_add_epi32(v, _mm512_loadu_si512((const void*) (in+i)));
+            _mm512_storeu_si512((void*) (dst+i), v);
+        }
+        add_int32_scalar(src+i, in+i, dst+i, n-i);
+    }
+
+    __attribute__((target("avx512f")))
+    static uint64_t sum_avx512(const uint32_t* src, long n) {
+        __m512i acc = _mm512_setzero_si512();
+        long i = 0;
+        for (; i+16<=n; i+=16) {
+            __m512i v = _mm512_loadu_si512((const void*) (src+i));
+            acc = _mm512_add_epi64(acc, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(v)));
+            acc = _mm512_add_epi64(acc, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+        }
+        return (uint64_t) _mm512_reduce_add_epi64(acc) + sum_scalar(src+i, n-i);
+    }
+
+    __attribute__((target("avx512f")))
+    static void minmax_avx512(const uint32_t* src, long n, uint32_t& min, uint32_t& max) {
+        __m512i mn = _mm512_set1_epi32(-1);
+        __m512i mx = _mm512_setzero_si512();
+        long i = 0;
+        for (; i+16<=n; i+=16) {
+            __m512i v = _mm512_loadu_si512((const void*) (src+i));
+            mn = _mm512_min_epu32(mn, v);
+            mx = _mm512_max_epu32(mx, v);
+        }
+        minmax_scalar(src+i, n-i, min, max);
+        uint32_t a = _mm512_reduce_min_epu32(mn);
+        uint32_t b = _mm512_reduce_max_epu32(mx);
+        min = a<min ? a : min;
+        max = b>max ? b : max;
+    }
+
+    __attribute__((target("avx512f")))
+    static uint32_t max_avx512(const uint32_t* src, long n) {
+        __m512i mx = _mm512_setzero_si512();
+        long i = 0;
+        for (; i+16<=n; i+=16)
+            mx = _mm512_max_epu32(mx, _mm512_loadu_si512((const void*) (src+i)));
+        uint32_t m = max_scalar(src+i, n-i);
+        uint32_t b = _mm512_reduce_max_epu32(mx);
+        return b>m ? b : m;
+    }
+#pragma GCC diagnostic pop
+#endif
+
+    // #########################################################################
+    // dispatch
+    // #########################################################################
+
+    struct table_t {
+        level_t level;
+        void     (*copy_sat)(const uint32_t*, int32_t*, long);
+        void     (*add_int32)(const uint32_t*, const int32_t*, int32_t*, long);
+        uint64_t (*sum)(const uint32_t*, long);
+        void     (*minmax)(const uint32_t*, long, uint32_t&, uint32_t&);
+        uint32_t (*max)(const uint32_t*, long);
+        void     (*scale)(const uint32_t*, long, uint32_t, uint64_t, uint8_t*);
+        void     (*byteswap32)(const uint32_t*, uint32_t*, long);
+    };
+
+    static const table_t table_scalar = {LEVEL_SCALAR, copy_sat_scalar, add_int32_scalar,
+        sum_scalar, minmax_scalar, max_scalar, scale_scalar, byteswap32_scalar};
+#ifdef BUFFERKERNELS_X86
+    static const table_t table_sse2 = {LEVEL_SSE2, copy_sat_sse2, add_int32_sse2,
+        sum_sse2, minmax_sse2, max_sse2, scale_scalar, byteswap32_scalar};
+    static const table_t table_avx2 = {LEVEL_AVX2, copy_sat_avx2, add_int32_avx2,
+        sum_avx2, minmax_avx2, max_avx2, scale_avx2, byteswap32_avx2};
+    static const table_t table_avx512 = {LEVEL_AVX512, copy_sat_avx512, add_int32_avx512,
+        sum_avx512, minmax_avx512, max_avx512, scale_avx2, byteswap32_avx2};
+#endif
+
+    static level_t _supported_level() {
+#ifdef BUFFERKERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return LEVEL_AVX512;
+        if (__builtin_cpu_supports("avx2")) return LEVEL_AVX2;
+        if (__builtin_cpu_supports("sse2")) return LEVEL_SSE2;
+#endif
+        return LEVEL_SCALAR;
+    }
+
+    static const table_t* _table_for(level_t level) {
+#ifdef BUFFERKERNELS_X86
+        if (level>=LEVEL_AVX512) return &table_avx512;
+        if (level>=LEVEL_AVX2) return &table_avx2;
+        if (level>=LEVEL_SSE2) return &table_sse2;
+#endif
+        return &table_scalar;
+    }
+
+    static std::atomic<const table_t*> active_table(NULL);
+
+    static inline const table_t* _table() {
+        const table_t* t = active_table.load(std::memory_order_acquire);
+        if (t==NULL) {
+            t = _table_for(_supported_level());
+            active_table.store(t, std::memory_order_release);
+        }
+        return t;
+    }
+
+    level_t get_level() {
+        return _table()->level;
+    }
+
+    const char* get_level_name() {
+        switch (get_level()) {
+            case LEVEL_AVX512: return "AVX-512";
+            case LEVEL_AVX2:   return "AVX2";
+            case LEVEL_SSE2:   return "SSE2";
+            default:           return "scalar";
+        }
+    }
+
+    level_t set_level(level_t level) {
+        level_t supported = _supported_level();
+        const table_t* t = _table_for(level<supported ? level : supported);
+        active_table.store(t, std::memory_order_release);
+        return t->level;
+    }
+
+    // #########################################################################
+    // public functions
+    // #########################################################################
+
+    void clear(void* dst, size_t bytes) {
+        memset(dst, 0, bytes); // the C library already selects the widest stores
+    }
+
+    void copy_uint32_to_int32_sat(const uint32_t* src, int32_t* dst, long n) {
+        _table()->copy_sat(src, dst, n);
+    }
+
+    void add_uint32_to_int32_sat(const uint32_t* src, const int32_t* in, int32_t* dst, long n) {
+        _table()->add_int32(src, in, dst, n);
+    }
+
+    uint64_t sum_uint32(const uint32_t* src, long n) {
+        return _table()->sum(src, n);
+    }
+
+    uint32_t max_uint32(const uint32_t* src, long n) {
+        return _table()->max(src, n);
+    }
+
+    void minmax_uint32(const uint32_t* src, long n, uint32_t& min, uint32_t& max) {
+        _table()->minmax(src, n, min, max);
+    }
+
+    void histogram_uint32(const uint32_t* src, long n, uint32_t binsize, uint32_t* bins, int nrbins) {
+        if (nrbins<1) return;
+        if (binsize==0) binsize = 1;
+        // the division by binsize is replaced by a multiplication with the
+        // rounded-up 32.32 reciprocal, which yields the quotient or the
+        // quotient plus one; the latter is corrected with one multiplication
+        uint64_t recip = ((((uint64_t) 1) << 32) + binsize - 1) / binsize;
+        uint64_t last = (uint64_t) nrbins-1;
+        if (binsize==1) {
+            for (long i=0; i<n; i++)
+                bins[src[i]<last ? src[i] : last]++;
+            return;
+        }
+        for (long i=0; i<n; i++) {
+            uint64_t v = src[i];
+            uint64_t q = (v*recip) >> 32;
+            if (q*binsize>v) q--;
+            bins[q<last ? q : last]++;
+        }
+    }
+
+    void scale_uint32_to_uint8(const uint32_t* src, long n, uint32_t whiteval, uint8_t* out) {
+        if (whiteval==0) whiteval = 1;
+        // 32.32 fixed-point reciprocal (rounded up): for v<whiteval,
+        // (v*scale)>>32 is v*255/whiteval or one more (the rounding error
+        // v*(scale-255*2^32/whiteval) stays below 2^32); the kernels correct
+        // the latter with one multiplication, which gives the exact
+        // division without a division per pixel.
+        // v*scale < 256*2^32 fits into 64 bit
+        uint64_t scale = ((((uint64_t) 255) << 32) + whiteval - 1) / whiteval;
+        _table()->scale(src, n, whiteval, scale, out);
+    }
+
+    void byteswap16(const uint16_t* src, uint16_t* dst, long n) {
+        for (long i=0; i<n; i++)
+            dst[i] = __builtin_bswap16(src[i]);
+    }
+
+    void byteswap32(const uint32_t* src, uint32_t* dst, long n) {
+        _table()->byteswap32(src, dst, n);
+    }
+
+    void byteswap64(const uint64_t* src, uint64_t* dst, long n) {
+        for (long i=0; i<n; i++)
+            dst[i] = __builtin_bswap64(src[i]);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   BufferKernels.h
+ *
+ * Vectorized operations on the uint32 histogram buffers
+ */
+
+#ifndef BUFFERKERNELS_H
+#define	BUFFERKERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The hot loops over 32-bit data buffers (copies into Tango frames, the
+// accumulation of frames, integration of the XYT cube, statistics, PGM
+// previews and big-endian file output) go through these functions. On x86
+// the implementation is chosen once, at the first call, from the features
+// of the CPU (SSE2, AVX2 or AVX-512), other architectures use the scalar
+// code. All variants give identical results.
+
+namespace BufferKernels {
+
+    enum level_t { LEVEL_SCALAR = 0, LEVEL_SSE2 = 1, LEVEL_AVX2 = 2, LEVEL_AVX512 = 3 };
+
+    level_t get_level();
+    const char* get_level_name();
+    
+    /**
+     * select the implementation level (for comparisons), levels that are not
+     * supported by the CPU are lowered to the best supported level
+     * @return the level that is used from now on
+     */
+    level_t set_level(level_t level);
+
+    void clear(void* dst, size_t bytes);
+    
+    // dst[i] = min(src[i], INT32_MAX)
+    void copy_uint32_to_int32_sat(const uint32_t* src, int32_t* dst, long n);
+    
+    // dst[i] = in[i] + min(src[i], INT32_MAX), in may be NULL
+    void add_uint32_to_int32_sat(const uint32_t* src, const int32_t* in, int32_t* dst, long n);
+    
+    uint64_t sum_uint32(const uint32_t* src, long n);
+    uint32_t max_uint32(const uint32_t* src, long n);
+    void minmax_uint32(const uint32_t* src, long n, uint32_t& min, uint32_t& max); // min=UINT32_MAX, max=0 if n<1
+    
+    /**
+     * adds the counts of the values in src to nrbins buckets of width
+     * binsize (bin = src[i]/binsize, values beyond the last bucket are counted
+     * in the last bucket)
+     */
+    void histogram_uint32(const uint32_t* src, long n, uint32_t binsize, uint32_t* bins, int nrbins);
+    
+    /**
+     * out[i] = 255 for src[i]>=whiteval, otherwise src[i]*255/whiteval
+     * (the 8-bit PGM preview scaling with a 32.32 fixed-point reciprocal)
+     */
+    void scale_uint32_to_uint8(const uint32_t* src, long n, uint32_t whiteval, uint8_t* out);
+
+    // reverse the byte order of n values (src and dst may be identical)
+    void byteswap16(const uint16_t* src, uint16_t* dst, long n);
+    void byteswap32(const uint32_t* src, uint32_t* dst, long n);
+    void byteswap64(const uint64_t* src, uint64_t* dst, long n);
+}
+
+#endif	/* BUFFERKERNELS_H */
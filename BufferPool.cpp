@@ -0,0 +1,387 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "BufferPool.h"
+#include "BufferKernels.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#endif
+
+BufferPool::BufferPool() {
+}
+
+BufferPool::~BufferPool() {
+    Purge();
+}
+
+BufferPool& BufferPool::Shared() {
+    // intentionally leaked, histograms may be destroyed during static
+    // destruction after the pool would have been
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+int64_t BufferPool::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long BufferPool::SizeClass(long bytes) {
+    static const long page = sysconf(_SC_PAGESIZE)>0 ? sysconf(_SC_PAGESIZE) : 4096;
+    if (bytes<1)
+        bytes = 1;
+    if (bytes<=8*page)
+        return (bytes+page-1)/page*page;
+    long p = 8*page;
+    while (p*2<=bytes)
+        p *= 2;
+    long step = p/8; // at most 12.5% of the buffer are unused
+    return (bytes+step-1)/step*step;
+}
+
+void* BufferPool::Acquire(long bytes, long& capacity) {
+    long size = SizeClass(bytes);
+    Block b;
+    bool reuse = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = free_blocks.find(size);
+        if (it!=free_blocks.end() && !it->second.empty()) {
+            b = it->second.back(); // the most recently released, still warm
+            it->second.pop_back();
+            bytes_cached -= b.size;
+            if (!b.clean)
+                bytes_cached_resident -= b.size;
+            bytes_in_use += b.size;
+            nr_reuses++;
+            reuse = true;
+        }
+    }
+    if (reuse) {
+        if (!b.clean) {
+            LargePolicy policy = GetLargePolicy();
+            if (policy.min_bytes>0 && b.size>=policy.min_bytes && policy.prefault_threads>1)
+                TouchParallel(b.ptr, b.size, policy.prefault_threads, true);
+            else
+                BufferKernels::clear(b.ptr, b.size);
+        }
+        capacity = b.size;
+        return b.ptr;
+    }
+    LargePolicy policy = GetLargePolicy();
+    bool islarge = policy.min_bytes>0 && size>=policy.min_bytes;
+    void* p = MAP_FAILED;
+    if (islarge) {
+        p = MapLarge(size, policy);
+    }
+    else {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        if (GetPrefault())
+            flags |= MAP_POPULATE;
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    }
+    if (p==MAP_FAILED) {
+        std::cout << "ERROR: BufferPool::Acquire:" << std::endl;
+        std::cout << " unable to map " << size << " bytes" << std::endl;
+        capacity = 0;
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    bytes_in_use += size;
+    nr_maps++;
+    capacity = size;
+    return p;
+}
+
+void BufferPool::Release(void* buf, long capacity) {
+    if (buf==NULL)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    free_blocks[capacity].push_back({buf, capacity, false, NowMs()});
+    bytes_in_use -= capacity;
+    bytes_cached += capacity;
+    bytes_cached_resident += capacity;
+}
+
+long BufferPool::Trim(long idle_ms) {
+    // take the candidates out of the pool, so that the (possibly slow)
+    // madvise calls don't block Acquire and Release
+    std::vector<Block> idle;
+    int64_t now = NowMs();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& c : free_blocks) {
+            std::vector<Block>& v = c.second;
+            for (size_t i=0; i<v.size(); ) {
+                if (!v[i].clean && now-v[i].released_ms>=idle_ms) {
+                    idle.push_back(v[i]);
+                    bytes_cached -= v[i].size;
+                    bytes_cached_resident -= v[i].size;
+                    v.erase(v.begin()+i);
+                }
+                else i++;
+            }
+        }
+    }
+    long trimmed = 0;
+    for (Block& b : idle) {
+        if (madvise(b.ptr, b.size, MADV_DONTNEED)==0) {
+            b.clean = true; // anonymous pages read back as zeros
+            trimmed += b.size;
+        }
+        else
+            b.released_ms = now; // e.g. explicit huge pages on old kernels, retry later
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Block& b : idle) {
+        free_blocks[b.size].insert(free_blocks[b.size].begin(), b); // reused last
+        bytes_cached += b.size;
+        if (!b.clean)
+            bytes_cached_resident += b.size;
+    }
+    return trimmed;
+}
+
+long BufferPool::Purge() {
+    std::map<long, std::vector<Block>> blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.swap(free_blocks);
+        bytes_cached = 0;
+        bytes_cached_resident = 0;
+    }
+    long purged = 0;
+    for (auto& c : blocks)
+        for (Block& b : c.second) {
+            munmap(b.ptr, b.size);
+            purged += b.size;
+        }
+    return purged;
+}
+
+void BufferPool::SetPrefault(bool prefault_) {
+    std::lock_guard<std::mutex> lock(mutex);
+    prefault = prefault_;
+}
+
+bool BufferPool::GetPrefault() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return prefault;
+}
+
+void BufferPool::SetLargePolicy(const LargePolicy& policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    large = policy;
+}
+
+BufferPool::LargePolicy BufferPool::GetLargePolicy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return large;
+}
+
+long BufferPool::HugePageSize() {
+    std::ifstream f("/proc/meminfo");
+    std::string key;
+    long value;
+    std::string unit;
+    while (f >> key >> value) {
+        std::getline(f, unit);
+        if (key.compare("Hugepagesize:")==0)
+            return value*1024; // in kB
+    }
+    return 0;
+}
+
+std::vector<int> BufferPool::ParseNodeList(const std::string& list) {
+    // comma or plus separated node numbers and ranges
+    std::vector<int> nodes;
+    size_t pos = 0;
+    while (pos<list.size()) {
+        size_t end = list.find_first_of(",+", pos);
+        if (end==std::string::npos)
+            end = list.size();
+        std::string item = list.substr(pos, end-pos);
+        pos = end+1;
+        size_t dash = item.find('-');
+        try {
+            int a = std::stoi(item.substr(0, dash));
+            int b = dash==std::string::npos ? a : std::stoi(item.substr(dash+1));
+            for (int n = a; n<=b && n<1024; n++)
+                if (n>=0)
+                    nodes.push_back(n);
+        }
+        catch (std::exception& e) {
+            // skip empty or invalid items
+        }
+    }
+    return nodes;
+}
+
+std::vector<int> BufferPool::OnlineNumaNodes() {
+    std::ifstream f("/sys/devices/system/node/online");
+    std::string list;
+    std::getline(f, list);
+    std::vector<int> nodes = ParseNodeList(list);
+    if (nodes.empty())
+        nodes.push_back(0);
+    return nodes;
+}
+
+std::vector<int> BufferPool::LocalNumaNodes() {
+    // the nodes of the CPUs the process may run on (e.g. restricted with
+    // numactl or taskset), where the worker threads of the server run
+    std::vector<int> nodes;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (sched_getaffinity(0, sizeof(cpus), &cpus)!=0)
+        return OnlineNumaNodes();
+    std::vector<bool> found(1024, false);
+    for (int cpu = 0; cpu<CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &cpus))
+            continue;
+        std::string dirname = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        DIR* dir = opendir(dirname.c_str());
+        if (dir==NULL)
+            continue;
+        while (struct dirent* e = readdir(dir)) {
+            int n = -1;
+            if (sscanf(e->d_name, "node%d", &n)==1 && n>=0 && n<1024 && !found[n]) {
+                found[n] = true;
+                nodes.push_back(n);
+            }
+        }
+        closedir(dir);
+    }
+    if (nodes.empty())
+        return OnlineNumaNodes();
+    return nodes;
+}
+
+void* BufferPool::MapLarge(long size, const LargePolicy& policy) {
+    static const long thp_size = 2*1048576;
+    void* p = MAP_FAILED;
+    hugepages_t hugepages = policy.hugepages;
+    if (hugepages==HUGEPAGES_EXPLICIT) {
+        long hps = HugePageSize();
+        if (hps>0 && size%hps==0)
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p==MAP_FAILED) {
+            std::cout << "BufferPool: no explicit huge pages for " << size
+                      << " bytes, using transparent huge pages" << std::endl;
+            hugepages = HUGEPAGES_TRANSPARENT;
+        }
+    }
+    if (p==MAP_FAILED) {
+        // for transparent huge pages, map more and cut the buffer out at a
+        // huge page boundary
+        long slack = hugepages==HUGEPAGES_TRANSPARENT ? thp_size : 0;
+        char* q = (char*) mmap(NULL, size+slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (q==(char*) MAP_FAILED)
+            return MAP_FAILED;
+        p = q;
+        if (slack>0) {
+            char* a = (char*) ((((uintptr_t) q) + thp_size - 1) & ~((uintptr_t) thp_size - 1));
+            if (a>q)
+                munmap(q, a-q);
+            if (q+size+slack>a+size)
+                munmap(a+size, (q+size+slack)-(a+size));
+            p = a;
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+    }
+    if (policy.numa!=NUMA_NONE) {
+        // the policy applies to the pages faulted from now on
+        std::vector<int> nodes = policy.numa_nodes.empty() ? OnlineNumaNodes() : policy.numa_nodes;
+        unsigned long mask[1024/(8*sizeof(unsigned long))] = {0};
+        for (int n : nodes)
+            mask[n/(8*sizeof(unsigned long))] |= 1UL << (n%(8*sizeof(unsigned long)));
+        int mode = policy.numa==NUMA_BIND ? MPOL_BIND : MPOL_INTERLEAVE;
+        if (syscall(SYS_mbind, p, size, mode, mask, 8*sizeof(mask), 0)!=0) {
+            std::cout << "ERROR: BufferPool::MapLarge:" << std::endl;
+            std::cout << " mbind failed, the buffer is placed by the default policy" << std::endl;
+        }
+    }
+    if (policy.prefault_threads>0)
+        TouchParallel(p, size, policy.prefault_threads, false);
+    return p;
+}
+
+void BufferPool::TouchParallel(void* buf, long size, int nrthreads, bool clear) {
+    // faults (or clears) the pages of the buffer in nrthreads slices at once
+    static const long page = sysconf(_SC_PAGESIZE)>0 ? sysconf(_SC_PAGESIZE) : 4096;
+    if (nrthreads<1)
+        nrthreads = 1;
+    long slice = (size/nrthreads+page-1)/page*page;
+    auto touch = [=](long begin, long end) {
+        char* p = (char*) buf;
+        if (clear)
+            BufferKernels::clear(p+begin, end-begin);
+        else
+            for (long i = begin; i<end; i+=page)
+                ((volatile char*) p)[i] = 0;
+    };
+    std::vector<std::thread> threads;
+    for (long begin = slice; begin<size; begin+=slice)
+        threads.push_back(std::thread(touch, begin, begin+slice<size ? begin+slice : size));
+    touch(0, slice<size ? slice : size);
+    for (std::thread& t : threads)
+        t.join();
+}
+
+long BufferPool::GetBytesInUse() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes_in_use;
+}
+
+long BufferPool::GetBytesCached() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes_cached;
+}
+
+long BufferPool::GetBytesCachedResident() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes_cached_resident;
+}
+
+long long BufferPool::GetNrReuses() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nr_reuses;
+}
+
+long long BufferPool::GetNrMaps() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nr_maps;
+}
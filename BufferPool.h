@@ -0,0 +1,129 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   BufferPool.h
+ *
+ * Shared pool of data buffers for the histograms
+ */
+
+#ifndef BUFFERPOOL_H
+#define	BUFFERPOOL_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+/**
+ * The data buffers of all histograms are drawn from one pool. Requests are
+ * rounded up to size classes (page multiples up to 32 kB, then 8 classes
+ * per power of two), so that a histogram can grow within its class without
+ * reallocation and a buffer released by one histogram can be reused by
+ * another one. Buffers are mapped anonymously and handed out zeroed. Released
+ * buffers are kept in the pool; Trim() returns the pages of buffers that have
+ * been idle for a while to the operating system with madvise(MADV_DONTNEED)
+ * while keeping their mappings, Purge() unmaps all released buffers.
+ * Buffers of at least LargePolicy::min_bytes (the accumulation cubes) are
+ * mapped according to the large buffer policy: huge pages, NUMA placement
+ * and pre-faulting (and clearing on reuse) by several threads.
+ */
+class BufferPool {
+public:
+    enum hugepages_t { HUGEPAGES_NONE, HUGEPAGES_TRANSPARENT, HUGEPAGES_EXPLICIT };
+    enum numa_t { NUMA_NONE, NUMA_BIND, NUMA_INTERLEAVE };
+
+    struct LargePolicy {
+        long             min_bytes = 0;          // 0: no large buffers
+        hugepages_t      hugepages = HUGEPAGES_NONE;
+        numa_t           numa = NUMA_NONE;
+        std::vector<int> numa_nodes;             // empty: all online nodes
+        int              prefault_threads = 0;   // 0: pages are faulted on first use
+    };
+
+    BufferPool();
+    ~BufferPool();
+
+    // the pool shared by all histograms (never destroyed)
+    static BufferPool& Shared();
+
+    static long SizeClass(long bytes);
+
+    /**
+     * @return a zeroed buffer of at least bytes bytes or NULL if the memory
+     * could not be mapped; capacity receives the usable size of the buffer
+     */
+    void* Acquire(long bytes, long& capacity);
+    void  Release(void* buf, long capacity);
+
+    /**
+     * return the pages of released buffers that have been idle for at least
+     * idle_ms milliseconds to the operating system
+     * @return the number of bytes returned
+     */
+    long  Trim(long idle_ms);
+    long  Purge();
+
+    // touch all pages of newly mapped buffers at once (MAP_POPULATE)
+    void  SetPrefault(bool prefault_);
+    bool  GetPrefault();
+    void  SetLargePolicy(const LargePolicy& policy);
+    LargePolicy GetLargePolicy();
+
+    static long HugePageSize();             // of explicit huge pages, 0 if unknown
+    static std::vector<int> OnlineNumaNodes();
+    static std::vector<int> LocalNumaNodes(); // of the CPUs the process may run on
+    static std::vector<int> ParseNodeList(const std::string& list); // e.g. "0-1" or "0+2"
+
+    long  GetBytesInUse();
+    long  GetBytesCached();          // released buffers, mapped
+    long  GetBytesCachedResident();  // released buffers, not trimmed yet
+    long long GetNrReuses();
+    long long GetNrMaps();
+
+private:
+    struct Block {
+        void*   ptr;
+        long    size;
+        bool    clean;       // known to be zero (new or trimmed)
+        int64_t released_ms;
+    };
+
+    std::map<long, std::vector<Block>> free_blocks; // by size class
+    std::mutex mutex;
+    bool      prefault = false;
+    LargePolicy large;
+    long      bytes_in_use = 0;
+    long      bytes_cached = 0;
+    long      bytes_cached_resident = 0;
+    long long nr_reuses = 0;
+    long long nr_maps = 0;
+
+    static int64_t NowMs();
+    static void* MapLarge(long size, const LargePolicy& policy);
+    static void  TouchParallel(void* buf, long size, int nrthreads, bool clear);
+};
+
+#endif	/* BUFFERPOOL_H */
@@ -0,0 +1,101 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <iostream>
+#include "CoalescingJob.h"
+
+CoalescingJob::CoalescingJob() : state(IDLE), coalesced(0), skipped(0) {
+    
+}
+
+void CoalescingJob::SetFunction(JobFunction func_) {
+    func = func_;
+}
+
+void CoalescingJob::SetSubmitter(Submitter submit_) {
+    submit = submit_;
+}
+
+bool CoalescingJob::Request() {
+    int s = state.load();
+    while (true) {
+        if (s==IDLE) {
+            if (state.compare_exchange_weak(s, RUNNING)) {
+                if (submit)
+                    submit([this]{ this->Run(); });
+                else
+                    Run();
+                return true;
+            }
+        }
+        else if (s==RUNNING) {
+            if (state.compare_exchange_weak(s, RUNNING_PENDING)) {
+                coalesced++;
+                return false;
+            }
+        }
+        else {
+            skipped++;
+            return false;
+        }
+        // compare_exchange failed, s holds the current state, try again
+    }
+}
+
+void CoalescingJob::Run() {
+    try {
+        if (func) func();
+    }
+    catch (...) {
+        std::cout << "ERROR: CoalescingJob::Run:" << std::endl;
+        std::cout << " unhandled exception in job function" << std::endl;
+    }
+    int s = state.load();
+    while (true) {
+        if (s==RUNNING_PENDING) {
+            // a request came in while running, serve it with a new run
+            if (state.compare_exchange_weak(s, RUNNING)) {
+                if (submit)
+                    submit([this]{ this->Run(); });
+                else
+                    Run();
+                return;
+            }
+        }
+        else if (state.compare_exchange_weak(s, IDLE))
+            return;
+    }
+}
+
+bool CoalescingJob::IsBusy() {
+    return state.load()!=IDLE;
+}
+
+long long CoalescingJob::GetCoalescedCount() {
+    return coalesced.load();
+}
+
+long long CoalescingJob::GetSkippedCount() {
+    return skipped.load();
+}
@@ -0,0 +1,76 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   CoalescingJob.h
+ */
+
+#ifndef COALESCINGJOB_H
+#define	COALESCINGJOB_H
+
+#include <atomic>
+#include <functional>
+
+/**
+ * A job that is requested repeatedly (e.g. preview refreshes) and whose runs
+ * are coalesced: at most one instance runs at a time and at most one further
+ * request is kept pending. A pending run is started after the current one has
+ * finished and always works on the data present at that time, i.e. the
+ * newest data (latest wins). Further requests arriving while a run is already
+ * pending are merged into it.
+ * The state is kept in a single atomic, Request() never blocks.
+ */
+class CoalescingJob {
+public:
+    typedef std::function<void()> JobFunction;
+    // hands a function to a worker thread for execution
+    typedef std::function<void(std::function<void()>)> Submitter;
+    
+    CoalescingJob();
+    void SetFunction(JobFunction func_);
+    void SetSubmitter(Submitter submit_);
+    
+    /**
+     * request a run of the job
+     * @return true if a run was started, false if the request was deferred
+     * to or merged into the pending run
+     */
+    bool Request();
+    bool IsBusy();
+    long long GetCoalescedCount(); // requests deferred into the pending run
+    long long GetSkippedCount();   // requests merged into an already pending run
+    
+private:
+    enum { IDLE = 0, RUNNING = 1, RUNNING_PENDING = 2 };
+    std::atomic<int>       state;
+    std::atomic<long long> coalesced;
+    std::atomic<long long> skipped;
+    JobFunction            func;
+    Submitter              submit;
+    
+    void Run();
+};
+
+#endif	/* COALESCINGJOB_H */
+
@@ -0,0 +1,323 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "FrameCodec.h"
+#include <algorithm>
+#include <cstring>
+
+const char* const DZR_FORMAT = "DZR1";
+const char* const TILE_FORMAT = "TIL1";
+const char* const BUNDLE_FORMAT = "BDL1";
+
+static inline void _put_varint(std::vector<unsigned char>& out, uint64_t v) {
+    while (v>=0x80) {
+        out.push_back((unsigned char) (v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((unsigned char) v);
+}
+
+static inline bool _get_varint(const unsigned char*& p, const unsigned char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift<64 && p<end; shift += 7) {
+        unsigned char c = *p++;
+        v |= ((uint64_t) (c & 0x7f)) << shift;
+        if ((c & 0x80)==0)
+            return true;
+    }
+    return false;
+}
+
+static inline void _put_uint32(std::vector<unsigned char>& out, uint32_t v) {
+    for (int i = 0; i<4; i++)
+        out.push_back((unsigned char) (v >> (8*i)));
+}
+
+int EncodeDeltaZeroRun(const int32_t* data, long width, long height, std::vector<unsigned char>& out) {
+    out.clear();
+    if (width<0 || height<0 || width>0xffffffffL || height>0xffffffffL)
+        return -1;
+    if (data==NULL && width*height>0)
+        return -1;
+    _put_uint32(out, (uint32_t) width);
+    _put_uint32(out, (uint32_t) height);
+    uint64_t run = 0;
+    for (long y = 0; y<height; y++) {
+        const int32_t* row = data + y*width;
+        for (long x = 0; x<width; x++) {
+            int64_t pred = x>0 ? row[x-1] : (y>0 ? row[x-width] : 0);
+            int64_t r = (int64_t) row[x] - pred;
+            if (r==0) {
+                run++;
+                continue;
+            }
+            if (run>0) {
+                _put_varint(out, (run << 1) | 1);
+                run = 0;
+            }
+            uint64_t zz = r<0 ? (((uint64_t) -r) << 1) - 1 : ((uint64_t) r) << 1;
+            _put_varint(out, zz << 1);
+        }
+    }
+    if (run>0)
+        _put_varint(out, (run << 1) | 1);
+    return 0;
+}
+
+int DecodeDeltaZeroRun(const unsigned char* in, std::size_t size, std::vector<int32_t>& out, long& width, long& height) {
+    if (in==NULL || size<8)
+        return -1;
+    uint32_t w = 0, h = 0;
+    for (int i = 0; i<4; i++) {
+        w |= ((uint32_t) in[i]) << (8*i);
+        h |= ((uint32_t) in[4+i]) << (8*i);
+    }
+    uint64_t n = (uint64_t) w * h;
+    if (n>((uint64_t) 1 << 30))
+        return -1; // larger than any histogram of this server
+    out.resize(n);
+    const unsigned char* p = in + 8;
+    const unsigned char* end = in + size;
+    uint64_t i = 0;
+    while (i<n) {
+        uint64_t v;
+        if (!_get_varint(p, end, v))
+            return -1;
+        uint64_t count = 1;
+        int64_t r = 0;
+        if (v & 1)
+            count = v >> 1;
+        else {
+            uint64_t zz = v >> 1;
+            r = (zz & 1) ? -(int64_t) ((zz + 1) >> 1) : (int64_t) (zz >> 1);
+        }
+        if (count==0 || count>n-i)
+            return -1;
+        for (; count>0; count--, i++) {
+            uint64_t x = i % w;
+            int64_t pred = x>0 ? out[i-1] : (i>=w ? out[i-w] : 0);
+            out[i] = (int32_t) (pred + r);
+        }
+    }
+    width = w;
+    height = h;
+    return p==end ? 0 : -1;
+}
+
+static inline void _put_uint64(std::vector<unsigned char>& out, uint64_t v) {
+    for (int i = 0; i<8; i++)
+        out.push_back((unsigned char) (v >> (8*i)));
+}
+
+static inline uint64_t _get_uint(const unsigned char* p, int nbytes) {
+    uint64_t v = 0;
+    for (int i = 0; i<nbytes; i++)
+        v |= ((uint64_t) p[i]) << (8*i);
+    return v;
+}
+
+long EncodeTileDelta(const int32_t* data, const int32_t* base, long width, long height,
+        long tile, unsigned long long seq, unsigned long long base_seq, std::vector<unsigned char>& out) {
+    out.clear();
+    if (data==NULL || width<=0 || height<=0 || tile<=0 || width>0xffffffffL || height>0xffffffffL)
+        return -1;
+    _put_uint32(out, (uint32_t) width);
+    _put_uint32(out, (uint32_t) height);
+    _put_uint32(out, (uint32_t) tile);
+    _put_uint32(out, base==NULL ? 1 : 0);
+    _put_uint64(out, seq);
+    _put_uint64(out, base==NULL ? 0 : base_seq);
+    std::size_t ntiles_pos = out.size();
+    _put_uint32(out, 0);
+    uint32_t ntiles = 0;
+    std::vector<int32_t> tilebuf;
+    std::vector<unsigned char> tileenc;
+    for (long ty = 0; ty*tile<height; ty++) {
+        for (long tx = 0; tx*tile<width; tx++) {
+            long x0 = tx*tile, y0 = ty*tile;
+            long tw = std::min(tile, width-x0), th = std::min(tile, height-y0);
+            bool changed = (base==NULL);
+            for (long y = y0; y<y0+th && !changed; y++)
+                changed = std::memcmp(data+y*width+x0, base+y*width+x0, tw*sizeof(int32_t))!=0;
+            if (!changed)
+                continue;
+            tilebuf.resize(tw*th);
+            for (long y = 0; y<th; y++)
+                std::memcpy(&tilebuf[y*tw], data+(y0+y)*width+x0, tw*sizeof(int32_t));
+            EncodeDeltaZeroRun(tilebuf.data(), tw, th, tileenc);
+            _put_uint32(out, (uint32_t) tx);
+            _put_uint32(out, (uint32_t) ty);
+            _put_uint32(out, (uint32_t) tileenc.size());
+            out.insert(out.end(), tileenc.begin(), tileenc.end());
+            ntiles++;
+        }
+    }
+    for (int i = 0; i<4; i++)
+        out[ntiles_pos+i] = (unsigned char) (ntiles >> (8*i));
+    return ntiles;
+}
+
+int DecodeTileDelta(const unsigned char* in, std::size_t size, std::vector<int32_t>& image,
+        long& width, long& height, unsigned long long& image_seq) {
+    if (in==NULL || size<36)
+        return -1;
+    uint64_t w = _get_uint(in, 4), h = _get_uint(in+4, 4), tile = _get_uint(in+8, 4);
+    bool keyframe = (_get_uint(in+12, 4) & 1)!=0;
+    uint64_t seq = _get_uint(in+16, 8), base_seq = _get_uint(in+24, 8);
+    uint64_t ntiles = _get_uint(in+32, 4);
+    if (tile==0 || w*h>((uint64_t) 1 << 30))
+        return -1;
+    if (keyframe) {
+        image.assign(w*h, 0);
+        width = w;
+        height = h;
+    }
+    else if (base_seq!=image_seq || (uint64_t) width!=w || (uint64_t) height!=h || image.size()!=w*h)
+        return 1;
+    const unsigned char* p = in + 36;
+    const unsigned char* end = in + size;
+    std::vector<int32_t> tilebuf;
+    for (uint64_t i = 0; i<ntiles; i++) {
+        if (end-p<12)
+            return -1;
+        uint64_t x0 = _get_uint(p, 4)*tile, y0 = _get_uint(p+4, 4)*tile, nbytes = _get_uint(p+8, 4);
+        p += 12;
+        if ((uint64_t) (end-p)<nbytes || x0>=w || y0>=h)
+            return -1;
+        long tw = 0, th = 0;
+        if (DecodeDeltaZeroRun(p, nbytes, tilebuf, tw, th)!=0)
+            return -1;
+        if ((uint64_t) tw!=std::min(tile, w-x0) || (uint64_t) th!=std::min(tile, h-y0))
+            return -1;
+        for (long y = 0; y<th; y++)
+            std::memcpy(&image[(y0+y)*w+x0], &tilebuf[y*tw], tw*sizeof(int32_t));
+        p += nbytes;
+    }
+    image_seq = seq;
+    return p==end ? 0 : -1;
+}
+
+static const std::size_t bundle_count_pos = 16; // offset of nentries
+
+static void _bundle_entry_header(std::vector<unsigned char>& out, const std::string& name, int type, int encoding,
+        long width, long height, unsigned long long source_seq, std::size_t nbytes) {
+    uint32_t count = (uint32_t) _get_uint(&out[bundle_count_pos], 4) + 1;
+    for (int i = 0; i<4; i++)
+        out[bundle_count_pos+i] = (unsigned char) (count >> (8*i));
+    std::size_t len = std::min(name.size(), (std::size_t) 0xffff);
+    out.push_back((unsigned char) len);
+    out.push_back((unsigned char) (len >> 8));
+    out.insert(out.end(), name.begin(), name.begin()+len);
+    out.push_back((unsigned char) type);
+    out.push_back((unsigned char) encoding);
+    _put_uint32(out, (uint32_t) width);
+    _put_uint32(out, (uint32_t) height);
+    _put_uint64(out, source_seq);
+    _put_uint32(out, (uint32_t) nbytes);
+}
+
+void BundleBegin(std::vector<unsigned char>& out, unsigned long long seq, unsigned long long timestamp_ms) {
+    out.clear();
+    _put_uint64(out, seq);
+    _put_uint64(out, timestamp_ms);
+    _put_uint32(out, 0);
+}
+
+void BundleAddInt32(std::vector<unsigned char>& out, const std::string& name, const int32_t* data,
+        long width, long height, unsigned long long source_seq, bool compress) {
+    std::size_t n = (std::size_t) width * (height>0 ? height : 1);
+    std::vector<unsigned char> enc;
+    if (compress && EncodeDeltaZeroRun(data, width, height>0 ? height : 1, enc)==0 && enc.size()<n*4) {
+        _bundle_entry_header(out, name, 0, 1, width, height, source_seq, enc.size());
+        out.insert(out.end(), enc.begin(), enc.end());
+        return;
+    }
+    _bundle_entry_header(out, name, 0, 0, width, height, source_seq, n*4);
+    for (std::size_t i = 0; i<n; i++)
+        _put_uint32(out, (uint32_t) data[i]);
+}
+
+void BundleAddDouble(std::vector<unsigned char>& out, const std::string& name, const double* data, long n) {
+    _bundle_entry_header(out, name, 1, 0, n, 0, 0, n*8);
+    for (long i = 0; i<n; i++) {
+        uint64_t v;
+        std::memcpy(&v, &data[i], 8);
+        _put_uint64(out, v);
+    }
+}
+
+int DecodeBundle(const unsigned char* in, std::size_t size, std::vector<BundleEntry>& entries,
+        unsigned long long& seq, unsigned long long& timestamp_ms) {
+    entries.clear();
+    if (in==NULL || size<20)
+        return -1;
+    seq = _get_uint(in, 8);
+    timestamp_ms = _get_uint(in+8, 8);
+    uint64_t n = _get_uint(in+16, 4);
+    const unsigned char* p = in + 20;
+    const unsigned char* end = in + size;
+    for (uint64_t i = 0; i<n; i++) {
+        if (end-p<2)
+            return -1;
+        std::size_t len = _get_uint(p, 2);
+        p += 2;
+        if ((std::size_t) (end-p)<len+22)
+            return -1;
+        BundleEntry e;
+        e.name.assign((const char*) p, len);
+        p += len;
+        e.type = p[0];
+        int encoding = p[1];
+        e.width = _get_uint(p+2, 4);
+        e.height = _get_uint(p+6, 4);
+        e.source_seq = _get_uint(p+10, 8);
+        uint64_t nbytes = _get_uint(p+18, 4);
+        p += 22;
+        if ((uint64_t) (end-p)<nbytes)
+            return -1;
+        uint64_t nvalues = (uint64_t) e.width * (e.height>0 ? e.height : 1);
+        if (e.type==0 && encoding==1) {
+            long w = 0, h = 0;
+            if (DecodeDeltaZeroRun(p, nbytes, e.ints, w, h)!=0 || e.ints.size()!=nvalues)
+                return -1;
+        }
+        else if (e.type==0 && encoding==0 && nbytes==nvalues*4) {
+            e.ints.resize(nvalues);
+            for (uint64_t j = 0; j<nvalues; j++)
+                e.ints[j] = (int32_t) _get_uint(p+4*j, 4);
+        }
+        else if (e.type==1 && encoding==0 && nbytes==nvalues*8) {
+            e.doubles.resize(nvalues);
+            for (uint64_t j = 0; j<nvalues; j++) {
+                uint64_t v = _get_uint(p+8*j, 8);
+                std::memcpy(&e.doubles[j], &v, 8);
+            }
+        }
+        else
+            return -1;
+        p += nbytes;
+        entries.push_back(e);
+    }
+    return p==end ? 0 : -1;
+}
@@ -0,0 +1,134 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   FrameCodec.h
+ *
+ * Lossless compression of histogram frames for DevEncoded attributes
+ */
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+#ifndef FRAMECODEC_H
+#define	FRAMECODEC_H
+
+// Format "DZR1" (delta + zero run), made for sparse count images:
+//   bytes 0..3  width  (uint32, little endian)
+//   bytes 4..7  height (uint32, little endian)
+//   then a sequence of LEB128 varints, each one either
+//     (n << 1) | 1    : n pixels whose residual is zero
+//     (zz << 1)       : one pixel with zigzag-coded residual zz
+// The residual of a pixel is its value minus its left neighbour; the first
+// pixel of a row is predicted by the pixel above it, the very first pixel
+// by 0. Pixels are stored row by row (x fastest).
+
+extern const char* const DZR_FORMAT; // "DZR1", used as the encoded_format of Tango::DevEncoded
+
+/**
+ * encode width*height values of data into out (out is overwritten, its
+ * capacity is reused)
+ * @return 0 on success, -1 on illegal arguments
+ */
+int EncodeDeltaZeroRun(const int32_t* data, long width, long height, std::vector<unsigned char>& out);
+
+/**
+ * decode a DZR1 buffer into out (resized to width*height)
+ * @return 0 on success, -1 if the buffer is truncated or corrupt
+ */
+int DecodeDeltaZeroRun(const unsigned char* in, std::size_t size, std::vector<int32_t>& out, long& width, long& height);
+
+// Format "TIL1" (tile delta update) of an image split into square tiles:
+//   uint32 width, uint32 height, uint32 tile size, uint32 flags (bit 0: keyframe)
+//   uint64 seq       sequence number of the frame
+//   uint64 base_seq  sequence number of the frame the update applies to
+//   uint32 ntiles, then per tile: uint32 tile column, uint32 tile row,
+//   uint32 nbytes, followed by nbytes of DZR1 data of the tile
+// A keyframe contains all tiles; an update contains the tiles that differ
+// from the base frame and must only be applied to an image at base_seq.
+// All integers are little endian.
+
+extern const char* const TILE_FORMAT; // "TIL1"
+
+/**
+ * encode the tiles of data that differ from base into out; if base is NULL,
+ * a keyframe containing all tiles is written (base must have the same
+ * dimensions as data)
+ * @return number of tiles written, -1 on illegal arguments
+ */
+long EncodeTileDelta(const int32_t* data, const int32_t* base, long width, long height,
+        long tile, unsigned long long seq, unsigned long long base_seq, std::vector<unsigned char>& out);
+
+/**
+ * apply a TIL1 buffer to image; image is resized if the buffer is a keyframe
+ * @param image_seq  in: sequence number of image, out: sequence number after the update
+ * @return 0 on success, 1 if the update does not apply to image (request a
+ *         keyframe), -1 if the buffer is truncated or corrupt
+ */
+int DecodeTileDelta(const unsigned char* in, std::size_t size, std::vector<int32_t>& image,
+        long& width, long& height, unsigned long long& image_seq);
+
+// Format "BDL1" (frame bundle) of several products of one processing cycle:
+//   uint64 seq           processing cycle
+//   uint64 timestamp     milliseconds since the Unix epoch
+//   uint32 nentries, then per entry:
+//     uint16 name length, name (not terminated)
+//     uint8  type        0: int32, 1: float64
+//     uint8  encoding    0: raw little endian values, 1: DZR1 (int32 only)
+//     uint32 width, uint32 height (height 0 for spectra and scalars)
+//     uint64 source seq  seq of the histogram frame, 0 if not applicable
+//     uint32 nbytes, followed by nbytes of data
+
+extern const char* const BUNDLE_FORMAT; // "BDL1"
+
+struct BundleEntry {
+    std::string          name;
+    int                  type       = 0;
+    long                 width      = 0;
+    long                 height     = 0;
+    unsigned long long   source_seq = 0;
+    std::vector<int32_t> ints;       // type 0
+    std::vector<double>  doubles;    // type 1
+};
+
+void BundleBegin(std::vector<unsigned char>& out, unsigned long long seq, unsigned long long timestamp_ms);
+
+/**
+ * append width*max(height,1) int32 values to a bundle started with BundleBegin
+ * @param compress  DZR1-encode the values (only if that is smaller)
+ */
+void BundleAddInt32(std::vector<unsigned char>& out, const std::string& name, const int32_t* data,
+        long width, long height, unsigned long long source_seq, bool compress);
+void BundleAddDouble(std::vector<unsigned char>& out, const std::string& name, const double* data, long n);
+
+/**
+ * split a BDL1 buffer into its entries
+ * @return 0 on success, -1 if the buffer is truncated or corrupt
+ */
+int DecodeBundle(const unsigned char* in, std::size_t size, std::vector<BundleEntry>& entries,
+        unsigned long long& seq, unsigned long long& timestamp_ms);
+
+#endif	/* FRAMECODEC_H */
@@ -23,16 +23,23 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
 
 #include "GeneralHistogram.h"
+#include "CustomAttr.h"
 #include "Helper.h"
 #include "PGM_Export.h"
+#include "BitDepth.h"
+#include "BufferKernels.h"
+#include "BufferPool.h"
 #include <arpa/inet.h>
 
 namespace SurfaceConceptTDC_ns {
     
     const std::string GeneralHistogram::AllAttributes[] = {"ROI_X1", "ROI_X2", "ROI_Y1", "ROI_Y2", 
-            "ROI_T1", "ROI_T2", "ROI_TOFF", "ROI_TSIZE", "BIN_X", "BIN_Y", "BIN_T", "MODULO", ""};
+            "ROI_T1", "ROI_T2", "ROI_TOFF", "ROI_TSIZE", "BIN_X", "BIN_Y", "BIN_T", "MODULO", "DEPTH", ""};
     
     const std::map<std::string, long> GeneralHistogram::AttributesMin = 
     {{"ROI_X1", 0}, {"ROI_X2", 0}, 
@@ -40,7 +47,7 @@ namespace SurfaceConceptTDC_ns {
      {"ROI_T1", -1}, {"ROI_T2", -1},
      {"ROI_TOFF", -1}, {"ROI_TSIZE", 1},
      {"BIN_X", 1}, {"BIN_Y", 1}, {"BIN_T", 1}, 
-     {"MODULO", 0}};
+     {"MODULO", 0}, {"DEPTH", 8}};
 
     const std::map<std::string, long> GeneralHistogram::AttributesMax = 
     {{"ROI_X1", 4096}, {"ROI_X2", 4096}, 
@@ -48,7 +55,7 @@ namespace SurfaceConceptTDC_ns {
      {"ROI_T1", -1}, {"ROI_T2", -1},
      {"ROI_TOFF", -1}, {"ROI_TSIZE", -1},
      {"BIN_X", 1024}, {"BIN_Y", 1024}, {"BIN_T", -1}, 
-     {"MODULO", -1}};
+     {"MODULO", -1}, {"DEPTH", 64}};
 
     const std::map<std::string, std::string> GeneralHistogram::AttributesFormat = 
     {{"ROI_X1", "%4d"}, {"ROI_X2", "%4d"}, 
@@ -56,7 +63,152 @@ namespace SurfaceConceptTDC_ns {
      {"ROI_T1", "%18d"}, {"ROI_T2", "%18d"},
      {"ROI_TOFF", "%18d"}, {"ROI_TSIZE", "%18d"},
      {"BIN_X", "%4d"}, {"BIN_Y", "%4d"}, {"BIN_T", "%18d"}, 
-     {"MODULO", "%18d"}};
+     {"MODULO", "%18d"}, {"DEPTH", "%2d"}};
+
+    // kernels over the pixel type of the data buffer (see BitDepth.h)
+    namespace {
+        template<typename T> struct TangoCopyKernel {
+            static int Run(const void* databuf, int databufw, Tango::DevLong* out, int w_, int h_) {
+                const T* buf = (const T*) databuf;
+                for (int y=0; y<h_; y++)
+                    for (int x=0; x<w_; x++)
+                        out[y*w_+x] = SaturatedInt32(buf[x+y*databufw]);
+                return 0;
+            }
+        };
+
+        template<typename T> struct TangoAccuKernel {
+            static int Run(const void* databuf, int databufw, Tango::DevLong* out, const Tango::DevLong* in, int w_, int h_) {
+                const T* buf = (const T*) databuf;
+                for (int y=0; y<h_; y++)
+                    for (int x=0; x<w_; x++) {
+                        Tango::DevLong v = SaturatedInt32(buf[x+y*databufw]);
+                        out[y*w_+x] = in!=NULL ? in[y*w_+x]+v : v;
+                    }
+                return 0;
+            }
+        };
+
+        // the 32-bit buffers are converted row by row with the vectorized kernels
+        template<> struct TangoCopyKernel<uint32_t> {
+            static int Run(const void* databuf, int databufw, Tango::DevLong* out, int w_, int h_) {
+                const uint32_t* buf = (const uint32_t*) databuf;
+                for (int y=0; y<h_; y++)
+                    BufferKernels::copy_uint32_to_int32_sat(buf+(long)y*databufw, (int32_t*) out+(long)y*w_, w_);
+                return 0;
+            }
+        };
+
+        template<> struct TangoAccuKernel<uint32_t> {
+            static int Run(const void* databuf, int databufw, Tango::DevLong* out, const Tango::DevLong* in, int w_, int h_) {
+                const uint32_t* buf = (const uint32_t*) databuf;
+                for (int y=0; y<h_; y++)
+                    BufferKernels::add_uint32_to_int32_sat(buf+(long)y*databufw,
+                        in!=NULL ? (const int32_t*) in+(long)y*w_ : NULL, (int32_t*) out+(long)y*w_, w_);
+                return 0;
+            }
+        };
+
+        template<typename T> struct StatisticsKernel {
+            static int Run(StatisticsHist* stathist, const void* databuf, long len) {
+                stathist->Update((const T*) databuf, len);
+                return 0;
+            }
+        };
+
+        template<typename T> struct UInt32Kernel {
+            static int Run(const void* databuf, long len, uint32_t* out) {
+                const T* buf = (const T*) databuf;
+                for (long i=0; i<len; i++)
+                    out[i] = SaturatedUInt32(buf[i]);
+                return 0;
+            }
+        };
+
+        template<typename T> struct SweepKernel {
+            // counters in the rows of w voxels (rows r1 to r2-1) that have
+            // wrapped around since their last visit (high bit set then,
+            // cleared now) add the range of T to added (sorted by index).
+            // hb keeps the high bit of every voxel, rowhb whether a row had
+            // any; only rows with a high bit set now or at the last visit are
+            // inspected voxel by voxel. The data buffer is only read, the
+            // scTDC may count into it meanwhile
+            static int Run(const void* databuf, long w, long r1, long r2,
+                    uint8_t* hb, uint8_t* rowhb, std::vector<std::pair<long, uint64_t> >& added) {
+                static const T highbit = (T) (((T) 1) << (8*sizeof(T)-1));
+                static const uint64_t range = ((uint64_t) std::numeric_limits<T>::max()) + 1;
+                const T* buf = (const T*) databuf;
+                int wrapped = 0;
+                for (long r=r1; r<r2; r++) {
+                    const T* row = buf + r*w;
+                    T acc = 0;
+                    for (long x=0; x<w; x++)
+                        acc |= row[x];
+                    if ((acc & highbit)==0 && rowhb[r]==0)
+                        continue;
+                    uint8_t any = 0;
+                    for (long x=0; x<w; x++) {
+                        long i = r*w+x;
+                        uint8_t mask = (uint8_t) (1 << (i & 7));
+                        bool now = (row[x] & highbit)!=0;
+                        bool then = (hb[i >> 3] & mask)!=0;
+                        if (then && !now) {
+                            added.push_back(std::make_pair(i, range));
+                            wrapped++;
+                        }
+                        if (now) hb[i >> 3] |= mask;
+                        else hb[i >> 3] &= (uint8_t) ~mask;
+                        any |= (uint8_t) now;
+                    }
+                    rowhb[r] = any;
+                }
+                return wrapped;
+            }
+        };
+
+        template<typename T> struct RowOccupancyKernel {
+            // flags the rows of w voxels (from voxel first on) that hold at
+            // least one count
+            static int Run(const void* databuf, long first, long w, long nrows, uint8_t* occ) {
+                const T* buf = (const T*) databuf + first;
+                int occupied = 0;
+                for (long r=0; r<nrows; r++) {
+                    const T* row = buf + r*w;
+                    T acc = 0;
+                    for (long x=0; x<w; x++)
+                        acc |= row[x];
+                    occ[r] = acc!=0;
+                    occupied += occ[r];
+                }
+                return occupied;
+            }
+        };
+
+        // copies n values in big-endian byte order
+        inline void ToBigEndian(const uint8_t* src, uint8_t* dst, long n) { memcpy(dst, src, n); }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        inline void ToBigEndian(const uint16_t* src, uint16_t* dst, long n) { BufferKernels::byteswap16(src, dst, n); }
+        inline void ToBigEndian(const uint32_t* src, uint32_t* dst, long n) { BufferKernels::byteswap32(src, dst, n); }
+        inline void ToBigEndian(const uint64_t* src, uint64_t* dst, long n) { BufferKernels::byteswap64(src, dst, n); }
+#else
+        template<typename T> inline void ToBigEndian(const T* src, T* dst, long n) { memcpy(dst, src, n*sizeof(T)); }
+#endif
+
+        template<typename T> struct BigEndianKernel {
+            // writes the values most significant byte first, in chunks
+            static int Run(const void* databuf, long len, FILE* f) {
+                static const long chunk = 65536;
+                const T* buf = (const T*) databuf;
+                std::vector<T> out(chunk);
+                for (long i0=0; i0<len; i0+=chunk) {
+                    long n = len-i0<chunk ? len-i0 : chunk;
+                    ToBigEndian(buf+i0, out.data(), n);
+                    fwrite(out.data(), sizeof(T), n, f);
+                }
+                return 0;
+            }
+        };
+    }
     
     GeneralHistogram::GeneralHistogram(::sc_pipe_type_t pipe_type_) {
         pipe_type = pipe_type_;
@@ -186,17 +338,13 @@ namespace SurfaceConceptTDC_ns {
         if (pipe_id>-1 && device_descriptor>-1)
             ::sc_pipe_close2(device_descriptor, pipe_id);
         if (databuf!=NULL) {
-            free(databuf);
+            _UnmapDatabuf();
             databuf = NULL;
         }
         if (stathist!=NULL) {
             delete stathist;
             stathist = NULL;
         }
-        //if (tangobuf!=NULL) { // that was before it became a vector
-        //    free(tangobuf);
-        //    tangobuf = NULL;
-        //}
         if (pipe_type==::sc_pipe_type_t::DLD_IMAGE_XY)
             delete (::sc_pipe_dld_image_xy_params_t*) hist_par;
         else if (pipe_type==::sc_pipe_type_t::DLD_IMAGE_XT)
@@ -275,6 +423,15 @@ namespace SurfaceConceptTDC_ns {
             modulo = value;
             ((T*) hist_par)->modulo = value*MODULO_FACTOR;
         }
+        else if (identifier.compare("DEPTH")==0) {
+            if (!IsSupportedBitDepth(value)) {
+                std::cout << "ERROR: GeneralHistogram::_setAttribute:" << std::endl;
+                std::cout << " unsupported bit depth " << value << " (8, 16, 32 or 64)" << std::endl;
+                return;
+            }
+            depth = value;
+            ((T*) hist_par)->depth = Helper::bitsize_to_enum(value);
+        }
     }
 
     template <typename T>
@@ -303,6 +460,8 @@ namespace SurfaceConceptTDC_ns {
             return ((T*) hist_par)->binning.time;
         else if (identifier.compare("MODULO")==0)
             return ((T*) hist_par)->modulo/MODULO_FACTOR;
+        else if (identifier.compare("DEPTH")==0)
+            return Helper::enum_to_bitsize(((T*) hist_par)->depth);
         else return -1;
     }    
     
@@ -334,6 +493,8 @@ namespace SurfaceConceptTDC_ns {
             _setAttribute< ::sc_pipe_dld_sum_histo_params_t > (identifier, value);
         else return;
         UpdateSCTDCHistoPipe();
+        if (identifier.compare("DEPTH")==0)
+            ClearBuffer(); // old contents have a different pixel type
     }
     
     long GeneralHistogram::GetAttributeMin(const std::string identifier) {
@@ -562,7 +723,8 @@ namespace SurfaceConceptTDC_ns {
 
     /**
      * ensure that the data buffer is big enough
-     * if not, reallocate it (this automatically zeroes the buffer, even if zerobuf==false)
+     * if not, reallocate it from the shared BufferPool (this automatically zeroes
+     * the buffer, even if zerobuf==false; the size is rounded up to a size class)
      * @param zerobuf : if true, zero the data buffer, even if no reallocation is necessary
      */
     void GeneralHistogram::AccomodateDatabufSize(bool zerobuf) {
@@ -571,44 +733,132 @@ namespace SurfaceConceptTDC_ns {
         //std::cout << " ... width = " << GetWidth() << ", height = " << GetHeight() << ", zsize = " << GetZSize() << ", bytes/pixel = " << (depth/8) << std::endl;
         //std::cout << " ... size of data buffer: " << databufsize_ << std::endl;
         if (databuf == NULL) {
-            databuf = (void*) calloc(databufsize_, 1);
+            _ResetSweep();
+            long capacity = 0;
+            databuf = _MapDatabuf(databufsize_, capacity); // zeroed
             if (databuf==NULL) {
                 std::cout << "ERROR: GeneralHistogram::AccomodateDatabufSize:" << std::endl;
                 std::cout << " unable to reserve memory (" << databufsize_ << " bytes)" << std::endl;
                 return;
             }
-            else databufsize = databufsize_;
+            else databufsize = capacity;
         }
         else {
             if (databufsize<databufsize_) { // if we need a bigger data buffer, reallocate it
                 //std::cout << "GeneralHistogram::AccomodateDatabufSize: need to reallocate buffer" << std::endl;
                 //std::cout << "new size: " << databufsize_ << std::endl;
-                free(databuf);
+                _UnmapDatabuf();
                 databuf=NULL;
                 databufsize=0;
                 AccomodateDatabufSize();
             } // if current data buffer is big enough or bigger than necessary, leave it
             // zero the data buffer if explicitly asked for
-            if (zerobuf) {
-                int* p = (int *) databuf; // natural size of architecture, may be faster
-                int intsize = sizeof(int); // we need conversion to signed int
-                for (long i=0; i<databufsize/intsize; i++)
-                    p[i] = 0;
-                char* p2 = (char *) databuf; // need to clear the remainder bytewise
-                for (long i=0; i<databufsize % intsize; i++)
-                    p[databufsize-i-1] = 0;
-            }
+            if (zerobuf)
+                _ZeroDatabuf();
         }
     }
 
     void GeneralHistogram::ReleaseDatabuf() {
+        _ResetSweep();
+        carry_bits.shrink_to_fit();
         if (databuf == NULL)
             return;
-        free(databuf);
+        _UnmapDatabuf();
         databuf = NULL;
         databufsize = 0;
     }
 
+    void* GeneralHistogram::_MapDatabuf(long bytes, long& capacity) {
+        if (backing_file.empty())
+            return BufferPool::Shared().Acquire(bytes, capacity);
+        mapped = new MappedFileBuffer();
+        void* buf = mapped->Map(backing_file, bytes, capacity);
+        if (buf==NULL) {
+            delete mapped;
+            mapped = NULL;
+        }
+        return buf;
+    }
+
+    void GeneralHistogram::_UnmapDatabuf() {
+        if (mapped!=NULL) {
+            delete mapped; // removes the file
+            mapped = NULL;
+        }
+        else
+            BufferPool::Shared().Release(databuf, databufsize);
+    }
+
+    void GeneralHistogram::_ZeroDatabuf() {
+        if (mapped!=NULL)
+            mapped->Clear(); // without writing the whole file
+        else
+            BufferKernels::clear(databuf, databufsize);
+    }
+
+    void GeneralHistogram::SetBackingFile(const std::string path, long chunk_bytes) {
+        backing_chunk_bytes = chunk_bytes;
+        if (path.compare(backing_file)==0)
+            return;
+        ReleaseDatabuf();
+        backing_file = path;
+    }
+
+    std::string GeneralHistogram::GetBackingFile() {
+        return backing_file;
+    }
+
+    bool GeneralHistogram::IsFileBacked() {
+        return mapped!=NULL;
+    }
+
+    long GeneralHistogram::GetChunkZSize() {
+        long zs = GetZSize();
+        long slice = GetWidth()*GetHeight()*(depth/8);
+        if (mapped==NULL || backing_chunk_bytes<=0 || slice<=0)
+            return zs>0 ? zs : 1;
+        long n = backing_chunk_bytes/slice;
+        return n<1 ? 1 : n;
+    }
+
+    void GeneralHistogram::PrefetchZSlices(long z1, long z2) {
+        if (mapped==NULL || z2<=z1)
+            return;
+        long slice = GetWidth()*GetHeight()*(depth/8);
+        mapped->Prefetch(z1*slice, (z2-z1)*slice);
+    }
+
+    void GeneralHistogram::DropZSlices(long z1, long z2) {
+        if (mapped==NULL || z2<=z1)
+            return;
+        long slice = GetWidth()*GetHeight()*(depth/8);
+        // start the writeback of the slices, so that they can be dropped
+        // the next time they are visited
+        mapped->Writeback(z1*slice, (z2-z1)*slice, false);
+        mapped->Drop(z1*slice, (z2-z1)*slice, zpasses==0);
+    }
+
+    void GeneralHistogram::BeginZPasses() {
+        zpasses++;
+    }
+
+    void GeneralHistogram::EndZPasses() {
+        if (zpasses>0 && --zpasses==0)
+            DropZSlices(0, GetZSize());
+    }
+
+    bool GeneralHistogram::WritebackDatabuf() {
+        if (mapped==NULL)
+            return false;
+        return mapped->Writeback(0, mapped->GetSize(), true);
+    }
+
+    bool GeneralHistogram::CloneDatabufTo(const std::string target) {
+        if (mapped==NULL)
+            return false;
+        return mapped->CloneTo(target, GetWidth()*GetHeight()*GetZSize()*(depth/8));
+    }
+
     
     void GeneralHistogram::UpdateSCTDCHistoPipe() {
         if (device_descriptor<0)
@@ -686,7 +936,7 @@ namespace SurfaceConceptTDC_ns {
     
     void GeneralHistogram::WriteFile() {
         //std::cout << "GeneralHistogram::WriteFile() called" << std::endl;
-        if (!file_output_active || file_ptr==NULL || databuf==NULL) 
+        if (!file_output_active || file_ptr==NULL || _outbuf()==NULL) 
             return;
         if (file_output_big_endian) {
             _write_file_big_endian();
@@ -700,7 +950,7 @@ namespace SurfaceConceptTDC_ns {
             fwrite(&w, sizeof(w), 1, file_ptr);
             fwrite(&h, sizeof(h), 1, file_ptr);
             fwrite(&d, sizeof(d), 1, file_ptr);
-            fwrite(databuf, bytesz, w*h*GetZSize(), file_ptr);
+            fwrite(_outbuf(), bytesz, w*h*GetZSize(), file_ptr);
             fflush(file_ptr);
         }
     }
@@ -719,51 +969,69 @@ namespace SurfaceConceptTDC_ns {
     }
     
     void GeneralHistogram::WritePGM() {
-        if (!pgm_output_active || databuf==NULL || pgm_path.size()==0) 
+        if (!pgm_output_active || _outbuf()==NULL || pgm_path.size()==0) 
             return;
         if (pipe_type==::sc_pipe_type_t::DLD_SUM_HISTO)
             WritePGM1DPlot();
         else
-            PGM_Export_from_uint32buf_autoBC(pgm_path.c_str(), (uint32_t*) databuf, GetWidth(), GetHeight());
+            PGM_Export_from_uint32buf_autoBC(pgm_path, _databuf_as_uint32(GetWidth()*GetHeight()), GetWidth(), GetHeight(), pgm_scratch);
     }
     
     void GeneralHistogram::WritePGM1DPlot(uint32_t maxvalue) {
-        if (!pgm_output_active || databuf==NULL || pgm_path.size()==0) 
+        if (!pgm_output_active || _outbuf()==NULL || pgm_path.size()==0) 
             return;
         //std::cout << "GetWidth():" << GetWidth() << " ; pgm_width:" << pgm_width << std::endl;
-        uint32_t* binned = AutoBin_uint32Spectrum_To_New_Size((uint32_t*) databuf, GetWidth(), pgm_width);
+        if (pgm_width<1)
+            return;
+        if ((long) pgm_binned.size()<pgm_width)
+            pgm_binned.assign(pgm_width, 0);
+        if (AutoBin_uint32Spectrum_To_New_Size(_databuf_as_uint32(GetWidth()), GetWidth(), pgm_binned.data(), pgm_width)!=0)
+            return;
+        // spectra narrower than the preview are not rebinned, only the first
+        // binned_w entries are valid (the rest is left from earlier spectra)
+        long binned_w = GetWidth()<pgm_width ? GetWidth() : pgm_width;
         if (maxvalue==0)
-            PGM_Export_from_uint32buf_Plot_autoMax(pgm_path.c_str(), binned, pgm_width, pgm_width, pgm_height);
+            PGM_Export_from_uint32buf_Plot_autoMax(pgm_path, pgm_binned.data(), binned_w, pgm_width, pgm_height, pgm_scratch);
         else
-            PGM_Export_from_uint32buf_Plot(pgm_path.c_str(), binned, pgm_width, pgm_width, pgm_height, maxvalue);
+            PGM_Export_from_uint32buf_Plot(pgm_path, pgm_binned.data(), binned_w, pgm_width, pgm_height, maxvalue, pgm_scratch);
     }
 
-    void GeneralHistogram::PerformActiveOutputs() {
+    uint32_t* GeneralHistogram::_databuf_as_uint32(long len) {
+        if (depth==32)
+            return (uint32_t*) _outbuf();
+        if ((long) pgm_converted.size()<len)
+            pgm_converted.resize(len);
+        DispatchBitDepth<UInt32Kernel>(depth, (const void*) _outbuf(), len, pgm_converted.data());
+        return pgm_converted.data();
+    }
+
+    void GeneralHistogram::PerformActiveOutputs(bool tango_output) {
         // these functions only do something if the corresponding bool variable is true
         WriteFile();
         WritePGM();
-        WriteTangoBuffer(); // only does something if tango attribute has been set
+        if (tango_output)
+            WriteTangoBuffer(); // only does something if tango attribute has been set
         UpdateStatisticsOfDatabuf();
     }
 
     void GeneralHistogram::UpdateStatisticsOfDatabuf() {
-        if (databuf!=NULL) {
+        if (_outbuf()!=NULL) {
             if (stathist==NULL) stathist = new StatisticsHist(100);
-            stathist->Update((uint32_t*) databuf, GetWidth()*GetHeight()*GetZSize());
+            DispatchBitDepth<StatisticsKernel>(depth, stathist, (const void*) _outbuf(), GetWidth()*GetHeight()*GetZSize());
         }
             
     }
 
-    uint32_t GeneralHistogram::GetStatMax() {
+    Tango::DevLong GeneralHistogram::GetStatMax() {
         if (stathist!=NULL)
-            return stathist->GetMax();
+            return SaturatedInt32(stathist->GetMax());
         else 
             return 0;
     }
     
-    uint32_t GeneralHistogram::GetStatQuantile(double p) {
+    Tango::DevLong GeneralHistogram::GetStatQuantile(double p) {
         if (stathist!=NULL)
-            return stathist->GetQuantile(p);
+            return SaturatedInt32(stathist->GetQuantile(p));
         else
             return 0;
     }
@@ -787,24 +1055,8 @@ namespace SurfaceConceptTDC_ns {
         fwrite(&w_bigE, sizeof(w_bigE), 1, file_ptr);
         fwrite(&h_bigE, sizeof(h_bigE), 1, file_ptr);
         fwrite(&d_bigE, sizeof(d_bigE), 1, file_ptr);
-        // write the buffer data --- the ugly part
-        long zsize = GetZSize();
-        long h = GetHeight();
-        long w = GetWidth();
-        uint32_t datum;
-        uint8_t* p = (uint8_t*)&datum; // pointer into the bytes of datum for blanking
-        uint8_t* pointer = (uint8_t*) databuf; // used for byte-granular addressing in the databuf array
-        
-        for (long z = 0; z<zsize; z++)
-            for (long y = 0; y<h; y++)
-                for (long x = 0; x<w; x++) {
-                    datum = 0;
-                    memcpy(&datum, pointer, bytesz);
-                    datum = htonl(datum); // swap endianness if necessary
-                    // now we know, that it is big endian
-                    fwrite(p+4-bytesz, bytesz, 1, file_ptr);
-                    pointer += bytesz;
-                }
+        // write the buffer data
+        DispatchBitDepth<BigEndianKernel>(depth, (const void*) _outbuf(), GetWidth()*GetHeight()*GetZSize(), file_ptr);
         fflush(file_ptr);
     }
     
@@ -812,19 +1064,243 @@ namespace SurfaceConceptTDC_ns {
         return file_output_active;
     }
     
+    bool GeneralHistogram::GetPGMOutputActive() {
+        return pgm_output_active;
+    }
+    
     std::string GeneralHistogram::GetFilePath() {
         return file_path;
     }
     
+    void GeneralHistogram::TakeSnapshot() {
+        if (databuf==NULL)
+            return;
+        long len = GetWidth()*GetHeight()*GetZSize()*(depth/8);
+        if (len>databufsize)
+            len = databufsize;
+        snapshot.resize(len);
+        memcpy(snapshot.data(), databuf, len);
+        snapshot_valid = true;
+        ClearBuffer();
+    }
+
+    void GeneralHistogram::ReleaseSnapshot() {
+        snapshot_valid = false;
+    }
+
+    void* GeneralHistogram::_outbuf() {
+        if (!snapshot_valid)
+            return databuf;
+        // the dimensions may have been changed after the snapshot was taken
+        if ((long) snapshot.size()!=GetWidth()*GetHeight()*GetZSize()*(depth/8))
+            return NULL;
+        return snapshot.data();
+    }
+
     void GeneralHistogram::ClearBuffer() {
+        _ResetSweep();
         if (databuf==NULL) 
             return;
-        memset(databuf, '\0', databufsize);
+        _ZeroDatabuf();
     }
     
     long GeneralHistogram::GetDatabufSize() {
         return databufsize;
     }
+
+    long GeneralHistogram::ProjectedDatabufSize(const std::string identifier, long value, long* zsize) {
+        // mirrors the ROI updates of _setAttribute on copies of the ROI
+        long x1 = roix1, x2 = roix2, y1 = roiy1, y2 = roiy2, t1 = roit1, t2 = roit2;
+        long d = depth;
+        if (identifier.compare("ROI_X1")==0) x1 = value;
+        else if (identifier.compare("ROI_X2")==0) x2 = value;
+        else if (identifier.compare("ROI_Y1")==0) y1 = value;
+        else if (identifier.compare("ROI_Y2")==0) y2 = value;
+        else if (identifier.compare("ROI_T1")==0) t1 = value;
+        else if (identifier.compare("ROI_T2")==0) t2 = value;
+        else if (identifier.compare("ROI_TOFF")==0) {
+            // the offset moves the time range, the T size of the pipe is kept
+            long tsize = ROISize(t1, t2);
+            t1 = value;
+            t2 = value + tsize - 1;
+        }
+        else if (identifier.compare("ROI_TSIZE")==0) {
+            t1 = ROIOff(t1, t2);
+            t2 = t1 + value - 1;
+        }
+        else if (identifier.compare("DEPTH")==0 && IsSupportedBitDepth(value))
+            d = value;
+        long sx = ROISize(x1, x2), sy = ROISize(y1, y2), st = ROISize(t1, t2);
+        long voxels = 0;
+        long z = 1;
+        if (pipe_type==::sc_pipe_type_t::DLD_IMAGE_XY) voxels = sx*sy;
+        else if (pipe_type==::sc_pipe_type_t::DLD_IMAGE_XT) voxels = sx*st;
+        else if (pipe_type==::sc_pipe_type_t::DLD_IMAGE_YT) voxels = sy*st;
+        else if (pipe_type==::sc_pipe_type_t::DLD_IMAGE_3D) {
+            voxels = sx*sy*st;
+            z = st;
+        }
+        else if (pipe_type==::sc_pipe_type_t::DLD_SUM_HISTO) voxels = st;
+        if (zsize!=NULL)
+            *zsize = z;
+        return voxels*(d/8);
+    }
+
+    long GeneralHistogram::GetAuxiliaryMemory() {
+        long sum = 0;
+        {
+            std::lock_guard<std::mutex> lock(tango_frame_mutex);
+            for (auto& f : tango_frame_pool)
+                sum += f->data.capacity()*sizeof(Tango::DevLong) + f->taxis.capacity()*sizeof(Tango::DevDouble);
+        }
+        // the preview buffers are only resized by the preview writers, a
+        // slightly outdated value is good enough here
+        sum += pgm_scratch.capacity() + pgm_binned.capacity()*sizeof(uint32_t)
+                + pgm_converted.capacity()*sizeof(uint32_t) + row_occupancy.capacity()
+                + carry_bits.capacity() + row_high.capacity()
+                + overflow.capacity()*sizeof(OverflowTable::value_type) + snapshot.capacity();
+        return sum;
+    }
+
+    int GeneralHistogram::SweepCounters(long max_slices) {
+        long zs = GetZSize();
+        long h = GetHeight(), w = GetWidth();
+        if (databuf==NULL || zs<=0 || depth>=32)
+            return 0;
+        if ((long) row_high.size()!=h*zs) {
+            carry_bits.assign((w*h*zs+7)/8, 0);
+            row_high.assign(h*zs, 0);
+        }
+        if (sweep_cursor>=zs)
+            sweep_cursor = 0;
+        long z1 = sweep_cursor;
+        long z2 = max_slices>0 && z1+max_slices<zs ? z1+max_slices : zs;
+        OverflowTable added;
+        int retval = ForEachZChunk(z1, z2, [&](long c1, long c2) {
+            int n = DispatchBitDepth<SweepKernel>(depth, (const void*) databuf, w, c1*h, c2*h,
+                    carry_bits.data(), row_high.data(), added);
+            return n<0 ? n : 0;
+        });
+        _MergeOverflow(added);
+        if (retval!=0)
+            return 0;
+        sweep_cursor = z2;
+        if (sweep_cursor>=zs) {
+            sweep_cursor = 0;
+            sweeps++;
+        }
+        return (int) added.size();
+    }
+
+    int GeneralHistogram::CompleteSweep() {
+        // the rest of the current sweep, then the slices it has visited
+        // before, such that every voxel is visited after the last count
+        long first = sweep_cursor<GetZSize() ? sweep_cursor : 0;
+        int n = SweepCounters(0);
+        if (first>0)
+            n += SweepCounters(first);
+        return n;
+    }
+
+    void GeneralHistogram::_ResetSweep() {
+        overflow.clear();
+        carry_bits.clear();
+        row_high.clear();
+        sweep_cursor = sweeps = 0;
+        row_occupancy_valid = false;
+    }
+
+    void GeneralHistogram::_MergeOverflow(const OverflowTable& added) {
+        // both tables are sorted, only the entries in the index range of
+        // added are merged, the table stays sorted
+        if (added.empty())
+            return;
+        auto lo = std::lower_bound(overflow.begin(), overflow.end(), std::make_pair(added.front().first, (uint64_t) 0));
+        auto hi = std::lower_bound(lo, overflow.end(), std::make_pair(added.back().first+1, (uint64_t) 0));
+        OverflowTable merged;
+        merged.reserve((hi-lo)+added.size());
+        auto a = added.begin();
+        for (auto o = lo; o!=hi || a!=added.end(); ) {
+            if (a==added.end() || (o!=hi && o->first<a->first))
+                merged.push_back(*o++);
+            else if (o==hi || a->first<o->first)
+                merged.push_back(*a++);
+            else {
+                merged.push_back(std::make_pair(a->first, o->second + a->second));
+                ++o;
+                ++a;
+            }
+        }
+        long pos = lo-overflow.begin();
+        overflow.erase(lo, hi);
+        overflow.insert(overflow.begin()+pos, merged.begin(), merged.end());
+    }
+
+    long GeneralHistogram::GetSweeps() {
+        return sweeps;
+    }
+
+    long GeneralHistogram::UpdateRowOccupancy() {
+        row_occupancy_valid = false;
+        if (databuf==NULL)
+            return 0;
+        long nrows = GetHeight()*GetZSize();
+        row_occupancy.resize(nrows);
+        long h = GetHeight(), w = GetWidth();
+        long occupied = 0;
+        int retval = ForEachZChunk(0, GetZSize(), [&](long z1, long z2) {
+            int n = DispatchBitDepth<RowOccupancyKernel>(depth, (const void*) databuf, z1*h*w, w, (z2-z1)*h, row_occupancy.data()+z1*h);
+            if (n<0)
+                return n;
+            occupied += n;
+            return 0;
+        });
+        if (retval!=0)
+            return 0;
+        row_occupancy_valid = true;
+        return occupied;
+    }
+
+    void GeneralHistogram::InvalidateRowOccupancy() {
+        row_occupancy_valid = false;
+    }
+
+    const uint8_t* GeneralHistogram::GetRowOccupancy() {
+        if (!row_occupancy_valid || (long) row_occupancy.size()!=GetHeight()*GetZSize())
+            return NULL;
+        return row_occupancy.data();
+    }
+
+    const GeneralHistogram::OverflowTable& GeneralHistogram::GetOverflowTable() {
+        return overflow;
+    }
+
+    long GeneralHistogram::GetNrOverflowVoxels() {
+        return (long) overflow.size();
+    }
+
+    uint64_t GeneralHistogram::GetDatabufValue(long index) {
+        if (databuf==NULL || (index+1)*(depth/8)>databufsize)
+            return 0;
+        uint64_t carry = 0;
+        if (!overflow.empty()) {
+            auto it = std::lower_bound(overflow.begin(), overflow.end(), std::make_pair(index, (uint64_t) 0));
+            if (it!=overflow.end() && it->first==index) carry = it->second;
+        }
+        switch (depth) {
+            case 8:  return carry + ((uint8_t*) databuf)[index];
+            case 16: return carry + ((uint16_t*) databuf)[index];
+            case 32: return carry + ((uint32_t*) databuf)[index];
+            case 64: return carry + ((uint64_t*) databuf)[index];
+            default: return 0;
+        }
+    }
+
+    void GeneralHistogram::ZeroDatabufValue(long index) {
+        if (databuf==NULL || (index+1)*(depth/8)>databufsize)
+            return;
+        memset((uint8_t*) databuf + index*(depth/8), 0, depth/8);
+    }
     
     void GeneralHistogram::SetPGMSize(int width, int height) {
         if (width>0) pgm_width = width;
@@ -839,86 +1315,104 @@ namespace SurfaceConceptTDC_ns {
         return pgm_width;
     }
 
-    void GeneralHistogram::_write_taxis(int w_) {
-        if (taxis_active && tango_taxis_attr!=NULL) {
-            int max_x = tango_taxis_attr->get_max_x();
-            w_ = w_>max_x?max_x:w_;
-            tangobuf_taxis.resize(w_);
-            //AccomodateTangobuffer<Tango::DevDouble>(&tangobuf_taxis, w_, h_, false);
-            if (taxis_unit==taxis_unit_s)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-12);
-            else if (taxis_unit==taxis_unit_ms)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-9);
-            else if (taxis_unit==taxis_unit_us)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-6);
-            else if (taxis_unit==taxis_unit_ns)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-3);
-            else if (taxis_unit==taxis_unit_ps)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint);            
-            else if (taxis_unit==taxis_unit_pixels)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = (Tango::DevDouble) x+roit1;
-            else if (taxis_unit==taxis_unit_unbinned)
-                for (int x=0; x<w_; x++)
-                    tangobuf_taxis[x] = ((Tango::DevDouble) x+roit1)*((Tango::DevDouble) bint);
+    void GeneralHistogram::_write_taxis(vector<Tango::DevDouble>& taxis, int w_) {
+        if (!taxis_active || tango_taxis_attr==NULL) {
+            taxis.clear();
+            return;
         }
-        
+        int max_x = tango_taxis_attr->get_max_x();
+        w_ = w_>max_x?max_x:w_;
+        taxis.resize(w_);
+        if (taxis_unit==taxis_unit_s)
+            for (int x=0; x<w_; x++)
+                taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-12);
+        else if (taxis_unit==taxis_unit_ms)
+            for (int x=0; x<w_; x++)
+                taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-9);
+        else if (taxis_unit==taxis_unit_us)
+            for (int x=0; x<w_; x++)
+                taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-6);
+        else if (taxis_unit==taxis_unit_ns)
+            for (int x=0; x<w_; x++)
+                taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint*1e-3);
+        else if (taxis_unit==taxis_unit_ps)
+            for (int x=0; x<w_; x++)
+                taxis[x] = (Tango::DevDouble) (((double)(x+roit1))*taxis_pixelsize*bint);            
+        else if (taxis_unit==taxis_unit_pixels)
+            for (int x=0; x<w_; x++)
+                taxis[x] = (Tango::DevDouble) x+roit1;
+        else if (taxis_unit==taxis_unit_unbinned)
+            for (int x=0; x<w_; x++)
+                taxis[x] = ((Tango::DevDouble) x+roit1)*((Tango::DevDouble) bint);
+    }
+
+    std::shared_ptr<TangoFrame> GeneralHistogram::_acquire_tango_frame() {
+        // a pooled frame that nobody else references is neither published
+        // nor pinned by a reader, and since only published frames can be
+        // picked up by readers, it can be safely overwritten
+        for (auto& f : tango_frame_pool) {
+            if (f.use_count()==1) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return f;
+            }
+        }
+        std::shared_ptr<TangoFrame> f = std::make_shared<TangoFrame>();
+        if (tango_frame_pool.size()<tango_frame_pool_size)
+            tango_frame_pool.push_back(f);
+        return f; // readers hold on to many frames, this one is not recycled
     }
     
     void GeneralHistogram::WriteTangoBufferDevLong(int max_x, int max_y) {
-        // ONLY SUPPORTS BIT DEPTH OF 32!!
         // w and h are the dimensions of the Tango attribute
-        if (databuf==NULL) return;
+        if (_outbuf()==NULL) return;
         int w_ = max_x>GetWidth()?GetWidth():max_x;   // minimum of our dimensions and the tango attribute: 
         int h_ = max_y>GetHeight()?GetHeight():max_y; // cannot write more than we have, and cannot write more than the Tango attribute allows
         h_ = h_<2?1:h_; // h=0 is used in Tango to signal a spectrum (or scalar?) attribute (no y axis)
-        tangobuf.resize(w_*h_);
-        //AccomodateTangobuffer<Tango::DevLong>(&tangobuf, w_, h_, false);
-        // do the copying
-        int x,y;
-        int databufw = GetWidth();
-        uint32_t* buf = (uint32_t*) databuf;
-        for (y=0; y<h_; y++)
-            for (x=0; x<w_; x++) {
-                tangobuf[y*w_+x] = (Tango::DevLong) buf[x+y*databufw];
-            }
-        _write_taxis(w_);
-        tangobuf_datawidth = w_;
-        tangobuf_dataheight = h_;
+        std::lock_guard<std::mutex> lock(tango_frame_mutex);
+        std::shared_ptr<TangoFrame> frame = _acquire_tango_frame();
+        frame->data.resize(w_*h_);
+        // do the copying (counts above the DevLong range are clipped)
+        DispatchBitDepth<TangoCopyKernel>(depth, (const void*) _outbuf(), (int) GetWidth(), frame->data.data(), w_, h_);
+        _write_taxis(frame->taxis, w_);
+        frame->width = w_;
+        frame->height = h_;
+        frame->seq = ++tango_frame_seq;
+        std::atomic_store(&tango_frame, TangoFramePtr(frame));
     }
     
     void GeneralHistogram::AddToTangoAccuBufferDevLong(int max_x, int max_y) {
-        // ONLY SUPPORTS BIT DEPTH OF 32!!
         // w and h are the dimensions of the Tango attribute
-        if (databuf==NULL) return;
+        if (_outbuf()==NULL) return;
         int w_ = max_x>GetWidth()?GetWidth():max_x;   // minimum of our dimensions and the tango attribute: 
         int h_ = max_y>GetHeight()?GetHeight():max_y; // cannot write more than we have, and cannot write more than the Tango attribute allows
         h_ = h_<2?1:h_; // h=0 is used in Tango to signal a spectrum (or scalar?) attribute (no y axis)
-        tangobuf_accu.resize(w_,h_);
-        //AccomodateTangobuffer<Tango::DevLong>(&tangobuf_accu, w_, h_, true); // rereserves memory if expanding
-        // do the copying
-        int x,y;
-        int databufw = GetWidth();
-        uint32_t* buf = (uint32_t*) databuf;
-        for (y=0; y<h_; y++)
-            for (x=0; x<w_; x++) {
-                tangobuf_accu[y*w_+x] += (Tango::DevLong) buf[x+y*databufw];
-            }
-        _write_taxis(w_);
-        // update the data x and y sizes reported by GetTangoBufferDataWidth()/Height()
-        tangobuf_datawidth = w_;
-        tangobuf_dataheight = h_; 
+        std::lock_guard<std::mutex> lock(tango_frame_mutex);
+        TangoFramePtr prev = std::atomic_load(&tango_accu_frame);
+        std::shared_ptr<TangoFrame> frame = _acquire_tango_frame();
+        frame->data.resize(w_*h_);
+        // new frame = previous frame + current data; the previous frame is
+        // only read, so readers of it keep seeing consistent values
+        bool addprev = (prev && prev->width==w_ && prev->height==h_);
+        const Tango::DevLong* in = addprev ? prev->data.data() : NULL;
+        DispatchBitDepth<TangoAccuKernel>(depth, (const void*) _outbuf(), (int) GetWidth(), frame->data.data(), in, w_, h_);
+        frame->taxis.clear();
+        frame->width = w_;
+        frame->height = h_;
+        frame->seq = ++tango_frame_seq;
+        std::atomic_store(&tango_accu_frame, TangoFramePtr(frame));
     }
 
     void GeneralHistogram::ZeroTangoAccuBufferDevLong() {
-        if (tangobuf_accu.size()==0) return;
-        for (std::size_t i=0; i<tangobuf_accu.size(); i++)
-            tangobuf_accu[i] = 0;
+        std::lock_guard<std::mutex> lock(tango_frame_mutex);
+        TangoFramePtr prev = std::atomic_load(&tango_accu_frame);
+        if (!prev) return;
+        std::shared_ptr<TangoFrame> frame = _acquire_tango_frame();
+        frame->data.assign(prev->data.size(), 0);
+        frame->taxis.clear();
+        frame->width = prev->width;
+        frame->height = prev->height;
+        frame->seq = ++tango_frame_seq;
+        std::atomic_store(&tango_accu_frame, TangoFramePtr(frame));
     }
 
     void GeneralHistogram::SetTangoAccuBufferActive(bool active_) {
@@ -933,6 +1427,10 @@ namespace SurfaceConceptTDC_ns {
         tango_image_attr = attr;
     }
     
+    void GeneralHistogram::SetTangoFrameOutputActive(bool active) {
+        tango_frame_output = active;
+    }
+    
     void GeneralHistogram::WriteTangoBuffer() {
         //std::cout << "WriteTangoBuffer() got called" << std::endl;
         if (tango_spectrum_attr!=NULL) {
@@ -946,6 +1444,9 @@ namespace SurfaceConceptTDC_ns {
             long max_y = tango_image_attr->get_max_y();
             WriteTangoBufferDevLong(max_x, max_y);
         }
+        else if (tango_frame_output) {
+            WriteTangoBufferDevLong(GetWidth(), GetHeight());
+        }
     }
 
     void GeneralHistogram::AddToTangoAccuBuffer() {
@@ -960,24 +1461,12 @@ namespace SurfaceConceptTDC_ns {
         }
     }
     
-    long GeneralHistogram::GetTangoBufferDataWidth() {
-        return tangobuf_datawidth;
-    }
-
-    long GeneralHistogram::GetTangoBufferDataHeight() {
-        return tangobuf_dataheight;
+    TangoFramePtr GeneralHistogram::GetTangoFrame() {
+        return std::atomic_load(&tango_frame);
     }
 
-    Tango::DevLong* GeneralHistogram::GetTangoBuffer() {
-        return tangobuf.data();
-    }
-
-    Tango::DevLong* GeneralHistogram::GetTangoAccuBuffer() {
-        return tangobuf_accu.data();
-    }
-    
-    Tango::DevDouble* GeneralHistogram::getTAxis() {
-        return tangobuf_taxis.data();
+    TangoFramePtr GeneralHistogram::GetTangoAccuFrame() {
+        return std::atomic_load(&tango_accu_frame);
     }
     
     void GeneralHistogram::ProvideTAxis(CustomSpectrumAttr* taxis_attr, double pixelsize, int unit) {
@@ -34,8 +34,12 @@
 #include <scTDC.h>
 #include <tango.h>
 #include <climits>
-#include "CustomAttr.h"
+#include <memory>
+#include <map>
+#include <vector>
+#include <mutex>
 #include "StatisticsHist.h"
+#include "MappedFileBuffer.h"
 
 using std::vector;
 
@@ -44,6 +48,20 @@ namespace SurfaceConceptTDC_ns {
     class CustomSpectrumAttr;
     class CustomImageAttr;
     
+    /**
+     * Immutable snapshot of a histogram as handed to Tango. Frames are
+     * published atomically; readers keep the shared_ptr alive for as long as
+     * Tango needs the data, the writer never modifies a published frame.
+     */
+    struct TangoFrame {
+        vector<Tango::DevLong>   data;
+        vector<Tango::DevDouble> taxis;  // empty if no time axis is provided
+        long width  = 0;
+        long height = 0;
+        unsigned long seq = 0;           // incremented with every publication
+    };
+    typedef std::shared_ptr<const TangoFrame> TangoFramePtr;
+
     class GeneralHistogram {
     public:
         static const int MODULO_FACTOR = 1; // multiply user input of modulos by this number at the sctdc pipe level
@@ -186,9 +204,10 @@ namespace SurfaceConceptTDC_ns {
         void SetPGMOutputActive(bool state, int width=256, int height=128);
         void SetTangoOutAttribute(CustomSpectrumAttr* attr=NULL);  // overloaded function for spectrum attributes
         void SetTangoOutAttribute(CustomImageAttr* attr=NULL); // overloaded function for image attributes
+        // publish frames of the full histogram even without a Tango attribute (e.g. for viewports)
+        void SetTangoFrameOutputActive(bool active);
         void ProvideTAxis(CustomSpectrumAttr* taxis_attr=NULL, double pixelsize=1.0, int unit=taxis_unit_pixels);
         void SetTAxisUnit(int unit);
-        Tango::DevDouble* getTAxis();
 
         
         /**
@@ -197,6 +216,7 @@ namespace SurfaceConceptTDC_ns {
          * @returns true, if file output is active, otherwise false
          */
         bool GetFileOutputActive();
+        bool GetPGMOutputActive();
         
         void SetFileOutputBigEndian(bool state); // if false, use architectural standard
         bool GetFileOutputBigEndian();           // (... might be big endian as well)
@@ -218,17 +238,34 @@ namespace SurfaceConceptTDC_ns {
         void AddToTangoAccuBuffer();
         void AddToTangoAccuBufferDevLong(int w, int h);
         void ZeroTangoAccuBufferDevLong();
-        Tango::DevLong* GetTangoBuffer();
-        Tango::DevLong* GetTangoAccuBuffer();
-        long GetTangoBufferDataWidth();
-        long GetTangoBufferDataHeight();
+        
+        /**
+         * Return the most recently published live/accumulated frame (may be
+         * NULL if nothing was published yet). The frame stays valid for as
+         * long as the caller holds the pointer, concurrent writes go to a
+         * different frame.
+         */
+        TangoFramePtr GetTangoFrame();
+        TangoFramePtr GetTangoAccuFrame();
         
         void UpdateStatisticsOfDatabuf();
-        uint32_t GetStatMax();
-        uint32_t GetStatQuantile(double p);
+        Tango::DevLong GetStatMax();               // clipped to the DevLong range
+        Tango::DevLong GetStatQuantile(double p);
         
         
-        void PerformActiveOutputs();
+        /**
+         * Write files, PGM previews and statistics of the data buffer, and,
+         * if tango_output is true, publish a new Tango frame
+         */
+        void PerformActiveOutputs(bool tango_output=true);
+        /**
+         * Copy the data buffer and zero it, between two measurements: until
+         * ReleaseSnapshot, the outputs (files, previews, Tango frames and
+         * statistics) are computed from the copy, while the next measurement
+         * fills the data buffer.
+         */
+        void TakeSnapshot();
+        void ReleaseSnapshot();
 
         // #####################################################################
         // #####################################################################
@@ -236,9 +273,98 @@ namespace SurfaceConceptTDC_ns {
         static int AllocatorCallback(void *object, void **bufpointer); // to be called by the scTDC library
         void* GetDatabufPointer();
         long GetDatabufSize();
+        /**
+         * the size in bytes the data buffer would need after
+         * SetAttribute(identifier, value), without changing anything;
+         * zsize receives the projected size of the z axis if not NULL
+         */
+        long ProjectedDatabufSize(const std::string identifier, long value, long* zsize=NULL);
+        long GetAuxiliaryMemory(); // Tango frames and previews, in bytes (approximate)
+        uint64_t GetDatabufValue(long index);   // independent of the bit depth, includes the overflow table
+        void ZeroDatabufValue(long index);
+        
+        // voxel index -> carry, sorted by index (16 bytes per wrapped voxel)
+        typedef std::vector<std::pair<long, uint64_t> > OverflowTable;
+
+        /**
+         * Sweeps through the data buffer during long accumulations; each
+         * call continues where the last one stopped and visits at most
+         * max_slices z slices (0: up to the end), such that a call stays
+         * bounded. The data buffer is only read, a measurement may count
+         * into it meanwhile; the caller must hold off other callers, readers
+         * of the overflow table and reallocations.
+         * Only narrow (8/16-bit) counters are swept: the high bit of every
+         * voxel is kept (one bit per voxel), a counter whose high bit was
+         * set at the last visit and is cleared now has wrapped around, and
+         * its range is added to a sparse overflow table. As long
+         * as no voxel gains half of the range between two visits (one
+         * sweep), no counts are lost. Readers of the data buffer add the
+         * table (see GetOverflowTable).
+         * @return the number of voxels that have wrapped around
+         */
+        int SweepCounters(long max_slices);
+        int CompleteSweep(); // visits every voxel once, e.g. after the last measurement
+        long GetSweeps(); // complete sweeps since the buffer was cleared
+        const OverflowTable& GetOverflowTable();
+        long GetNrOverflowVoxels();
+        
+        /**
+         * Flag the rows (one row = width voxels at fixed y and z) that hold
+         * counts, so that integrations and exports can skip empty rows. The
+         * flags are a snapshot: the caller must hold off writers of the data
+         * buffer or accept that counts arriving afterwards in empty rows are
+         * missed until the next update, and invalidate them when done.
+         * UpdateRowOccupancy passes through the whole data buffer.
+         * @return the number of occupied rows
+         */
+        long UpdateRowOccupancy();
+        void InvalidateRowOccupancy();
+        const uint8_t* GetRowOccupancy(); // one flag per row, NULL if not valid
         void ClearBuffer();
         void AccomodateDatabufSize(bool zerobuf=false);
         void ReleaseDatabuf();
+
+        /**
+         * Out-of-core mode: keep the data buffer in a memory-mapped file
+         * (see MappedFileBuffer.h) instead of the buffer pool, empty path:
+         * back to memory. Takes effect with the next allocation, the
+         * current data buffer is released. Passes through the data buffer
+         * visit chunk_bytes at a time (rounded to whole z slices).
+         */
+        void SetBackingFile(const std::string path, long chunk_bytes);
+        std::string GetBackingFile();
+        bool IsFileBacked();          // the current data buffer is a mapped file
+        long GetChunkZSize();         // z slices per chunk, GetZSize() if not file backed
+        void PrefetchZSlices(long z1, long z2);  // read ahead, no-op if not file backed
+        void DropZSlices(long z1, long z2);      // done with the slices, see MappedFileBuffer::Drop
+        /**
+         * several passes through the data buffer in a row (e.g. the
+         * projections of one refresh): between BeginZPasses and the matching
+         * EndZPasses, DropZSlices leaves the slices in the page cache, such
+         * that the following passes do not read them from the disk again;
+         * EndZPasses drops the whole buffer. Calls may be nested.
+         */
+        void BeginZPasses();
+        void EndZPasses();
+        bool WritebackDatabuf();      // wait until the data buffer is written to the file
+        bool CloneDatabufTo(const std::string target); // file copy of the data (without padding)
+        /**
+         * call f(c1, c2) for the chunks [c1, c2) of the z slices z1..z2-1,
+         * reading ahead one chunk and dropping the chunks that are done
+         * @return the first non-zero return value of f, otherwise 0
+         */
+        template<typename F> int ForEachZChunk(long z1, long z2, F f) {
+            long n = GetChunkZSize();
+            for (long z = z1; z<z2; z += n) {
+                long zn = z+n<z2 ? z+n : z2;
+                PrefetchZSlices(zn, zn+n<z2 ? zn+n : z2);
+                int retval = f(z, zn);
+                DropZSlices(z, zn);
+                if (retval!=0)
+                    return retval;
+            }
+            return 0;
+        }
         
         // #####################################################################
         // #####################################################################
@@ -263,21 +389,43 @@ namespace SurfaceConceptTDC_ns {
         int pgm_width               = 256;
         int pgm_height              = 128;
         std::string pgm_path        = "";
+        vector<char>     pgm_scratch;  // rendered 8-bit image, reused between previews
+        vector<uint32_t> pgm_binned;   // rebinned spectrum for 1D plots, reused
+        vector<uint32_t> pgm_converted; // data buffer as uint32 if depth!=32, reused
+        vector<uint8_t> snapshot;      // see TakeSnapshot, reused
+        bool snapshot_valid = false;
         
         void *databuf = NULL;  // pointer to the data buffer object
+        OverflowTable overflow;            // carries of wrapped voxels, cleared with the data buffer
+        vector<uint8_t> carry_bits;        // high bit of every voxel at its last visit, see SweepCounters
+        vector<uint8_t> row_high;          // one flag per row: any high bit set at the last visit
+        long sweep_cursor = 0;             // first z slice of the next sweep call, see SweepCounters
+        long sweeps = 0;
+        vector<uint8_t> row_occupancy;     // see UpdateRowOccupancy
+        bool row_occupancy_valid = false;
         long databufsize = 0;  // size of the allocated memory for the data buffer in bytes
-        
-        vector<Tango::DevLong>   tangobuf;
-        long                     tangobuf_width         = -1;  // capacity width of the Tango buffer
-        long                     tangobuf_height        = -1;  // capacity height of the Tango buffer
-        long                     tangobuf_datawidth     = -1;  // actual width of the data in the Tango buffer
-        long                     tangobuf_dataheight    = -1;  // actual height of the data in the Tango buffer
-        vector<Tango::DevLong>   tangobuf_accu;
+        std::string backing_file = "";      // empty: data buffer from the BufferPool
+        long backing_chunk_bytes = 0;
+        MappedFileBuffer* mapped = NULL;    // the mapped backing file while allocated
+        int zpasses = 0;                    // see BeginZPasses
+        void* _MapDatabuf(long bytes, long& capacity);
+        void  _UnmapDatabuf();
+        void  _ZeroDatabuf();
+        void  _MergeOverflow(const OverflowTable& added);
+        void  _ResetSweep(); // forgets the overflow table and the sweep state
+        void* _outbuf(); // the data the outputs are computed from, NULL if none
+        
+        static const std::size_t tango_frame_pool_size  = 6;  // live+accu: published, pinned by a reader, spare
+        TangoFramePtr            tango_frame;        // published live frame, access via std::atomic_load/store
+        TangoFramePtr            tango_accu_frame;   // published accumulated frame
+        vector<std::shared_ptr<TangoFrame> > tango_frame_pool; // recycled frames, owned by the writer
+        std::mutex               tango_frame_mutex;  // serializes writers only, readers never lock
+        unsigned long            tango_frame_seq        = 0;
         bool                     tangobuf_accu_active   = false;
         CustomSpectrumAttr*      tango_spectrum_attr    = NULL;
         CustomImageAttr*         tango_image_attr       = NULL;
+        bool                     tango_frame_output     = false;
 
-        vector<Tango::DevDouble> tangobuf_taxis;
         CustomSpectrumAttr*      tango_taxis_attr       = NULL;
         bool                     taxis_active           = false;
         double                   taxis_pixelsize        = 0.0;
@@ -292,7 +440,9 @@ namespace SurfaceConceptTDC_ns {
         // _write_file_big_endian is private and called by WriteFile if necessary
         // ( users of the class can control this via SetFileOutputBigEndian(true/false))
         void _write_file_big_endian(); // write file in big-endian byte order
-        void _write_taxis(int w_);
+        void _write_taxis(vector<Tango::DevDouble>& taxis, int w_);
+        uint32_t* _databuf_as_uint32(long len); // for the uint32 PGM export
+        std::shared_ptr<TangoFrame> _acquire_tango_frame(); // caller must hold tango_frame_mutex
         
         //template <typename T> void AccomodateTangobuffer(T** buf, int w, int h, bool zero=false);
         
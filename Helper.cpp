@@ -260,6 +260,13 @@ namespace Helper {
         //std::cout << "clock_gettime gave us " << t.tv_sec << " seconds and " << t.tv_nsec << " nanoseconds" << std::endl;
         return t.tv_sec*1000+t.tv_nsec/1000000;
     }
+    
+    long long get_nanosec(){
+        // precise (non-coarse) monotonic clock, for latency measurements
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return ((long long) t.tv_sec)*1000000000LL+t.tv_nsec;
+    }
   
     
     std::string to_lower(const std::string src) {
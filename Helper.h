@@ -66,6 +66,7 @@ namespace Helper {
     
     void sleep(unsigned milliseconds);
     long get_millisec();
+    long long get_nanosec();
     
     std::string Format_Bytesize(long sz, int precision);
     
@@ -23,11 +23,144 @@
  */
 
 #include "IntegrateXYT.h"
+#include "BitDepth.h"
+#include "BufferKernels.h"
 
 namespace SurfaceConceptTDC_ns {
+
+    // integration kernels over the pixel types S of the 3D data set and
+    // D of the target (see BitDepth.h); occ holds one flag per row (t,y) of
+    // the data set, rows without counts are skipped (NULL: no rows skipped);
+    // the kernels visit the time slices t1..t2-1, so that they can be run
+    // chunk by chunk (see GeneralHistogram::ForEachZChunk)
+    namespace {
+        // sum of a contiguous row, the 32-bit rows use the vectorized sum
+        // (the truncation to D gives the same result as summing in D)
+        template<typename D, typename S> inline D RowSum(const S* row, long n) {
+            D sum = 0;
+            for (long x = 0; x<n; x++)
+                sum += (D) row[x];
+            return sum;
+        }
+
+        template<typename D> inline D RowSum(const uint32_t* row, long n) {
+            return (D) BufferKernels::sum_uint32(row, n);
+        }
+
+        template<typename S, typename D> struct IntegrateTKernel {
+            static int Run(const void* src, void* dst, const uint8_t* occ, long w, long h, long t1, long t2) {
+                const S* pxyt = (const S*) src;
+                D* pxy = (D*) dst;
+                long x,y,t, srcoff, targoff;
+                for (t = t1; t<t2; t++) {
+                    for (y = 0; y<h; y++) {
+                        if (occ!=NULL && !occ[t*h+y]) continue;
+                        srcoff = t*w*h+y*w;
+                        targoff = y*w;
+                        for (x = 0; x<w; x++) {
+                            *(pxy+targoff+x) += (D) *(pxyt+srcoff+x);
+                        }
+                    }
+                }
+                return 0;
+            }
+        };
+
+        template<typename S, typename D> struct IntegrateYKernel {
+            static int Run(const void* src, void* dst, const uint8_t* occ, long w, long h, long t1, long t2, long y1, long y2) {
+                const S* pxyt = (const S*) src;
+                D* pxt = (D*) dst;
+                long x,y,t, srcoff, targoff;
+                for (t = t1; t<t2; t++) {
+                    for (y = y1; y<y2; y++) {
+                        if (occ!=NULL && !occ[t*h+y]) continue;
+                        srcoff = t*w*h+y*w;
+                        targoff = t*w;
+                        for (x = 0; x<w; x++) {
+                            *(pxt+targoff+x) += (D) *(pxyt+srcoff+x);
+                        }
+                    }
+                }
+                return 0;
+            }
+        };
+
+        template<typename S, typename D> struct IntegrateXKernel {
+            static int Run(const void* src, void* dst, const uint8_t* occ, long w, long h, long t1, long t2, long x1, long x2) {
+                const S* pxyt = (const S*) src;
+                D* pyt = (D*) dst;
+                long y,t, srcoff, targoff;
+                for (t = t1; t<t2; t++) {
+                    for (y = 0; y<h; y++) {
+                        if (occ!=NULL && !occ[t*h+y]) continue;
+                        srcoff = t*w*h+y*w;
+                        targoff = t*h+y;  // in target image, h is the width and zs is the height! y is on the x axis!
+                        // reduce the contiguous row in a local sum instead of
+                        // through the target pointer
+                        *(pyt+targoff) += RowSum<D>(pxyt+srcoff+x1, x2-x1);
+                    }
+                }
+                return 0;
+            }
+        };
+
+        template<typename S, typename D> struct IntegrateXYKernel {
+            static int Run(const void* src, void* dst, const uint8_t* occ, long w, long h, long t1, long t2, long x1, long x2, long y1, long y2) {
+                const S* pxyt = (const S*) src;
+                D* pt = (D*) dst;
+                long y,t, srcoff, targoff;
+                for (t = t1; t<t2; t++) {
+                    targoff = t;
+                    D sum = 0; // local sum, see IntegrateXKernel
+                    for (y = y1; y<y2; y++) {
+                        if (occ!=NULL && !occ[t*h+y]) continue;
+                        srcoff = t*w*h+y*w;
+                        sum += RowSum<D>(pxyt+srcoff+x1, x2-x1);
+                    }
+                    *(pt+targoff) += sum;
+                }
+                return 0;
+            }
+        };
+
+        template<typename D> struct AddCarriesKernel {
+            static int Run(void* dst, const std::vector<std::pair<long, uint64_t> >& carries) {
+                D* p = (D*) dst;
+                for (auto& c : carries)
+                    p[c.first] += (D) c.second;
+                return 0;
+            }
+        };
+    }
+
+    /**
+     * add the carries of wrapped voxels of the 3D data set (see
+     * GeneralHistogram::SweepCounters) to the target;
+     * targetindex maps x,y,t to the index in the target or -1 if the voxel
+     * is outside of the integration range
+     */
+    template<typename F>
+    static int _AddOverflow(GeneralHistogram& xyt, GeneralHistogram& target, F targetindex) {
+        const GeneralHistogram::OverflowTable& overflow = xyt.GetOverflowTable();
+        if (overflow.empty())
+            return 0;
+        long w = xyt.GetWidth();
+        long h = xyt.GetHeight();
+        std::vector<std::pair<long, uint64_t> > carries;
+        for (auto& o : overflow) {
+            long t = o.first/(w*h);
+            long y = (o.first/w)%h;
+            long x = o.first%w;
+            long i = targetindex(x, y, t);
+            if (i>=0)
+                carries.push_back(std::make_pair(i, o.second));
+        }
+        return DispatchBitDepth<AddCarriesKernel>(target.depth, target.GetDatabufPointer(), carries);
+    }
     
     std::string IntegrateXYT_ErrMsg(int errcode) {
         if (errcode==0) return std::string("No error.");
+        else if (errcode==-1) return std::string("Unsupported bit depth.");
         else return std::string("Unknown error.");
     }
     
@@ -49,20 +182,12 @@ namespace SurfaceConceptTDC_ns {
         target.SetHeight(xyt.GetHeight());
         //
         target.AccomodateDatabufSize(true); // true = also clears databuffer
-        long x,y,t, srcoff, targoff;
-        uint32_t* pxyt = (uint32_t*) xyt.GetDatabufPointer();
-        uint32_t* pxy = (uint32_t*) target.GetDatabufPointer();
-        
-        for (t = t1; t<t2; t++) {
-            for (y = 0; y<h; y++) {
-                srcoff = t*w*h+y*w;
-                targoff = y*w;
-                for (x = 0; x<w; x++) {
-                    *(pxy+targoff+x) += *(pxyt+srcoff+x);
-                }
-            }
-        }
-        return 0;
+        int retval = xyt.ForEachZChunk(t1, t2, [&](long c1, long c2) {
+            return DispatchBitDepths<IntegrateTKernel>(xyt.depth, target.depth,
+                (const void*) xyt.GetDatabufPointer(), target.GetDatabufPointer(), xyt.GetRowOccupancy(), w, h, c1, c2); });
+        if (retval!=0) return retval;
+        return _AddOverflow(xyt, target, [=](long x, long y, long t) {
+            return (t>=t1 && t<t2) ? y*w+x : -1L; });
     }
     
     int IntegrateXYT_Y(GeneralHistogram& xyt, GeneralHistogram& target, long y1, long y2) {
@@ -82,22 +207,13 @@ namespace SurfaceConceptTDC_ns {
         target.SetHeight(xyt.GetZSize());
         //
         target.AccomodateDatabufSize(true); // true = also clears databuffer
-        long x,y,t, srcoff, targoff;
         target.ClearBuffer();
-        uint32_t* pxyt = (uint32_t*) xyt.GetDatabufPointer();
-        uint32_t* pxt = (uint32_t*) target.GetDatabufPointer();
-        
-        for (t = 0; t<zs; t++) {
-            for (y = y1; y<y2; y++) {
-                srcoff = t*w*h+y*w;
-                targoff = t*w;
-                for (x = 0; x<w; x++) {
-                    uint32_t pixelval = *(pxyt+srcoff+x);
-                    *(pxt+targoff+x) += pixelval;
-                }
-            }
-        }
-        return 0;
+        int retval = xyt.ForEachZChunk(0, zs, [&](long c1, long c2) {
+            return DispatchBitDepths<IntegrateYKernel>(xyt.depth, target.depth,
+                (const void*) xyt.GetDatabufPointer(), target.GetDatabufPointer(), xyt.GetRowOccupancy(), w, h, c1, c2, y1, y2); });
+        if (retval!=0) return retval;
+        return _AddOverflow(xyt, target, [=](long x, long y, long t) {
+            return (y>=y1 && y<y2) ? t*w+x : -1L; });
     }
 
     int IntegrateXYT_X(GeneralHistogram& xyt, GeneralHistogram& target, long x1, long x2) {
@@ -117,21 +233,13 @@ namespace SurfaceConceptTDC_ns {
         target.SetHeight(xyt.GetZSize());
         //
         target.AccomodateDatabufSize(true); // true = also clears databuffer
-        long x,y,t, srcoff, targoff;
         target.ClearBuffer();
-        uint32_t* pxyt = (uint32_t*) xyt.GetDatabufPointer();
-        uint32_t* pyt = (uint32_t*) target.GetDatabufPointer();
-        
-        for (t = 0; t<zs; t++) {
-            for (y = 0; y<h; y++) {
-                srcoff = t*w*h+y*w;
-                targoff = t*h+y;  // in target image, h is the width and zs is the height! y is on the x axis!
-                for (x = x1; x<x2; x++) {
-                    *(pyt+targoff) += *(pxyt+srcoff+x);
-                }
-            }
-        }
-        return 0;
+        int retval = xyt.ForEachZChunk(0, zs, [&](long c1, long c2) {
+            return DispatchBitDepths<IntegrateXKernel>(xyt.depth, target.depth,
+                (const void*) xyt.GetDatabufPointer(), target.GetDatabufPointer(), xyt.GetRowOccupancy(), w, h, c1, c2, x1, x2); });
+        if (retval!=0) return retval;
+        return _AddOverflow(xyt, target, [=](long x, long y, long t) {
+            return (x>=x1 && x<x2) ? t*h+y : -1L; });
     }
 
     int IntegrateXYT_XY(GeneralHistogram& xyt, GeneralHistogram& target, long x1, long x2, long y1, long y2) {
@@ -155,19 +263,12 @@ namespace SurfaceConceptTDC_ns {
         target.SetAbscissaOffset(xyt.GetZOffset());
         target.SetWidth(xyt.GetZSize());
         target.AccomodateDatabufSize(true); // true = also clears databuffer
-        long x,y,t, srcoff, targoff;
         target.ClearBuffer();
-        uint32_t* pxyt = (uint32_t*) xyt.GetDatabufPointer();
-        uint32_t* pt = (uint32_t*) target.GetDatabufPointer();
-        for (t = 0; t<zs; t++) {
-            targoff = t;
-            for (y = y1; y<y2; y++) {
-                srcoff = t*w*h+y*w;
-                for (x = x1; x<x2; x++) {
-                    *(pt+targoff) += *(pxyt+srcoff+x);
-                }
-            }
-        }
-        return 0;
+        int retval = xyt.ForEachZChunk(0, zs, [&](long c1, long c2) {
+            return DispatchBitDepths<IntegrateXYKernel>(xyt.depth, target.depth,
+                (const void*) xyt.GetDatabufPointer(), target.GetDatabufPointer(), xyt.GetRowOccupancy(), w, h, c1, c2, x1, x2, y1, y2); });
+        if (retval!=0) return retval;
+        return _AddOverflow(xyt, target, [=](long x, long y, long t) {
+            return (x>=x1 && x<x2 && y>=y1 && y<y2) ? t : -1L; });
     }
 }
@@ -0,0 +1,195 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "LaneExecutor.h"
+#include "PipelineTelemetry.h"
+#include "PipelineTrace.h"
+
+LaneExecutor::LaneExecutor() {
+    
+}
+
+LaneExecutor::~LaneExecutor() {
+    Stop();
+}
+
+int LaneExecutor::AddLane(const std::string& name, int workers, int nice_value) {
+    std::unique_ptr<Lane> l(new Lane());
+    l->name       = name;
+    l->trace_name = name+" job";
+    l->workers    = workers<1 ? 1 : workers;
+    l->nice_value = nice_value;
+    lanes.push_back(std::move(l));
+    return (int) lanes.size()-1;
+}
+
+void LaneExecutor::SetLaneWorkers(int lane, int workers) {
+    if (lane<0 || lane>=(int) lanes.size() || started)
+        return;
+    lanes[lane]->workers = workers<1 ? 1 : workers;
+}
+
+void LaneExecutor::SetLaneNice(int lane, int nice_value) {
+    if (lane<0 || lane>=(int) lanes.size() || started)
+        return;
+    lanes[lane]->nice_value = nice_value;
+}
+
+void LaneExecutor::SetTrace(PipelineTrace* t) {
+    trace = t;
+}
+
+int LaneExecutor::FindLane(const std::string& name) {
+    for (size_t i = 0; i<lanes.size(); i++)
+        if (lanes[i]->name.compare(name)==0)
+            return (int) i;
+    return -1;
+}
+
+void LaneExecutor::Start() {
+    if (started)
+        return;
+    started = true;
+    for (auto& l : lanes) {
+        l->stopping = false;
+        for (int i = 0; i<l->workers; i++)
+            l->threads.push_back(std::thread(&LaneExecutor::WorkerLoop, this, l.get()));
+    }
+}
+
+void LaneExecutor::Stop() {
+    if (!started)
+        return;
+    for (auto& l : lanes) {
+        std::lock_guard<std::mutex> lock(l->mutex);
+        l->stopping = true;
+        l->cv.notify_all();
+    }
+    for (auto& l : lanes) {
+        for (auto& t : l->threads)
+            if (t.joinable() && t.get_id()!=std::this_thread::get_id())
+                t.join();
+            else if (t.joinable())
+                t.detach();
+        l->threads.clear();
+    }
+    started = false;
+}
+
+bool LaneExecutor::IsStarted() {
+    return started;
+}
+
+bool LaneExecutor::Push(int lane, Job job) {
+    if (lane<0 || lane>=(int) lanes.size()) {
+        std::cout << "ERROR: LaneExecutor::Push:" << std::endl;
+        std::cout << " invalid lane " << lane << std::endl;
+        return false;
+    }
+    Lane* l = lanes[lane].get();
+    std::lock_guard<std::mutex> lock(l->mutex);
+    QueuedJob q;
+    q.job    = job;
+    q.pushed = Clock::now();
+    l->queue.push_back(q);
+    l->cv.notify_one();
+    return true;
+}
+
+void LaneExecutor::WorkerLoop(Lane* l) {
+    pthread_setname_np(pthread_self(), l->name.substr(0, 15).c_str()); // for debuggers and traces
+    if (l->nice_value!=0) {
+        // on Linux, the nice value is a per-thread attribute
+        if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), l->nice_value)!=0)
+            std::cout << "LaneExecutor: could not set nice value " << l->nice_value 
+                      << " for lane " << l->name << std::endl;
+    }
+    std::unique_lock<std::mutex> lock(l->mutex);
+    while (true) {
+        l->cv.wait(lock, [l]{ return l->stopping || !l->queue.empty(); });
+        if (l->queue.empty())
+            return; // stopping, and all queued jobs have been run
+        QueuedJob q = l->queue.front();
+        l->queue.pop_front();
+        double latency = std::chrono::duration<double, std::milli>(Clock::now()-q.pushed).count();
+        l->mean_latency = l->mean_latency==0.0 ? latency : 0.9*l->mean_latency + 0.1*latency;
+        if (latency>l->max_latency)
+            l->max_latency = latency;
+        lock.unlock();
+        int64_t start = (trace && trace->IsActive()) ? PipelineTelemetry::Now() : 0;
+        try {
+            if (q.job) q.job();
+        }
+        catch (...) {
+            std::cout << "ERROR: LaneExecutor::WorkerLoop:" << std::endl;
+            std::cout << " unhandled exception in a job of lane " << l->name << std::endl;
+        }
+        if (start>0)
+            trace->Complete(l->trace_name.c_str(), start, PipelineTelemetry::Now()-start);
+        lock.lock();
+    }
+}
+
+int LaneExecutor::GetNrLanes() {
+    return (int) lanes.size();
+}
+
+std::string LaneExecutor::GetLaneName(int lane) {
+    if (lane<0 || lane>=(int) lanes.size())
+        return "";
+    return lanes[lane]->name;
+}
+
+int LaneExecutor::GetLaneWorkers(int lane) {
+    if (lane<0 || lane>=(int) lanes.size())
+        return 0;
+    return lanes[lane]->workers;
+}
+
+long LaneExecutor::GetQueueDepth(int lane) {
+    if (lane<0 || lane>=(int) lanes.size())
+        return 0;
+    std::lock_guard<std::mutex> lock(lanes[lane]->mutex);
+    return (long) lanes[lane]->queue.size();
+}
+
+double LaneExecutor::GetMeanLatency(int lane) {
+    if (lane<0 || lane>=(int) lanes.size())
+        return 0.0;
+    std::lock_guard<std::mutex> lock(lanes[lane]->mutex);
+    return lanes[lane]->mean_latency;
+}
+
+double LaneExecutor::GetMaxLatency(int lane) {
+    if (lane<0 || lane>=(int) lanes.size())
+        return 0.0;
+    std::lock_guard<std::mutex> lock(lanes[lane]->mutex);
+    return lanes[lane]->max_latency;
+}
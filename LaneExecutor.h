@@ -0,0 +1,112 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   LaneExecutor.h
+ */
+
+#ifndef LANEEXECUTOR_H
+#define	LANEEXECUTOR_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+class PipelineTrace;
+
+/**
+ * Executes jobs on separate lanes. Every lane has its own FIFO queue and its
+ * own worker threads, so that long-running jobs in one lane (e.g. saving
+ * files) cannot starve the jobs of another lane (e.g. live previews).
+ * The workers of a lane run with the lane's nice value (0 = normal priority,
+ * larger values = lower priority; negative values require privileges).
+ * Per lane, the queue depth and the queueing latency (time from Push to the
+ * start of the job) are recorded. The worker threads are named after their
+ * lane, and with a trace (see PipelineTrace.h) every job is recorded as an
+ * event "<lane> job".
+ */
+class LaneExecutor {
+public:
+    typedef std::function<void()> Job;
+    
+    LaneExecutor();
+    ~LaneExecutor();
+    
+    // configuration, before Start()
+    int  AddLane(const std::string& name, int workers, int nice_value=0);
+    void SetLaneWorkers(int lane, int workers);
+    void SetLaneNice(int lane, int nice_value);
+    int  FindLane(const std::string& name); // -1 if not found
+    void SetTrace(PipelineTrace* trace);
+    
+    void Start();
+    void Stop();   // runs the queued jobs, then joins all workers
+    bool IsStarted();
+    
+    bool Push(int lane, Job job);
+    
+    int  GetNrLanes();
+    std::string GetLaneName(int lane);
+    int  GetLaneWorkers(int lane);
+    long GetQueueDepth(int lane);
+    double GetMeanLatency(int lane); // in milliseconds, exponential moving average
+    double GetMaxLatency(int lane);  // in milliseconds
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct QueuedJob {
+        Job               job;
+        Clock::time_point pushed;
+    };
+    
+    struct Lane {
+        std::string              name;
+        std::string              trace_name;  // "<name> job"
+        int                      workers      = 1;
+        int                      nice_value   = 0;
+        std::deque<QueuedJob>    queue;
+        std::vector<std::thread> threads;
+        std::mutex               mutex;
+        std::condition_variable  cv;
+        bool                     stopping     = false;
+        double                   mean_latency = 0.0; // ms
+        double                   max_latency  = 0.0; // ms
+    };
+    
+    std::vector<std::unique_ptr<Lane>> lanes;
+    bool started = false;
+    PipelineTrace* trace = NULL;
+    
+    void WorkerLoop(Lane* lane);
+};
+
+#endif	/* LANEEXECUTOR_H */
+
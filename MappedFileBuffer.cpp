@@ -0,0 +1,209 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "MappedFileBuffer.h"
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+MappedFileBuffer::MappedFileBuffer() {
+}
+
+MappedFileBuffer::~MappedFileBuffer() {
+    Unmap();
+}
+
+void* MappedFileBuffer::Map(const std::string& path_, long bytes, long& capacity) {
+    Unmap();
+    long pagesize = sysconf(_SC_PAGESIZE);
+    long size_ = ((bytes+pagesize-1)/pagesize)*pagesize;
+    if (size_<=0)
+        size_ = pagesize;
+    fd = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd<0) {
+        std::cout << "ERROR: MappedFileBuffer::Map:" << std::endl;
+        std::cout << " cannot create " << path_ << ": " << strerror(errno) << std::endl;
+        return NULL;
+    }
+    path = path_;
+    size = size_;
+    if (!_Reserve()) {
+        std::cout << "ERROR: MappedFileBuffer::Map:" << std::endl;
+        std::cout << " cannot reserve " << size << " bytes for " << path << ": " << strerror(errno) << std::endl;
+        Unmap();
+        return NULL;
+    }
+    buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buf==MAP_FAILED) {
+        buf = NULL;
+        std::cout << "ERROR: MappedFileBuffer::Map:" << std::endl;
+        std::cout << " cannot map " << path << ": " << strerror(errno) << std::endl;
+        Unmap();
+        return NULL;
+    }
+    capacity = size;
+    return buf;
+}
+
+void MappedFileBuffer::Unmap() {
+    if (buf!=NULL)
+        munmap(buf, size);
+    buf = NULL;
+    if (fd>=0) {
+        close(fd);
+        unlink(path.c_str()); // the data is saved by CloneTo
+    }
+    fd = -1;
+    size = 0;
+    path.clear();
+}
+
+bool MappedFileBuffer::_Reserve() {
+    // allocated blocks read as zero; posix_fallocate would write zeros
+    // on file systems without fallocate, use ftruncate then (sparse file)
+    if (fallocate(fd, 0, 0, size)==0)
+        return true;
+    if (errno!=EOPNOTSUPP)
+        return false;
+    return ftruncate(fd, size)==0;
+}
+
+bool MappedFileBuffer::Clear() {
+    if (buf==NULL)
+        return false;
+    // the punched range reads as zero in the mapping, too; reallocate the
+    // blocks such that the disk cannot run full while the library writes
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, size)==0 && _Reserve())
+        return true;
+    memset(buf, 0, size);
+    return true;
+}
+
+bool MappedFileBuffer::Writeback(long offset, long len, bool wait) {
+    if (buf==NULL || offset>=size)
+        return false;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    long start = (offset/pagesize)*pagesize;
+    long end = offset+len<size ? offset+len : size;
+    if (wait)
+        return msync((char*) buf+start, end-start, MS_SYNC)==0;
+    return sync_file_range(fd, start, end-start, SYNC_FILE_RANGE_WRITE)==0;
+}
+
+void MappedFileBuffer::Prefetch(long offset, long len) {
+    if (buf==NULL || offset>=size)
+        return;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    long start = (offset/pagesize)*pagesize;
+    long end = offset+len<size ? offset+len : size;
+    madvise((char*) buf+start, end-start, MADV_WILLNEED);
+}
+
+void MappedFileBuffer::Drop(long offset, long len, bool evict) {
+    if (buf==NULL || offset>=size)
+        return;
+    // whole pages only, partial pages at the edges belong to the neighbours
+    long pagesize = sysconf(_SC_PAGESIZE);
+    long start = ((offset+pagesize-1)/pagesize)*pagesize;
+    long end = offset+len<size ? ((offset+len)/pagesize)*pagesize : size;
+    if (end<=start)
+        return;
+    // shared file mapping: the data stays in the page cache/file, dirty
+    // pages are kept until they are written back
+    madvise((char*) buf+start, end-start, MADV_DONTNEED);
+    if (evict)
+        posix_fadvise(fd, start, end-start, POSIX_FADV_DONTNEED);
+}
+
+bool MappedFileBuffer::CloneTo(const std::string& target, long len) {
+    if (fd<0 || len>size)
+        return false;
+    int tfd = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (tfd<0) {
+        std::cout << "ERROR: MappedFileBuffer::CloneTo:" << std::endl;
+        std::cout << " cannot create " << target << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    // the clone covers the whole file, the page padding is cut off
+    bool ok = ioctl(tfd, FICLONE, fd)==0 && ftruncate(tfd, len)==0;
+    if (!ok) { // no reflinks (or other file system): copy inside the kernel
+        loff_t in = 0, out = 0;
+        ok = ftruncate(tfd, 0)==0;
+        bool kernel_copy = true;
+        while (ok && kernel_copy && in<len) {
+            ssize_t n = copy_file_range(fd, &in, tfd, &out, len-in, 0);
+            if (n<=0)
+                kernel_copy = false;
+        }
+        // not supported across file systems (EXDEV) and by some network
+        // file systems: write the rest from the mapping
+        while (ok && in<len) {
+            ssize_t n = pwrite(tfd, (char*) buf+in, len-in, in);
+            if (n<0 && errno==EINTR)
+                continue;
+            if (n<=0)
+                ok = false;
+            else
+                in += n;
+        }
+    }
+    if (!ok) {
+        std::cout << "ERROR: MappedFileBuffer::CloneTo:" << std::endl;
+        std::cout << " cannot copy " << path << " to " << target << ": " << strerror(errno) << std::endl;
+        close(tfd);
+        unlink(target.c_str());
+        return false;
+    }
+    close(tfd);
+    return true;
+}
+
+void* MappedFileBuffer::GetPointer() {
+    return buf;
+}
+
+long MappedFileBuffer::GetSize() {
+    return size;
+}
+
+const std::string& MappedFileBuffer::GetPath() {
+    return path;
+}
+
+long MappedFileBuffer::FreeDiskSpace(const std::string& path_) {
+    struct statvfs st;
+    if (statvfs(path_.c_str(), &st)!=0)
+        return -1;
+    return (long) st.f_bavail*st.f_frsize;
+}
@@ -0,0 +1,94 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/* 
+ * File:   MappedFileBuffer.h
+ *
+ * Data buffer backed by a memory-mapped file, for out-of-core accumulation
+ */
+
+#ifndef MAPPEDFILEBUFFER_H
+#define	MAPPEDFILEBUFFER_H
+
+#include <string>
+
+/**
+ * A data buffer that lives in a file (on a fast local disk) instead of
+ * anonymous memory. The file is mapped shared, so the scTDC library and the
+ * readers access it like any other data buffer, while the kernel keeps only
+ * the recently used pages in the page cache. The disk space is reserved when
+ * the file is created, such that writes into the mapping cannot fail for a
+ * full disk. Readers that pass through the whole buffer should do so in
+ * chunks: Prefetch() the next chunk, Drop() the chunk that is done.
+ */
+class MappedFileBuffer {
+public:
+    MappedFileBuffer();
+    ~MappedFileBuffer(); // unmaps the buffer and removes the file
+
+    /**
+     * create the file (replacing an existing one) and map it
+     * @return the zeroed buffer or NULL on error; capacity receives the
+     * usable size (bytes rounded up to pages)
+     */
+    void* Map(const std::string& path_, long bytes, long& capacity);
+    void  Unmap();
+
+    // zero the buffer by deallocating and reallocating the file blocks
+    // (falls back to memset if the file system does not support it)
+    bool  Clear();
+
+    /**
+     * write dirty pages of the range to the file; if wait is false, the
+     * writeback is only started
+     */
+    bool  Writeback(long offset, long len, bool wait);
+    void  Prefetch(long offset, long len);
+    // remove the range from the process and, if clean and evict is set,
+    // from the page cache
+    void  Drop(long offset, long len, bool evict=true);
+
+    /**
+     * copy the first len bytes of the file to target, as a copy-on-write
+     * clone if the file system supports it (otherwise the kernel copies
+     * them, or, across file systems, they are written from the mapping);
+     * call Writeback first
+     */
+    bool  CloneTo(const std::string& target, long len);
+
+    void* GetPointer();
+    long  GetSize();
+    const std::string& GetPath();
+
+    static long FreeDiskSpace(const std::string& path_); // of the file system of path_, -1 if unknown
+
+private:
+    int         fd = -1;
+    void*       buf = NULL;
+    long        size = 0;
+    std::string path;
+
+    bool _Reserve();
+};
+
+#endif	/* MAPPEDFILEBUFFER_H */
@@ -25,81 +25,74 @@
 #include <fstream>
 #include <iostream>
 #include <math.h>
-#include <exception>
-
-#include <fcntl.h>
-#include <sys/file.h>
-#include <unistd.h>
+#include <stdio.h>
 
 #include "PGM_Export.h"
+#include "BufferKernels.h"
 
-AutoBinException::AutoBinException(std::string what_) {
-    whatstr = what_;
-}
-
-const char* AutoBinException::what() const throw() {
-    return whatstr.c_str();
-}
-
-AutoBinException::~AutoBinException() {
-}
-
-
-void PGM_Export_from_uint32buf(std::string fullpath, const uint32_t* buf, int w, int h, uint32_t whiteval) {
+// write header and pixel data to a temporary file in one go, then move it
+// into place (rename is atomic within the same file system)
+static void _write_pgm_atomic(const std::string& fullpath, const char* data, int w, int h) {
+    std::string tmppath = fullpath + ".tmp";
     std::ofstream f;
-    long long v; // value variable
-    int v2;
-    char v3;
-    char *bufout = new char[w*h];
-    for (int y = 0; y<h; y++)
-        for (int x = 0; x<w; x++) {
-            v = ((long long) buf[y*w+x])*255;
-            v = v / whiteval;
-            v2 = (int) v;
-            if (v2>255)
-                bufout[y*w+x] = 255;
-            else
-                bufout[y*w+x] = (char) v2;
-        }
-    f.open(fullpath, std::ios::out | std::ios::trunc);
+    f.open(tmppath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!f.is_open()) {
+        std::cout << "ERROR: PGM_Export: could not open " << tmppath << std::endl;
+        return;
+    }
     f << "P5" << " " << w << " " << h << " " << " 255 "; // header
+    f.write(data, (std::streamsize) w*h);
     f.close();
-    f.open(fullpath, std::ios::out | std::ios::app | std::ios::binary);
-    f.write(bufout, w*h);
-    f.close();   
-    delete[] bufout;
+    if (f.fail() || rename(tmppath.c_str(), fullpath.c_str())!=0) {
+        std::cout << "ERROR: PGM_Export: could not write " << fullpath << std::endl;
+        remove(tmppath.c_str());
+    }
 }
 
-void PGM_Export_from_uint32buf_autoBC(std::string fullpath, const uint32_t* buf, int w, int h) {
+void PGM_Export_from_uint32buf(std::string fullpath, const uint32_t* buf, int w, int h, uint32_t whiteval, std::vector<char>& bufout) {
+    if (w<1 || h<1) return;
+    long n = (long) w * h;
+    if ((long) bufout.size()<n)
+        bufout.resize(n);
+    char* out = bufout.data();
+    BufferKernels::scale_uint32_to_uint8(buf, n, whiteval, (uint8_t*) out);
+    _write_pgm_atomic(fullpath, out, w, h);
+}
+
+void PGM_Export_from_uint32buf_autoBC(std::string fullpath, const uint32_t* buf, int w, int h, std::vector<char>& bufout) {
     //std::cout << "writing PGM " << fullpath << std::endl;
     uint32_t whiteval = Maximum_Value_in_uint32buf(buf, w, h);
     if (whiteval==0) whiteval=1;
-    PGM_Export_from_uint32buf(fullpath, buf, w, h, whiteval);
+    PGM_Export_from_uint32buf(fullpath, buf, w, h, whiteval, bufout);
 }
 
-void PGM_Export_from_uint32buf_Plot_autoMax(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h) {
+void PGM_Export_from_uint32buf_Plot_autoMax(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h, std::vector<char>& bufout) {
     uint32_t maxval = Maximum_Value_in_uint32buf(buf, w, 1);
     if (maxval==0) maxval=1;
-    PGM_Export_from_uint32buf_Plot(fullpath, buf, w, pgm_w, pgm_h, maxval);
+    PGM_Export_from_uint32buf_Plot(fullpath, buf, w, pgm_w, pgm_h, maxval, bufout);
 }
 
-void PGM_Export_from_uint32buf_Plot(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h, uint32_t maxval) {
-    std::ofstream f;
+void PGM_Export_from_uint32buf_Plot(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h, uint32_t maxval, std::vector<char>& bufout) {
     char offval = 250;
     char onval = 0;
     char borderval = 127;
+    if (w<1 || pgm_w<4 || pgm_h<4) return;
     if (maxval==0) maxval=1;
     double logmax = log((double) maxval);
+    if (logmax<=0.0) logmax = 1.0;
     double xf = ((double) pgm_w)/((double) w);
     double yf = ((double) pgm_h)/((double) logmax);
     int pgm_x, pgm_y;
-    char *bufout = new char[pgm_w*pgm_h];
+    long n = (long) pgm_w * pgm_h;
+    if ((long) bufout.size()<n)
+        bufout.resize(n);
+    char* out = bufout.data();
     for (int y=0; y<pgm_h; y++) {
         for (int x = 0; x<pgm_w; x++) 
             if (x==0 || x==pgm_w-1 || y==0 || y==pgm_h-1)
-                bufout[pgm_w*y+x] = borderval;
+                out[pgm_w*y+x] = borderval;
             else
-                bufout[pgm_w*y+x] = offval;
+                out[pgm_w*y+x] = offval;
     }
     double v;
     int step = 1;
@@ -114,46 +107,31 @@ void PGM_Export_from_uint32buf_Plot(std::string fullpath, const uint32_t* buf, l
             pgm_x = pgm_w-3;
         if (pgm_y>=pgm_h-2)
             pgm_y = pgm_h-3;
-        bufout[pgm_x+1+(pgm_h-pgm_y-2)*pgm_w] = onval; // center
-        bufout[pgm_x+(pgm_h-pgm_y-2)*pgm_w] = onval;   // left
-        bufout[pgm_x+2+(pgm_h-pgm_y-2)*pgm_w] = onval; // right
-        bufout[pgm_x+1+(pgm_h-pgm_y-1)*pgm_w] = onval; // up
-        bufout[pgm_x+1+(pgm_h-pgm_y-3)*pgm_w] = onval; // down
+        out[pgm_x+1+(pgm_h-pgm_y-2)*pgm_w] = onval; // center
+        out[pgm_x+(pgm_h-pgm_y-2)*pgm_w] = onval;   // left
+        out[pgm_x+2+(pgm_h-pgm_y-2)*pgm_w] = onval; // right
+        out[pgm_x+1+(pgm_h-pgm_y-1)*pgm_w] = onval; // up
+        out[pgm_x+1+(pgm_h-pgm_y-3)*pgm_w] = onval; // down
     }
-    int fd = open("/var/lock/sc_tdc_pgm_export", O_RDWR | O_CREAT, 0666); // open or create lockfile
-    int rc = flock(fd, LOCK_EX | LOCK_NB); // demand lock, but don't wait for it
-    f.open(fullpath, std::ios::out | std::ios::trunc);
-    
-    f << "P5" << " " << pgm_w << " " << pgm_h << " " << " 255 "; // header
-    f.close();
-    f.open(fullpath, std::ios::out | std::ios::app | std::ios::binary);
-    f.write(bufout, pgm_w*pgm_h);
-    f.close();
-    close(fd);
-    delete[] bufout;
+    _write_pgm_atomic(fullpath, out, pgm_w, pgm_h);
 }
 
 uint32_t Maximum_Value_in_uint32buf(const uint32_t* buf, int w, int h) {
-    uint32_t max = 0;
-    for (int y = 0; y<h; y++)
-        for (int x = 0; x<w; x++)
-            if (buf[y*w+x]>max)
-                max = buf[y*w+x];
-    return max;
+    return BufferKernels::max_uint32(buf, (long) w * h);
 }
 
-uint32_t* AutoBin_uint32Spectrum_To_New_Size(const uint32_t* buf, int size, int newsize) {
-    int newbufsize = newsize; // the caller expects a buffer as large as newsize
+int AutoBin_uint32Spectrum_To_New_Size(const uint32_t* buf, int size, uint32_t* newbuf, int newsize) {
     if (newsize>size)
         newsize = size;
-    // IMPROVE: don't use exceptions, this function is called in a non-main thread, exception is not well propagated and may remain unrecognized
-    if (newsize<1) throw new AutoBinException("AutoBin_uint32Spectrum_To_New_Size(...): illegal value of newsize \n");
-    if (size<0) throw new AutoBinException("AutoBin_uint32Spectrum_To_New_Size(...): illegal value of size \n");
+    if (newsize<1 || size<1) {
+        std::cout << "ERROR: AutoBin_uint32Spectrum_To_New_Size:" << std::endl;
+        std::cout << " illegal value of size or newsize" << std::endl;
+        return -1;
+    }
     int bin = size/newsize;
     double step = (double)size/(double)newsize;
     if (size%newsize>0)
         bin++;
-    uint32_t* newbuf = new uint32_t[newbufsize];
     int off;
     uint32_t binned_val;
     for (int i=0; i<newsize; i++) {
@@ -165,5 +143,5 @@ uint32_t* AutoBin_uint32Spectrum_To_New_Size(const uint32_t* buf, int size, int
             binned_val += buf[j];
         newbuf[i] = binned_val;
     }
-    return newbuf;
-}
\ No newline at end of file
+    return 0;
+}
@@ -28,25 +28,28 @@
  * Created on 20. Mai 2016, 14:53
  */
 
-#include <exception>
+#include <string>
+#include <vector>
+#include <stdint.h>
 
 #ifndef PGM_EXPORT_H
 #define	PGM_EXPORT_H
 
-class AutoBinException : public std::exception {
-    public:
-        AutoBinException(std::string what_);
-        virtual ~AutoBinException();
-        virtual const char* what() const throw();
-    private:
-        std::string whatstr;
-};
+// All export functions render into a caller-owned scratch buffer (bufout),
+// which is only grown when needed, so that repeated preview updates don't
+// allocate. Files are written to a temporary file and renamed to fullpath,
+// so readers never see a partially written image.
 
-void PGM_Export_from_uint32buf(std::string fullpath, const uint32_t* buf, int w, int h, uint32_t whiteval);
+void PGM_Export_from_uint32buf(std::string fullpath, const uint32_t* buf, int w, int h, uint32_t whiteval, std::vector<char>& bufout);
 uint32_t Maximum_Value_in_uint32buf(const uint32_t* buf, int w, int h);
-void PGM_Export_from_uint32buf_autoBC(std::string fullpath, const uint32_t* buf, int w, int h);
-void PGM_Export_from_uint32buf_Plot_autoMax(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h);
-void PGM_Export_from_uint32buf_Plot(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h, uint32_t maxval);
-uint32_t* AutoBin_uint32Spectrum_To_New_Size(const uint32_t* buf, int size, int newsize);
+void PGM_Export_from_uint32buf_autoBC(std::string fullpath, const uint32_t* buf, int w, int h, std::vector<char>& bufout);
+void PGM_Export_from_uint32buf_Plot_autoMax(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h, std::vector<char>& bufout);
+void PGM_Export_from_uint32buf_Plot(std::string fullpath, const uint32_t* buf, long w, int pgm_w, int pgm_h, uint32_t maxval, std::vector<char>& bufout);
+/**
+ * bins the spectrum buf of length size into newbuf of length newsize
+ * (newbuf must be allocated by the caller). If newsize > size, only the first
+ * size elements of newbuf are written.
+ * @return 0 on success, -1 on illegal sizes
+ */
+int AutoBin_uint32Spectrum_To_New_Size(const uint32_t* buf, int size, uint32_t* newbuf, int newsize);
 #endif	/* PGM_EXPORT_H */
-
@@ -0,0 +1,199 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <exception>
+#include <pthread.h>
+#include "PeriodicTaskScheduler.h"
+
+
+PeriodicTaskScheduler::PeriodicTaskScheduler() {
+    
+}
+
+PeriodicTaskScheduler::~PeriodicTaskScheduler() {
+    Stop();
+    Join();
+    if (thread!=NULL)
+        delete thread;
+}
+
+int PeriodicTaskScheduler::AddTask(const std::string& name, long milliseconds, TaskFunction func) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Task t;
+    t.name      = name;
+    t.func      = func;
+    t.period_ms = milliseconds;
+    t.deadline  = Clock::now() + std::chrono::milliseconds(milliseconds>0 ? milliseconds : 0);
+    tasks.push_back(t);
+    return (int) tasks.size()-1;
+}
+
+void PeriodicTaskScheduler::SetPeriod(int task_id, long milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (task_id<0 || task_id>=(int) tasks.size())
+        return;
+    Task& t = tasks[task_id];
+    if (t.period_ms==milliseconds)
+        return;
+    t.period_ms = milliseconds;
+    if (milliseconds>0)
+        t.deadline = Clock::now() + std::chrono::milliseconds(milliseconds);
+    cv.notify_one(); // the earliest deadline may have changed
+}
+
+long PeriodicTaskScheduler::GetPeriod(int task_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (task_id<0 || task_id>=(int) tasks.size())
+        return 0;
+    return tasks[task_id].period_ms;
+}
+
+long PeriodicTaskScheduler::GetOverruns(int task_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (task_id<0 || task_id>=(int) tasks.size())
+        return 0;
+    return tasks[task_id].overruns;
+}
+
+long PeriodicTaskScheduler::GetLastRuntime(int task_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (task_id<0 || task_id>=(int) tasks.size())
+        return 0;
+    return tasks[task_id].runtime_us;
+}
+
+std::string PeriodicTaskScheduler::GetTaskName(int task_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (task_id<0 || task_id>=(int) tasks.size())
+        return "";
+    return tasks[task_id].name;
+}
+
+int PeriodicTaskScheduler::GetNrTasks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (int) tasks.size();
+}
+
+void PeriodicTaskScheduler::Start() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (running)
+        return;
+    if (thread!=NULL) {
+        // the stopping thread needs the mutex to see running==false
+        std::thread* old = thread;
+        thread = NULL;
+        lock.unlock();
+        if (old->joinable() && old->get_id()!=std::this_thread::get_id())
+            old->join();
+        else if (old->joinable())
+            old->detach(); // restarted from one of its own tasks
+        delete old;
+        lock.lock();
+        if (running || thread!=NULL) // started concurrently
+            return;
+    }
+    Clock::time_point now = Clock::now();
+    for (auto& t : tasks)
+        if (t.period_ms>0)
+            t.deadline = now + std::chrono::milliseconds(t.period_ms);
+    running = true;
+    thread = new std::thread(&PeriodicTaskScheduler::ThreadLoop, this);
+}
+
+void PeriodicTaskScheduler::Stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    cv.notify_one();
+}
+
+void PeriodicTaskScheduler::Join() {
+    // takes the thread over, so that Start() cannot replace it meanwhile;
+    // a task may call Stop(), but must not wait for its own thread
+    std::thread* old = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (thread==NULL || thread->get_id()==std::this_thread::get_id())
+            return;
+        old = thread;
+        thread = NULL;
+    }
+    if (old->joinable())
+        old->join(); // the stopping thread needs the mutex to see running==false
+    delete old;
+}
+
+void PeriodicTaskScheduler::RunTask(std::unique_lock<std::mutex>& lock, size_t i) {
+    TaskFunction f = tasks[i].func;
+    std::string name = tasks[i].name;
+    lock.unlock(); // tasks may call SetPeriod(...) or Stop()
+    Clock::time_point start = Clock::now();
+    try {
+        if (f) f();
+    }
+    catch (std::exception& e) {
+        std::cout << "ERROR: PeriodicTaskScheduler::RunTask:" << std::endl;
+        std::cout << " exception in task " << name << " : " << e.what() << std::endl;
+    }
+    Clock::time_point end = Clock::now();
+    lock.lock();
+    Task& t = tasks[i];
+    t.runtime_us = (long) std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
+    if (t.period_ms<=0)
+        return; // disabled while running
+    std::chrono::milliseconds period(t.period_ms);
+    t.deadline += period;
+    if (t.deadline<=end) {
+        // missed at least one deadline, skip forward to the next one in the future
+        long missed = (long) ((end - t.deadline) / period) + 1;
+        t.overruns += missed;
+        t.deadline += missed * period;
+    }
+}
+
+void PeriodicTaskScheduler::ThreadLoop() {
+    pthread_setname_np(pthread_self(), "PeriodicTasks"); // for debuggers and traces
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        bool any_enabled = false;
+        Clock::time_point earliest = Clock::time_point::max();
+        for (auto& t : tasks)
+            if (t.period_ms>0 && t.deadline<earliest) {
+                earliest = t.deadline;
+                any_enabled = true;
+            }
+        if (!any_enabled) {
+            cv.wait(lock);
+            continue;
+        }
+        if (Clock::now()<earliest) {
+            // wakes up early on Stop() or SetPeriod(...), the loop re-evaluates
+            cv.wait_until(lock, earliest);
+            continue;
+        }
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i<tasks.size() && running; i++)
+            if (tasks[i].period_ms>0 && tasks[i].deadline<=now)
+                RunTask(lock, i);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   PeriodicTaskScheduler.h
+ */
+
+#ifndef PERIODICTASKSCHEDULER_H
+#define	PERIODICTASKSCHEDULER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/**
+ * Runs a set of independent periodic tasks from a single thread.
+ * Every task has its own period and an absolute deadline on the steady clock,
+ * so the period does not drift by the runtime of the tasks. If a task misses
+ * one or more of its deadlines (because it, or another task, ran too long),
+ * the missed periods are counted as overruns and the task is rescheduled to
+ * its next deadline in the future (no burst of catch-up calls).
+ * Task functions are called from the scheduler thread and should be short;
+ * heavy work should be handed to a worker pool by the task function itself.
+ */
+class PeriodicTaskScheduler {
+public:
+    typedef std::function<void()> TaskFunction;
+    
+    PeriodicTaskScheduler();
+    ~PeriodicTaskScheduler();
+    
+    /**
+     * register a new task, must be called before Start()
+     * @param name a name for diagnostic output
+     * @param milliseconds the period, a value <= 0 disables the task
+     * @return the id of the task
+     */
+    int AddTask(const std::string& name, long milliseconds, TaskFunction func);
+    void SetPeriod(int task_id, long milliseconds); // <= 0 disables the task
+    long GetPeriod(int task_id);
+    long GetOverruns(int task_id);
+    long GetLastRuntime(int task_id); // in microseconds
+    std::string GetTaskName(int task_id);
+    int GetNrTasks();
+    
+    void Start();
+    void Stop();
+    void Join();
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct Task {
+        std::string       name;
+        TaskFunction      func;
+        long              period_ms  = 0;
+        Clock::time_point deadline;
+        long              overruns   = 0;
+        long              runtime_us = 0;
+    };
+    
+    std::vector<Task>       tasks;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    bool                    running = false;
+    std::thread*            thread  = NULL;
+    
+    void ThreadLoop();
+    void RunTask(std::unique_lock<std::mutex>& lock, size_t i);
+};
+
+#endif	/* PERIODICTASKSCHEDULER_H */
+
@@ -0,0 +1,228 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   PipelineTelemetry.cpp
+ */
+
+#include "PipelineTelemetry.h"
+#include "PipelineTrace.h"
+#include <cstdio>
+
+PipelineTelemetry::Stage::Stage() : count(0), sum_ns(0), max_ns(0) {
+    for (int i = 0; i<NR_BUCKETS; i++)
+        buckets[i] = 0;
+}
+
+PipelineTelemetry::Scope::Scope(PipelineTelemetry& telemetry, int stage)
+    : telemetry(telemetry), stage(stage), start_ns(stage>=0 ? PipelineTelemetry::Now() : 0) {
+}
+
+PipelineTelemetry::Scope::~Scope() {
+    if (stage>=0)
+        telemetry.Record(stage, PipelineTelemetry::Now()-start_ns);
+}
+
+PipelineTelemetry::PipelineTelemetry() {
+}
+
+int PipelineTelemetry::AddStage(const std::string& name) {
+    stages.push_back(std::unique_ptr<Stage>(new Stage()));
+    stages.back()->name = name;
+    stages.back()->rate_time = Now();
+    return stages.size()-1;
+}
+
+void PipelineTelemetry::SetTrace(PipelineTrace* t) {
+    trace = t;
+}
+
+int PipelineTelemetry::FindStage(const std::string& name) {
+    for (std::size_t i = 0; i<stages.size(); i++)
+        if (stages[i]->name.compare(name)==0)
+            return i;
+    return -1;
+}
+
+int PipelineTelemetry::GetNrStages() {
+    return stages.size();
+}
+
+std::string PipelineTelemetry::GetStageName(int stage) {
+    Stage* s = GetStage(stage);
+    return s ? s->name : std::string();
+}
+
+PipelineTelemetry::Stage* PipelineTelemetry::GetStage(int stage) {
+    if (stage<0 || stage>=(int)stages.size())
+        return NULL;
+    return stages[stage].get();
+}
+
+int64_t PipelineTelemetry::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int PipelineTelemetry::BucketIndex(int64_t ns) {
+    // values below 8 ns have a bucket each, then 8 sub-buckets per power of two
+    if (ns<8)
+        return ns<0 ? 0 : (int) ns;
+    int e = 63-__builtin_clzll((unsigned long long) ns);
+    int sub = (int) ((ns >> (e-3)) & 7);
+    int index = (e-2)*8+sub;
+    return index<NR_BUCKETS ? index : NR_BUCKETS-1;
+}
+
+double PipelineTelemetry::BucketUpperMicros(int bucket) {
+    if (bucket<8)
+        return (bucket+1)*1e-3;
+    int e = bucket/8+2;
+    int sub = bucket%8;
+    double lower = (double) ((int64_t)(8+sub) << (e-3));
+    return (lower+(double)((int64_t)1 << (e-3)))*1e-3;
+}
+
+void PipelineTelemetry::Record(int stage, int64_t ns) {
+    Stage* s = GetStage(stage);
+    if (!s) return;
+    s->buckets[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    s->count.fetch_add(1, std::memory_order_relaxed);
+    s->sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    long long m = s->max_ns.load(std::memory_order_relaxed);
+    while (ns>m && !s->max_ns.compare_exchange_weak(m, ns, std::memory_order_relaxed));
+    if (trace && trace->IsActive())
+        trace->Complete(s->name.c_str(), Now()-ns, ns); // the stage has just ended
+}
+
+void PipelineTelemetry::Reset() {
+    std::lock_guard<std::mutex> lock(rate_mutex);
+    for (auto& s : stages) {
+        for (int i = 0; i<NR_BUCKETS; i++)
+            s->buckets[i] = 0;
+        s->count = 0;
+        s->sum_ns = 0;
+        s->max_ns = 0;
+        s->rate_count = 0;
+        s->rate_time = Now();
+        s->rate = 0.0;
+    }
+}
+
+void PipelineTelemetry::UpdateRates() {
+    std::lock_guard<std::mutex> lock(rate_mutex);
+    int64_t now = Now();
+    for (auto& s : stages) {
+        long long c = s->count.load(std::memory_order_relaxed);
+        if (now>s->rate_time)
+            s->rate = (c-s->rate_count)*1e9/(double)(now-s->rate_time);
+        s->rate_count = c;
+        s->rate_time = now;
+    }
+}
+
+long long PipelineTelemetry::GetCount(int stage) {
+    Stage* s = GetStage(stage);
+    return s ? s->count.load(std::memory_order_relaxed) : 0;
+}
+
+double PipelineTelemetry::GetRate(int stage) {
+    std::lock_guard<std::mutex> lock(rate_mutex);
+    Stage* s = GetStage(stage);
+    return s ? s->rate : 0.0;
+}
+
+double PipelineTelemetry::GetMeanMicros(int stage) {
+    Stage* s = GetStage(stage);
+    if (!s) return 0.0;
+    long long c = s->count.load(std::memory_order_relaxed);
+    return c>0 ? s->sum_ns.load(std::memory_order_relaxed)*1e-3/c : 0.0;
+}
+
+double PipelineTelemetry::GetMaxMicros(int stage) {
+    Stage* s = GetStage(stage);
+    return s ? s->max_ns.load(std::memory_order_relaxed)*1e-3 : 0.0;
+}
+
+void PipelineTelemetry::GetBuckets(int stage, std::vector<long long>& counts) {
+    counts.assign(NR_BUCKETS, 0);
+    Stage* s = GetStage(stage);
+    if (!s) return;
+    for (int i = 0; i<NR_BUCKETS; i++)
+        counts[i] = s->buckets[i].load(std::memory_order_relaxed);
+}
+
+double PipelineTelemetry::GetQuantileMicros(int stage, double q) {
+    std::vector<long long> counts;
+    GetBuckets(stage, counts);
+    long long total = 0;
+    for (long long c : counts)
+        total += c;
+    if (total==0)
+        return 0.0;
+    long long rank = (long long) (q*total);
+    if (rank>=total) rank = total-1;
+    long long cumulated = 0;
+    for (int i = 0; i<NR_BUCKETS; i++) {
+        cumulated += counts[i];
+        if (cumulated>rank)
+            return BucketUpperMicros(i);
+    }
+    return BucketUpperMicros(NR_BUCKETS-1);
+}
+
+void PipelineTelemetry::FormatPrometheus(const std::string& prefix, std::string& out) {
+    char line[256];
+    std::vector<long long> counts;
+    out += "# HELP "+prefix+"_stage_latency_seconds Duration of the processing stages\n";
+    out += "# TYPE "+prefix+"_stage_latency_seconds histogram\n";
+    for (int st = 0; st<GetNrStages(); st++) {
+        const std::string& name = stages[st]->name;
+        GetBuckets(st, counts);
+        long long cumulated = 0;
+        for (int i = 0; i<NR_BUCKETS; i++) {
+            if (counts[i]==0) continue;
+            cumulated += counts[i];
+            snprintf(line, sizeof(line), "%s_stage_latency_seconds_bucket{stage=\"%s\",le=\"%.6g\"} %lld\n",
+                    prefix.c_str(), name.c_str(), BucketUpperMicros(i)*1e-6, cumulated);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%s_stage_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lld\n",
+                prefix.c_str(), name.c_str(), cumulated);
+        out += line;
+        snprintf(line, sizeof(line), "%s_stage_latency_seconds_sum{stage=\"%s\"} %.9g\n",
+                prefix.c_str(), name.c_str(), stages[st]->sum_ns.load(std::memory_order_relaxed)*1e-9);
+        out += line;
+        snprintf(line, sizeof(line), "%s_stage_latency_seconds_count{stage=\"%s\"} %lld\n",
+                prefix.c_str(), name.c_str(), cumulated);
+        out += line;
+    }
+    out += "# HELP "+prefix+"_stage_throughput Calls of the processing stages per second\n";
+    out += "# TYPE "+prefix+"_stage_throughput gauge\n";
+    for (int st = 0; st<GetNrStages(); st++) {
+        snprintf(line, sizeof(line), "%s_stage_throughput{stage=\"%s\"} %.6g\n",
+                prefix.c_str(), stages[st]->name.c_str(), GetRate(st));
+        out += line;
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   PipelineTelemetry.h
+ */
+
+#ifndef PIPELINETELEMETRY_H
+#define	PIPELINETELEMETRY_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
+
+class PipelineTrace;
+
+/**
+ * Low-overhead latency instrumentation of the processing stages of the
+ * device server. Every stage has a log-linear (HDR-style) histogram of its
+ * durations in nanoseconds with 8 sub-buckets per power of two (relative
+ * resolution 12.5%, range 1 ns .. about 36 minutes), a call counter, the sum
+ * and the maximum of the durations. Recording is lock-free (a few relaxed
+ * atomic increments) and may happen from any thread. The throughput (calls
+ * per second) is computed by UpdateRates(), which should be called
+ * periodically. With an active trace (see PipelineTrace.h), every recorded
+ * duration is also written to the timeline under the name of its stage.
+ */
+class PipelineTelemetry {
+public:
+    static const int NR_BUCKETS = 312;
+    
+    /**
+     * measures the lifetime of the object and records it for the stage;
+     * stage ids < 0 are ignored
+     */
+    class Scope {
+    public:
+        Scope(PipelineTelemetry& telemetry, int stage);
+        ~Scope();
+    private:
+        PipelineTelemetry& telemetry;
+        int                stage;
+        int64_t            start_ns;
+    };
+    
+    PipelineTelemetry();
+    
+    // configuration, before the first Record()
+    int  AddStage(const std::string& name);
+    int  FindStage(const std::string& name); // -1 if not found
+    void SetTrace(PipelineTrace* trace);
+    
+    int  GetNrStages();
+    std::string GetStageName(int stage);
+    
+    static int64_t Now(); // steady clock, in nanoseconds
+    void Record(int stage, int64_t nanoseconds);
+    void Reset();
+    void UpdateRates();
+    
+    long long GetCount(int stage);
+    double GetRate(int stage);                   // calls per second
+    double GetMeanMicros(int stage);
+    double GetMaxMicros(int stage);
+    double GetQuantileMicros(int stage, double q); // upper bound of the bucket holding the quantile
+    void   GetBuckets(int stage, std::vector<long long>& counts);
+    static double BucketUpperMicros(int bucket);
+    static int    BucketIndex(int64_t nanoseconds);
+    
+    /**
+     * append the stage statistics in the Prometheus text exposition format
+     * (histogram <prefix>_stage_latency_seconds with the non-empty buckets,
+     * gauge <prefix>_stage_throughput) to out
+     */
+    void FormatPrometheus(const std::string& prefix, std::string& out);
+    
+private:
+    struct Stage {
+        std::string                       name;
+        std::atomic<long long>            buckets[NR_BUCKETS];
+        std::atomic<long long>            count;
+        std::atomic<long long>            sum_ns;
+        std::atomic<long long>            max_ns;
+        long long                         rate_count = 0; // count at the last UpdateRates
+        int64_t                           rate_time  = 0;
+        double                            rate       = 0.0;
+        Stage();
+    };
+    
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::mutex rate_mutex;
+    PipelineTrace* trace = NULL;
+    
+    Stage* GetStage(int stage);
+};
+
+#endif	/* PIPELINETELEMETRY_H */
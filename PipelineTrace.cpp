@@ -0,0 +1,163 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   PipelineTrace.cpp
+ */
+
+#include "PipelineTrace.h"
+#include <cstdio>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+    // the buffer of the calling thread (one trace object per process is the normal case)
+    struct ThreadSlot {
+        void* owner  = NULL;
+        void* buffer = NULL;
+    };
+    thread_local ThreadSlot thread_slot;
+    
+    // events that may still be overwritten by a running writer are not dumped
+    const long dump_margin = 64;
+    
+    std::string json_escaped(const std::string& s) {
+        std::string r;
+        for (char c : s) {
+            if (c=='"' || c=='\\') r += '\\';
+            if ((unsigned char) c >= 0x20) r += c;
+        }
+        return r;
+    }
+}
+
+PipelineTrace::PipelineTrace() {
+}
+
+void PipelineTrace::SetActive(bool a) {
+    if (a && !active) {
+        active_buffer_size = buffer_size.load();
+        generation++; // the threads reset their buffers at their next event
+    }
+    active = a;
+}
+
+void PipelineTrace::SetBufferSize(long events) {
+    buffer_size = std::max(events, 2*dump_margin);
+}
+
+long PipelineTrace::GetBufferSize() {
+    return buffer_size;
+}
+
+PipelineTrace::ThreadBuffer* PipelineTrace::GetThreadBuffer() {
+    if (thread_slot.owner==this)
+        return static_cast<ThreadBuffer*>(thread_slot.buffer);
+    long tid = (long) syscall(SYS_gettid);
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    ThreadBuffer* b = NULL;
+    for (auto& buf : buffers)
+        if (buf->tid==tid) b = buf.get();
+    if (b==NULL) {
+        buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+        b = buffers.back().get();
+        b->tid = tid;
+        char name[32] = {0};
+        if (pthread_getname_np(pthread_self(), name, sizeof(name))==0 && name[0]!=0)
+            b->thread_name = name;
+        else
+            b->thread_name = "thread "+std::to_string(tid);
+    }
+    thread_slot.owner = this;
+    thread_slot.buffer = b;
+    return b;
+}
+
+void PipelineTrace::Record(const char* name, int64_t start_ns, int64_t duration_ns) {
+    ThreadBuffer* b = GetThreadBuffer();
+    int g = generation.load(std::memory_order_acquire);
+    if (b->generation!=g) {
+        std::lock_guard<std::mutex> lock(b->mutex);
+        long capacity = active_buffer_size.load();
+        if (b->capacity!=capacity) {
+            b->events.reset(new Event[capacity]);
+            b->capacity = capacity;
+        }
+        b->written.store(0, std::memory_order_release);
+        b->generation = g;
+    }
+    long long i = b->written.load(std::memory_order_relaxed);
+    Event& e = b->events[i % b->capacity];
+    e.name = name;
+    e.start_ns = start_ns;
+    e.duration_ns = duration_ns;
+    b->written.store(i+1, std::memory_order_release);
+}
+
+long long PipelineTrace::GetNrEvents() {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    long long n = 0;
+    int g = generation.load();
+    for (auto& b : buffers) {
+        std::lock_guard<std::mutex> block(b->mutex);
+        if (b->generation==g)
+            n += std::min(b->written.load(std::memory_order_acquire), (long long) b->capacity);
+    }
+    return n;
+}
+
+long PipelineTrace::WriteChromeJson(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (f==NULL)
+        return -1;
+    long pid = (long) getpid();
+    long count = 0;
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    int g = generation.load();
+    for (auto& b : buffers) {
+        std::lock_guard<std::mutex> block(b->mutex);
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",", pid, b->tid, json_escaped(b->thread_name).c_str());
+        first = false;
+        if (b->generation!=g)
+            continue;
+        long long written = b->written.load(std::memory_order_acquire);
+        long long begin = written - b->capacity + (active ? dump_margin : 0);
+        if (begin<0) begin = 0;
+        for (long long i = begin; i<written; i++) {
+            const Event& e = b->events[i % b->capacity];
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"sctdc\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+                    json_escaped(e.name).c_str(), pid, b->tid, e.start_ns*1e-3, e.duration_ns*1e-3);
+            count++;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok ? count : -1;
+}
@@ -0,0 +1,101 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* 
+ * File:   PipelineTrace.h
+ */
+
+#ifndef PIPELINETRACE_H
+#define	PIPELINETRACE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+/**
+ * Opt-in timeline tracing of the processing stages. While tracing is active,
+ * every thread writes complete events (name, start, duration) into its own
+ * ring buffer (no locks on the recording path); inactive tracing costs one
+ * relaxed atomic load per event. WriteChromeJson() dumps the buffers in the
+ * Chrome trace-event format (chrome://tracing, ui.perfetto.dev), with one
+ * track per thread, named after the thread (see pthread_setname_np).
+ * Event names must be string constants or otherwise outlive the trace.
+ */
+class PipelineTrace {
+public:
+    PipelineTrace();
+    
+    void SetActive(bool active);       // activating discards the previous events
+    bool IsActive() { return active.load(std::memory_order_relaxed); }
+    void SetBufferSize(long events);   // per thread, takes effect at the next activation
+    long GetBufferSize();
+    
+    /**
+     * record an event of the calling thread, times from the steady clock
+     * (see PipelineTelemetry::Now) in nanoseconds
+     */
+    void Complete(const char* name, int64_t start_ns, int64_t duration_ns) {
+        if (IsActive())
+            Record(name, start_ns, duration_ns);
+    }
+    
+    long long GetNrEvents(); // currently held in the buffers
+    
+    /**
+     * @return the number of events written, -1 if the file could not be written
+     */
+    long WriteChromeJson(const std::string& path);
+    
+private:
+    struct Event {
+        const char* name;
+        int64_t     start_ns;
+        int64_t     duration_ns;
+    };
+    
+    struct ThreadBuffer {
+        long                        tid = 0;
+        std::string                 thread_name;
+        std::unique_ptr<Event[]>    events;
+        long                        capacity = 0;
+        std::atomic<long long>      written{0};
+        int                         generation = -1; // owned by the recording thread
+        std::mutex                  mutex;           // reallocation vs. dump
+    };
+    
+    std::atomic<bool> active{false};
+    std::atomic<int>  generation{0};
+    std::atomic<long> buffer_size{65536};
+    std::atomic<long> active_buffer_size{65536};
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::mutex        buffers_mutex;
+    
+    void Record(const char* name, int64_t start_ns, int64_t duration_ns);
+    ThreadBuffer* GetThreadBuffer();
+};
+
+#endif	/* PIPELINETRACE_H */
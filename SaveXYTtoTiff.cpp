@@ -24,14 +24,28 @@
 
 #include "SaveXYTtoTiff.h"
 #include "Helper.h"
+#include "BitDepth.h"
 #include <tiffio.h>
+#include <algorithm>
 
 namespace SurfaceConceptTDC_ns {
+    namespace {
+        // converts one row of the data buffer to float (see BitDepth.h)
+        template<typename T> struct FloatRowKernel {
+            static int Run(const void* src, long srcoff, float* dst, long w) {
+                const T* p = (const T*) src + srcoff;
+                for (long x=0; x<w; x++)
+                    dst[x] = (float) p[x];
+                return 0;
+            }
+        };
+    }
+
     bool _SaveXYTtoTiff_impl(GeneralHistogram& hist, const std::string& path, const std::string& filename, long zsize_limit) {
-        uint32_t *pxyt = (uint32_t*) hist.GetDatabufPointer();
+        const void *pxyt = hist.GetDatabufPointer();
         if (pxyt==NULL) return false;
-        if (hist.depth!=32) {
-            std::cout << "SaveXYTtoTiff: bit depths other than 32 not implemented yet!" << std::endl;
+        if (!IsSupportedBitDepth(hist.depth)) {
+            std::cout << "SaveXYTtoTiff: unsupported bit depth " << hist.depth << std::endl;
             std::cout << " Cancelling save to Tiff." << std::endl;
             return false;
         }
@@ -68,36 +82,42 @@ namespace SurfaceConceptTDC_ns {
         
         float *stripbuf = new float[w*rowsperstrip];
         int strip_bytesize = w*rowsperstrip*sizeof(float);
-        long x, srcoff, stripbufoff;
+        long srcoff, stripbufoff;
+        const GeneralHistogram::OverflowTable& overflow = hist.GetOverflowTable(); // carries of wrapped voxels
         long y = 0;
-        long z = 0;
 	if (h%rowsperstrip>0)
 		strips++;
-        for (long z=0; z<zs; z++) {
-            y = 0;
-            TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 3);
-            TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
-            TIFFSetField(tif, TIFFTAG_IMAGELENGTH, h);
-            TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, sizeof(float)*8);
-            TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
-            TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
-            TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
-            TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
-            TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);            
-            for (int strip=0; strip<strips; strip++) {
-                for (int row=0; row<rowsperstrip && y<h; row++) {
-                    srcoff = y*w+z*w*h;
-                    stripbufoff = row*w;
-                    for (x=0; x<w; x++) {
-                        stripbuf[x+stripbufoff] = (float) pxyt[srcoff+x];
+        // chunk by chunk, for data buffers in a mapped file (see
+        // GeneralHistogram::ForEachZChunk)
+        hist.ForEachZChunk(0, zs, [&](long z1, long z2) {
+            for (long z=z1; z<z2; z++) {
+                y = 0;
+                TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 3);
+                TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
+                TIFFSetField(tif, TIFFTAG_IMAGELENGTH, h);
+                TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, sizeof(float)*8);
+                TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+                TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+                TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+                TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+                TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);            
+                for (int strip=0; strip<strips; strip++) {
+                    for (int row=0; row<rowsperstrip && y<h; row++) {
+                        srcoff = y*w+z*w*h;
+                        stripbufoff = row*w;
+                        DispatchBitDepth<FloatRowKernel>(hist.depth, pxyt, srcoff, stripbuf+stripbufoff, w);
+                        for (auto it = std::lower_bound(overflow.begin(), overflow.end(), std::make_pair(srcoff, (uint64_t) 0));
+                                it!=overflow.end() && it->first<srcoff+w; ++it)
+                            stripbuf[stripbufoff+it->first-srcoff] += (float) it->second;
+                        y++;
                     }
-                    y++;
+                    TIFFWriteRawStrip(tif, strip, stripbuf, strip_bytesize);
                 }
-                TIFFWriteRawStrip(tif, strip, stripbuf, strip_bytesize);
+                if ( (z+1) < zs)
+                    TIFFWriteDirectory(tif); // do not write directory for the last slice (TIFFClose does), avoids blank extra slice
             }
-            if ( (z+1) < zs)
-                TIFFWriteDirectory(tif); // do not write directory for the last slice (TIFFClose does), avoids blank extra slice
-        }
+            return 0;
+        });
         delete[] stripbuf;
 	TIFFClose(tif);
         return true;
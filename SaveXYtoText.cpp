@@ -30,16 +30,34 @@
 
 #include "SaveXYtoText.h"
 #include "Helper.h"
+#include "BitDepth.h"
 #include <fstream>
 #include <iomanip>
 
 namespace SurfaceConceptTDC_ns {
 
+namespace {
+    // writes the image as a text matrix (see BitDepth.h)
+    template<typename T> struct TextMatrixKernel {
+        static int Run(const void* src, long w, long h, std::ofstream& ofs) {
+            const T* pxy = (const T*) src;
+            int colw = sizeof(T)>4 ? 21 : 11; // leaves at least one blank between columns
+            for (long y=0; y<h; y++) {
+                for (long x=0; x<w; x++) {
+                    ofs << std::setw(colw) << (uint64_t) pxy[x+y*w];
+                }
+                ofs << std::endl;
+            }
+            return 0;
+        }
+    };
+}
+
 bool SaveXYtoText(GeneralHistogram& hist, const std::string& path, const std::string& filename, long accumulated_time_val) {
-        uint32_t *pxy = (uint32_t*) hist.GetDatabufPointer();
+        const void *pxy = hist.GetDatabufPointer();
         if (pxy==nullptr) return false;
-        if (hist.depth!=32) {
-            std::cout << "SaveXYtoText: bit depths other than 32 not implemented yet!" << std::endl;
+        if (!IsSupportedBitDepth(hist.depth)) {
+            std::cout << "SaveXYtoText: unsupported bit depth " << hist.depth << std::endl;
             std::cout << " Cancelling save to text." << std::endl;
             return false;
         }
@@ -69,12 +87,7 @@ bool SaveXYtoText(GeneralHistogram& hist, const std::string& path, const std::st
 //        ofs << "# " << std::endl;
 //        ofs << "# START OF DATA" << std::endl;
         
-        for (long y=0; y<h; y++) {
-            for (long x=0; x<w; x++) {
-                ofs << std::setw(11) << pxy[x+y*w];
-            }
-            ofs << std::endl;
-        }
+        DispatchBitDepth<TextMatrixKernel>(hist.depth, pxy, w, h, ofs);
         ofs.close();
         return true;
     
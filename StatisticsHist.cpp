@@ -24,6 +24,7 @@
 
 
 #include "StatisticsHist.h"
+#include "BufferKernels.h"
 #include <iostream>
 
 StatisticsHist::StatisticsHist() {
@@ -48,49 +49,38 @@ StatisticsHist::~StatisticsHist() {
 
 }
 
-void StatisticsHist::Reset() {
-    //std::cout << "StatisticsHist::Reset() got called" << std::endl;
-    //std::cout << "StatisticsHist::Reset() nrbins: " << nrbins << std::endl;
-    for (int i = 0; i<nrbins; i++)
-        data[i] = 0;
-    
-}
-
-void StatisticsHist::Update(const uint32_t* buf, long len, uint32_t max) {
-    // Assume minimum is 0
+template<>
+void StatisticsHist::Update<uint32_t>(const uint32_t* buf, long len, uint64_t max) {
     if (nrbins<1) return;
     Reset();
     _binsize = max/nrbins;
     if (max%nrbins>0)
         _binsize += 1;
-    int bin;
     if (_binsize==0) _binsize = 1;
-    for (long i = 0; i<len; i++) {
-        bin = buf[i]/_binsize;
-        if (bin>=nrbins) bin = nrbins-1;
-        data[bin]++;
-    }
+    if (_binsize>UINT32_MAX)
+        data[0] += (uint32_t) len; // all values fall into the first bin
+    else
+        BufferKernels::histogram_uint32(buf, len, (uint32_t) _binsize, data.data(), nrbins);
     _cdf_update_needed = true;
 }
 
-
-void StatisticsHist::Update(const uint32_t* buf, long len) {
-    _update_min_max(buf, len);
-    Update(buf, len, _max);
+template<>
+void StatisticsHist::_update_min_max<uint32_t>(const uint32_t* buf, long len) {
+    uint32_t mn, mx;
+    BufferKernels::minmax_uint32(buf, len, mn, mx);
+    _min = len>0 ? mn : UINT64_MAX;
+    _max = mx;
 }
 
-void StatisticsHist::_update_min_max(const uint32_t* buf, long len) {
-    _min = 4294967295U;
-    _max = 0;
-    uint32_t v;
-    for (long i = 0; i<len; i++) {
-        v = buf[i];
-        _min = v<_min ? v : _min;
-        _max = v>_max ? v : _max;
-    }
+void StatisticsHist::Reset() {
+    //std::cout << "StatisticsHist::Reset() got called" << std::endl;
+    //std::cout << "StatisticsHist::Reset() nrbins: " << nrbins << std::endl;
+    for (int i = 0; i<nrbins; i++)
+        data[i] = 0;
+    
 }
 
-uint32_t StatisticsHist::GetQuantile(double p) {
+uint64_t StatisticsHist::GetQuantile(double p) {
     if (nrbins<1) return 0;
     if (_cdf_update_needed)
         _update_cdf();
@@ -116,15 +106,15 @@ void StatisticsHist::_update_cdf() {
     //}
 }
 
-uint32_t StatisticsHist::GetBinSize() {
+uint64_t StatisticsHist::GetBinSize() {
     return _binsize;
 }
 
-uint32_t StatisticsHist::GetMax() {
+uint64_t StatisticsHist::GetMax() {
     return _max;
 }
 
-uint32_t StatisticsHist::GetMin() {
+uint64_t StatisticsHist::GetMin() {
     return _min;
 }
 
@@ -41,13 +41,14 @@ public:
     StatisticsHist(int nrbins_);
     ~StatisticsHist();
     
-    void Update(const uint32_t* buf, long len);
-    void Update(const uint32_t* buf, long len, uint32_t max);
+    // T may be any unsigned pixel type of the histogram data buffers
+    template<typename T> void Update(const T* buf, long len);
+    template<typename T> void Update(const T* buf, long len, uint64_t max);
     void Reset();
-    uint32_t GetQuantile(double p);
-    uint32_t GetMin();
-    uint32_t GetMax();
-    uint32_t GetBinSize();
+    uint64_t GetQuantile(double p);
+    uint64_t GetMin();
+    uint64_t GetMax();
+    uint64_t GetBinSize();
     int GetNrBins();
     
     
@@ -56,11 +57,51 @@ private:
     std::vector<uint32_t> cdf;
     bool _cdf_update_needed;
     int nrbins;
-    uint32_t _min, _max, _binsize;
+    uint64_t _min, _max, _binsize;
     
-    void _update_min_max(const uint32_t* buf, long len);
+    template<typename T> void _update_min_max(const T* buf, long len);
     void _update_cdf();
 };
 
+// the 32-bit buffers use the vectorized kernels (see StatisticsHist.cpp)
+template<> void StatisticsHist::Update<uint32_t>(const uint32_t* buf, long len, uint64_t max);
+template<> void StatisticsHist::_update_min_max<uint32_t>(const uint32_t* buf, long len);
+
+template<typename T>
+void StatisticsHist::Update(const T* buf, long len, uint64_t max) {
+    // Assume minimum is 0
+    if (nrbins<1) return;
+    Reset();
+    _binsize = max/nrbins;
+    if (max%nrbins>0)
+        _binsize += 1;
+    uint64_t bin;
+    if (_binsize==0) _binsize = 1;
+    for (long i = 0; i<len; i++) {
+        bin = buf[i]/_binsize;
+        if (bin>=(uint64_t)nrbins) bin = nrbins-1;
+        data[bin]++;
+    }
+    _cdf_update_needed = true;
+}
+
+template<typename T>
+void StatisticsHist::Update(const T* buf, long len) {
+    _update_min_max(buf, len);
+    Update(buf, len, _max);
+}
+
+template<typename T>
+void StatisticsHist::_update_min_max(const T* buf, long len) {
+    _min = UINT64_MAX;
+    _max = 0;
+    uint64_t v;
+    for (long i = 0; i<len; i++) {
+        v = buf[i];
+        _min = v<_min ? v : _min;
+        _max = v>_max ? v : _max;
+    }
+}
+
 #endif /* IMAGEHIST_H */
 
@@ -28,6 +28,7 @@ static const char *RcsId = "$Id:  $";
 #include <attrdesc.h>
 #include "Helper.h"
 #include "GeneralHistogram.h"
+#include "BufferKernels.h"
 
 #ifdef __linux__
   string TERMRED = "\x1B[31m";
@@ -88,7 +89,7 @@ namespace SurfaceConceptTDC_ns
  */
 //--------------------------------------------------------
 SurfaceConceptTDC::SurfaceConceptTDC(Tango::DeviceClass *cl, string &s)
- : TANGO_BASE_CLASS(cl, s.c_str()), thread_pool(2)
+ : TANGO_BASE_CLASS(cl, s.c_str())
 {
 	/*----- PROTECTED REGION ID(SurfaceConceptTDC::constructor_1) ENABLED START -----*/
     init_device();
@@ -98,7 +99,7 @@ SurfaceConceptTDC::SurfaceConceptTDC(Tango::DeviceClass *cl, string &s)
 }
 //--------------------------------------------------------
 SurfaceConceptTDC::SurfaceConceptTDC(Tango::DeviceClass *cl, const char *s)
- : TANGO_BASE_CLASS(cl, s), thread_pool(2)
+ : TANGO_BASE_CLASS(cl, s)
 {
 	/*----- PROTECTED REGION ID(SurfaceConceptTDC::constructor_2) ENABLED START -----*/
     init_device();
@@ -107,7 +108,7 @@ SurfaceConceptTDC::SurfaceConceptTDC(Tango::DeviceClass *cl, const char *s)
 }
 //--------------------------------------------------------
 SurfaceConceptTDC::SurfaceConceptTDC(Tango::DeviceClass *cl, const char *s, const char *d)
- : TANGO_BASE_CLASS(cl, s, d), thread_pool(2)
+ : TANGO_BASE_CLASS(cl, s, d)
 {
 	/*----- PROTECTED REGION ID(SurfaceConceptTDC::constructor_3) ENABLED START -----*/
     init_device();
@@ -127,8 +128,8 @@ void SurfaceConceptTDC::delete_device()
 	/*----- PROTECTED REGION ID(SurfaceConceptTDC::delete_device) ENABLED START -----*/
     
     //	Delete device allocated objects
-        image_preview_update_thread.Stop();
-        image_preview_update_thread.Join(); // need this to prevent core dump
+        periodic_tasks.Stop();
+        periodic_tasks.Join(); // need this to prevent core dump
     /*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC::delete_device
 	delete[] attr_DeviceID_read;
 	delete[] attr_ExposureLive_read;
@@ -149,6 +150,7 @@ void SurfaceConceptTDC::init_device()
 	/*----- PROTECTED REGION ID(SurfaceConceptTDC::init_device_before) ENABLED START -----*/
     
     //	Initialization before get_device_property() call
+    INFO_STREAM << "SurfaceConceptTDC::init_device() buffer kernels: " << BufferKernels::get_level_name() << endl;
     
     /*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC::init_device_before
 	
@@ -165,6 +167,7 @@ void SurfaceConceptTDC::init_device()
                 &save_directory_rval, 
                 &save_filename_val,
                 &info_accu_xyt_formattedsize_val,
+                &info_accu_xyt_admission_val,
                 &hist_taxis_unit_val,
                 &tdc_inifile_path_val,
                 &cmd_trig_general_val,
@@ -182,10 +185,14 @@ void SurfaceConceptTDC::init_device()
         tdc_stat_events_received_val = new Tango::DevLong[tdc_stat_events_received_size];
         tdc_stat_summarized_val      = new Tango::DevLong[tdc_stat_summarized_size];
         _zero_tdc_statistics();
+        tdc_stat_ring.resize(tdc_stat_history_size);
         // ------------------------------------------------------
-        image_preview_update_thread.SetCallback(&StaticImagePreviewUpdateAction, this);
-        image_preview_update_thread.SetPeriod(200);
-        image_preview_update_thread.Start();
+        live_completion_timestamp_ns = 0;
+        SetupBufferPool(); // SurfaceConceptTDC_Memory.cpp
+        SetupTelemetry(); // SurfaceConceptTDC_Telemetry.cpp
+        SetupExecutorLanes(); // SurfaceConceptTDC_Tasks.cpp
+        SetupPeriodicTasks();
+        periodic_tasks.Start();
         set_state(Tango::OFF);
         
         inifileOperations.SetSourceIniFilePath(iniFilePath);
@@ -229,6 +236,10 @@ void SurfaceConceptTDC::get_device_property()
         dev_prop.push_back(Tango::DbDatum("FullHistTSize"));
         dev_prop.push_back(Tango::DbDatum("fullHistTPGMPreviewWidth"));
         dev_prop.push_back(Tango::DbDatum("CSS_Support_Active"));
+        dev_prop.push_back(Tango::DbDatum("ExecutorLaneWorkers"));
+        dev_prop.push_back(Tango::DbDatum("BufferPool"));
+        dev_prop.push_back(Tango::DbDatum("LargeBufferPolicy"));
+        dev_prop.push_back(Tango::DbDatum("OutOfCoreAccumulation"));
         
 
 	//	is there at least one property to be read ?
@@ -424,6 +435,74 @@ void SurfaceConceptTDC::get_device_property()
                 }
                 dev_prop[i] << (cssSupportActive?"true":"false");
                 // ----------------------------------------------------------------
+		//	Try to initialize ExecutorLaneWorkers from class property
+		cl_prop = ds_class->get_class_property(dev_prop[++i].name);
+		if (cl_prop.is_empty()==false)	cl_prop  >>  executorLaneWorkers;
+		else {
+			def_prop = ds_class->get_default_device_property(dev_prop[i].name);
+			if (def_prop.is_empty()==false)	def_prop  >>  executorLaneWorkers;
+		}
+		if (dev_prop[i].is_empty()==false)	dev_prop[i]  >>  executorLaneWorkers;
+                //      use hard-coded value if all of these options failed
+                if (cl_prop.is_empty() && def_prop.is_empty() && dev_prop[i].is_empty()) {
+                    executorLaneWorkers = "Preview:1/0,Accu:1/5,Config:1/0,IO:1/10,Encode:1/5";
+                    std::cout << "Property ExecutorLaneWorkers not found in database." << std::endl;
+                    std::cout << "Setting it to default value " << executorLaneWorkers << std::endl;
+                }
+                // validated in SetupExecutorLanes()
+                dev_prop[i] << executorLaneWorkers;
+                // ----------------------------------------------------------------
+		//	Try to initialize BufferPool from class property
+		cl_prop = ds_class->get_class_property(dev_prop[++i].name);
+		if (cl_prop.is_empty()==false)	cl_prop  >>  bufferPoolConfig;
+		else {
+			def_prop = ds_class->get_default_device_property(dev_prop[i].name);
+			if (def_prop.is_empty()==false)	def_prop  >>  bufferPoolConfig;
+		}
+		if (dev_prop[i].is_empty()==false)	dev_prop[i]  >>  bufferPoolConfig;
+                //      use hard-coded value if all of these options failed
+                if (cl_prop.is_empty() && def_prop.is_empty() && dev_prop[i].is_empty()) {
+                    bufferPoolConfig = "Prefault:false,TrimIdleMs:30000,BudgetMB:0";
+                    std::cout << "Property BufferPool not found in database." << std::endl;
+                    std::cout << "Setting it to default value " << bufferPoolConfig << std::endl;
+                }
+                // validated in SetupBufferPool()
+                dev_prop[i] << bufferPoolConfig;
+                // ----------------------------------------------------------------
+		//	Try to initialize LargeBufferPolicy from class property
+		cl_prop = ds_class->get_class_property(dev_prop[++i].name);
+		if (cl_prop.is_empty()==false)	cl_prop  >>  largeBufferPolicy;
+		else {
+			def_prop = ds_class->get_default_device_property(dev_prop[i].name);
+			if (def_prop.is_empty()==false)	def_prop  >>  largeBufferPolicy;
+		}
+		if (dev_prop[i].is_empty()==false)	dev_prop[i]  >>  largeBufferPolicy;
+                //      use hard-coded value if all of these options failed
+                if (cl_prop.is_empty() && def_prop.is_empty() && dev_prop[i].is_empty()) {
+                    largeBufferPolicy = "MinSizeMB:256,HugePages:transparent,Numa:none,NumaNodes:all,PrefaultThreads:0";
+                    std::cout << "Property LargeBufferPolicy not found in database." << std::endl;
+                    std::cout << "Setting it to default value " << largeBufferPolicy << std::endl;
+                }
+                // validated in SetupLargeBufferPolicy()
+                dev_prop[i] << largeBufferPolicy;
+                // ----------------------------------------------------------------
+		//	Try to initialize OutOfCoreAccumulation from class property
+		cl_prop = ds_class->get_class_property(dev_prop[++i].name);
+		if (cl_prop.is_empty()==false)	cl_prop  >>  outOfCoreAccumulation;
+		else {
+			def_prop = ds_class->get_default_device_property(dev_prop[i].name);
+			if (def_prop.is_empty()==false)	def_prop  >>  outOfCoreAccumulation;
+		}
+		if (dev_prop[i].is_empty()==false)	dev_prop[i]  >>  outOfCoreAccumulation;
+                //      use hard-coded value if all of these options failed
+                if (cl_prop.is_empty() && def_prop.is_empty() && dev_prop[i].is_empty()) {
+                    outOfCoreAccumulation = "Directory:,ChunkMB:64,SaveRaw:false";
+                    std::cout << "Property OutOfCoreAccumulation not found in database." << std::endl;
+                    std::cout << "Setting it to default value " << outOfCoreAccumulation << std::endl;
+                }
+                // validated in SetupOutOfCoreAccumulation()
+                dev_prop[i] << outOfCoreAccumulation;
+                // ----------------------------------------------------------------
                 // ----------------------------------------------------------------
                 // now write everything back to the database (workaround for bug in server wizard)
                 write_device_properties(dev_prop);
@@ -544,6 +623,7 @@ void SurfaceConceptTDC::write_ExposureLive(Tango::WAttribute &attr)
 	/*----- PROTECTED REGION ID(SurfaceConceptTDC::write_ExposureLive) ENABLED START -----*/
         m_exposure_live_ms = (long)(w_val*1000.0);
         *attr_ExposureLive_read = w_val;
+        UpdateLiveTriggerPeriod();
 	
 	
 	/*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC::write_ExposureLive
@@ -615,6 +695,14 @@ void SurfaceConceptTDC::add_dynamic_attributes()
     if (cssSupportActive) AddCSSAttributes();
     AddImageStatAttributes();
     AddHistUserTAuxAttributes();
+    AddTaskAttributes(); // SurfaceConceptTDC_Tasks.cpp
+    AddViewAttributes(); // SurfaceConceptTDC_Views.cpp
+    AddEncodedAttributes(); // SurfaceConceptTDC_Encoded.cpp
+    AddViewportAttributes(); // SurfaceConceptTDC_Viewport.cpp
+    AddBundleAttributes(); // SurfaceConceptTDC_Bundle.cpp
+    AddTelemetryAttributes(); // SurfaceConceptTDC_Telemetry.cpp
+    AddMemoryAttributes(); // SurfaceConceptTDC_Memory.cpp
+    SetupOutOfCoreAccumulation(); // SurfaceConceptTDC_Memory.cpp
     /*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC::add_dynamic_attributes
 }
 
@@ -636,7 +724,7 @@ void SurfaceConceptTDC::start() // implements the command DeviceStart
         return;
     }
     set_state(Tango::INIT);
-    thread_pool.push([this](int id){this->startThreadAction();});
+    executor.Push(lane_config, [this]{this->startThreadAction();});
 
 }
 
@@ -665,6 +753,7 @@ void SurfaceConceptTDC::startThreadAction()
             }
         }
         m_hist_map["Hist_Accu_XYT"]->SetPipeActive(false); // no accumulation at start up
+        ResetIdlePipes(); // all live pipes are open now
         ::sc_tdc_set_complete_callback2(m_TDC_id, this, &SurfaceConceptTDC::StaticMeasurementCompleteCallback);
         INFO_STREAM << "SurfaceConceptTDC::start(): sc_tdc_init_inifile(...) " << TERMSUCCESFUL << ". Device ID " << retval << endl;
     }
@@ -780,7 +869,8 @@ void SurfaceConceptTDC::acquisition_stop()
 void SurfaceConceptTDC::_acquisition_start()
 {
     //std::cout << "_acquisition_start() got called" << std::endl;
-    int retval = ::sc_tdc_start_measure2(m_TDC_id, 1000); // 1 second
+    measurement_event_driven = live_event_driven_val;
+    int retval = ::sc_tdc_start_measure2(m_TDC_id, GetMeasurementDuration()); // 1 second unless event-driven
     if (retval!=0) {
         INFO_STREAM << "SurfaceConceptTDC::acquisition_start(): sc_tdc_start_measure2(...) returned an " << TERMERROR << endl;
         Helper::cout_sc_err_message(retval);
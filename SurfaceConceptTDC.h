@@ -26,6 +26,8 @@
 #define SurfaceConceptTDC_H
 
 #include <queue>
+#include <deque>
+#include <set>
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -35,10 +37,14 @@
 
 #include "CustomAttr.h"
 #include "GeneralHistogram.h"
-#include "TimedPeriodicCallThread.h"
+#include "PeriodicTaskScheduler.h"
+#include "CoalescingJob.h"
 #include "IniFileOperations.h"
-#include "ctpl/ctpl_stl.h"
+#include "LaneExecutor.h"
+#include "PipelineTelemetry.h"
+#include "PipelineTrace.h"
 #include "StatPipe.h"
+#include "ViewportBinning.h"
 #include "SaveAfterAccumModes.h"
 
 /*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC.h
@@ -82,17 +88,165 @@ class SurfaceConceptTDC : public TANGO_BASE_CLASS
     CustomAttr*             image_preview_polling_attr     = NULL;
     Tango::DevLong          image_preview_polling_val      = 50;
     long                    image_preview_last_timestamp   = 0;
-    TimedPeriodicCallThread image_preview_update_thread;
-    
-    std::thread*            live_preview_refresh_thread    = NULL;
-    bool                    live_preview_refresh_task_busy = false;
+    PeriodicTaskScheduler   periodic_tasks;  // see SurfaceConceptTDC_Tasks.cpp
+    int                     task_live_trigger_id           = -1;
+    int                     task_counts_per_sec_id         = -1;
+    int                     task_accu_refresh_id           = -1;
+    int                     task_accumulated_time_id       = -1;
+    CustomSpectrumAttr*     server_task_overruns_attr      = NULL;
+    std::vector<Tango::DevLong> server_task_overruns_val;
+    
+    // demand tracking of the exported histogram views, see SurfaceConceptTDC_Views.cpp
+    struct ViewDemand {
+        long last_read_ms = -1;     // monotonic time of the last read, -1 if never read
+        bool stale        = false;  // production was skipped since the last read
+    };
+    std::map<std::string, ViewDemand> view_demand;
+    std::mutex              view_demand_mutex;
+    CustomAttr*             lazy_views_attr                = NULL;
+    Tango::DevBoolean       lazy_views_val                 = false;  // opt-in
+    CustomAttr*             lazy_views_timeout_attr        = NULL;
+    Tango::DevLong          lazy_views_timeout_val         = 10000;
+    CustomAttr*             server_views_skipped_attr      = NULL;
+    std::atomic<long long>  server_views_skipped{0};
+    Tango::DevLong64        server_views_skipped_val       = 0;
+    // idle pipe management (also SurfaceConceptTDC_Views.cpp), guarded by view_demand_mutex
+    std::map<std::string, long> pipe_last_demand_ms;
+    std::set<std::string>   pipes_idle_closed;
+    std::atomic<long long>  pipe_reopen_request_ns{0};     // first read of a view of an idle pipe, 0 if none
+    std::atomic<long long>  server_pipe_reopens{0};
+    CustomAttr*             lazy_pipes_attr                = NULL;
+    Tango::DevBoolean       lazy_pipes_val                 = false;  // opt-in
+    CustomAttr*             lazy_pipes_timeout_attr        = NULL;
+    Tango::DevLong          lazy_pipes_timeout_val         = 30000;
+    CustomAttr*             server_pipes_idle_attr         = NULL;
+    Tango::DevLong          server_pipes_idle_val          = 0;
+    CustomAttr*             server_pipe_reopens_attr       = NULL;
+    Tango::DevLong64        server_pipe_reopens_val        = 0;
+    CustomAttr*             server_pipe_reopen_latency_attr     = NULL;
+    Tango::DevDouble        server_pipe_reopen_latency_val      = 0.0;
+    CustomAttr*             server_pipe_reopen_latency_max_attr = NULL;
+    Tango::DevDouble        server_pipe_reopen_latency_max_val  = 0.0;
+    
+    // frames handed to Tango by read callbacks, pinned per attribute name
+    std::map<std::string, TangoFramePtr> read_frames;
+    std::mutex              read_frames_mutex;
+    
+    // compressed copies of the histogram views, see SurfaceConceptTDC_Encoded.cpp
+    struct EncodedFrame {
+        std::vector<unsigned char> data;
+        unsigned long seq = 0;   // seq of the TangoFrame it was encoded from
+    };
+    typedef std::shared_ptr<const EncodedFrame> EncodedFramePtr;
+    struct EncodedView {
+        std::string     histname;
+        bool            accu    = false;  // encodes the accumulation frame of histname
+        bool            tiles   = false;  // TIL1 tile updates instead of DZR1 frames
+        EncodedFramePtr frame;            // last encoded frame (a keyframe for tile views)
+        TangoFramePtr   base;             // tile views: frame the last pushed update led to
+        bool            pending = false;  // an encode job is queued
+        unsigned long   pushed_seq = 0;   // seq of the last pushed frame
+    };
+    std::map<std::string, EncodedView> encoded_views;      // guarded by encoded_views_mutex
+    std::map<std::string, EncodedFramePtr> read_encoded;   // pinned for reads, guarded by encoded_views_mutex
+    std::mutex              encoded_views_mutex;
+    Tango::DevString        encoded_format_val             = NULL;
+    Tango::DevString        tile_format_val                = NULL;
+    CustomAttr*             tiles_size_attr                = NULL;
+    Tango::DevLong          tiles_size_val                 = 64;
+    CustomAttr*             server_tiles_changed_attr      = NULL;
+    Tango::DevDouble        server_tiles_changed_val       = 0.0;
+    
+    // viewport queries, see SurfaceConceptTDC_Viewport.cpp
+    struct ViewportQuery {
+        std::string   source  = "Hist_Accu_XY";
+        long          x1      = 0;
+        long          y1      = 0;
+        long          x2      = -1;   // -1: last column
+        long          y2      = -1;   // -1: last row
+        long          width   = 512;
+        long          height  = 512;
+        ViewportMode  mode    = VIEWPORT_SUM;
+        unsigned long seq     = 0;    // seq of the source frame
+        long          binx    = 1;    // results
+        long          biny    = 1;
+        bool operator==(const ViewportQuery& o) const {
+            return source==o.source && x1==o.x1 && y1==o.y1 && x2==o.x2 && y2==o.y2 &&
+                    width==o.width && height==o.height && mode==o.mode && seq==o.seq;
+        }
+    };
+    std::deque<std::pair<ViewportQuery, TangoFramePtr> > viewport_cache; // newest first, guarded by viewport_mutex
+    std::map<std::string, long> viewport_source_read_ms;    // last query per source, guarded by viewport_mutex
+    std::mutex              viewport_mutex;
+    CustomAttr*             server_viewport_cache_hits_attr = NULL;
+    std::atomic<long long>  server_viewport_cache_hits{0};
+    Tango::DevLong64        server_viewport_cache_hits_val = 0;
+    // min/max decimated time spectra (also SurfaceConceptTDC_Viewport.cpp)
+    struct DecimatedResult {
+        std::string   name;
+        long          buckets = 0;
+        TangoFramePtr frame;            // seq of the source frame
+    };
+    std::deque<DecimatedResult> decimated_cache;           // newest first, guarded by viewport_mutex
+    static const long       decimation_max_width           = 16384;
+    
+    // frame bundle, see SurfaceConceptTDC_Bundle.cpp
+    std::atomic<unsigned long long> live_cycle_seq{0};     // number of live processing cycles
+    typedef std::vector<std::pair<std::string, std::vector<Tango::DevLong> > > TDCStatValueList; // see TDCStatValues
+    struct LiveCycleProducts {                              // captured at the end of a live cycle
+        unsigned long long seq = 0;
+        unsigned long long timestamp_ms = 0;
+        std::map<std::string, TangoFramePtr> frames;       // by product name
+        std::map<std::string, Tango::DevLong> scalars;     // image statistics, Counts_Per_Sec
+        TDCStatValueList   tdc_stats;                      // of the newest measurement
+    };
+    typedef std::shared_ptr<const LiveCycleProducts> LiveCycleProductsPtr;
+    LiveCycleProductsPtr    live_cycle_products;           // guarded by bundle_mutex
+    EncodedFramePtr         read_bundle;                   // pinned for reads, guarded by bundle_mutex
+    std::mutex              bundle_mutex;
+    std::atomic<bool>       bundle_push_pending{false};
+    Tango::DevString        bundle_format_val              = NULL;
+    CustomAttr*             frame_bundle_attr              = NULL;
+    CustomAttr*             frame_bundle_compressed_attr   = NULL;
+    Tango::DevBoolean       frame_bundle_compressed_val    = true;
+    CustomAttr*             server_bundle_size_attr        = NULL;
+    Tango::DevLong          server_bundle_size_val         = 0;
+    long long               encode_raw_bytes               = 0;  // guarded by encoded_views_mutex
+    long long               encode_out_bytes               = 0;
+    CustomAttr*             server_encode_ratio_attr       = NULL;
+    Tango::DevDouble        server_encode_ratio_val        = 0.0;
+    CustomAttr*             server_encode_time_attr        = NULL;
+    Tango::DevDouble        server_encode_time_val         = 0.0;
+    CustomAttr*             server_encode_time_max_attr    = NULL;
+    Tango::DevDouble        server_encode_time_max_val     = 0.0;
+    
+    CoalescingJob           live_preview_refresh_job;
+    // event-driven live mode: live frames are processed when a measurement completes
+    CustomAttr*             live_event_driven_attr              = NULL;
+    Tango::DevBoolean       live_event_driven_val               = false;
+    std::atomic<long long>  live_completion_timestamp_ns;      // 0 if no completed frame is pending
+    bool                    measurement_event_driven            = false; // mode of the running measurement
+    std::mutex              live_snapshot_mutex;                // held while the live outputs are computed
+    bool                    live_snapshot_pending               = false; // copies of the live buffers wait for the refresh job
+    CustomAttr*             live_completion_latency_attr        = NULL;
+    Tango::DevDouble        live_completion_latency_val         = 0.0;
+    CustomAttr*             live_completion_latency_max_attr    = NULL;
+    Tango::DevDouble        live_completion_latency_max_val     = 0.0;
+    CustomAttr*             live_preview_refresh_skipped_attr   = NULL;
+    Tango::DevLong64        live_preview_refresh_skipped_val    = 0;
+    CustomAttr*             live_preview_refresh_coalesced_attr = NULL;
+    Tango::DevLong64        live_preview_refresh_coalesced_val  = 0;
 
     
     CustomAttr*      accu_preview_refresh_attr      = NULL;
     Tango::DevLong   accu_preview_refresh_val       = 0;
     long             accu_preview_refresh_timestamp = 0;
-    bool             accu_preview_refresh_task_busy      = false;
-    std::thread*     accu_preview_refresh_thread         = NULL;
+    CoalescingJob    accu_preview_refresh_job;
+    CoalescingJob    accu_sweep_job;        // see SweepAccuCounters
+    CustomAttr*      accu_preview_refresh_skipped_attr   = NULL;
+    Tango::DevLong64 accu_preview_refresh_skipped_val    = 0;
+    CustomAttr*      accu_preview_refresh_coalesced_attr = NULL;
+    Tango::DevLong64 accu_preview_refresh_coalesced_val  = 0;
     
     CustomAttr*      accumulated_time_attr          = NULL;
     Tango::DevLong   accumulated_time_val           = 0;
@@ -117,7 +271,6 @@ class SurfaceConceptTDC : public TANGO_BASE_CLASS
     CustomAttr*      save_filecounter_attr          = NULL;
     Tango::DevLong   save_filecounter_val           = 0;
     bool             save_task_busy                 = false;
-    std::thread*     save_thread                    = NULL;
     std::string      save_last_filename;
     
     // diagnostic attributes
@@ -146,6 +299,15 @@ class SurfaceConceptTDC : public TANGO_BASE_CLASS
     Tango::DevLong64  info_accu_xyt_bytesize_val       = 0;
     CustomAttr*       info_accu_xyt_formattedsize_attr = NULL;
     Tango::DevString  info_accu_xyt_formattedsize_val  = NULL;
+    CustomAttr*       info_accu_xyt_overflow_voxels_attr = NULL;
+    Tango::DevLong64  info_accu_xyt_overflow_voxels_val  = 0;
+    CustomAttr*       info_accu_xyt_wrap_risk_attr       = NULL;
+    Tango::DevLong64  info_accu_xyt_wrap_risk_val        = 0;
+    long              accu_sweep_start_ms                = 0; // see SweepAccuCounters
+    long              accu_sweeps_seen                   = 0;
+    std::atomic<bool> accu_sweep_final_pending{false};      // counts since the last complete sweep, see CompleteAccuSweep
+    CustomAttr*       info_accu_xyt_occupancy_attr       = NULL;
+    Tango::DevDouble  info_accu_xyt_occupancy_val        = 0.0;
     CustomAttr*       server_save_file_busy_attr       = NULL;
     Tango::DevBoolean server_save_file_busy_val        = false;
     CustomAttr*       status_xyt_saved_attr          = NULL;
@@ -219,7 +381,25 @@ class SurfaceConceptTDC : public TANGO_BASE_CLASS
     Tango::DevLong      tdc_stat_max_raw_count_val     = 0;
     CustomAttr*         tdc_stat_avg_raw_count_attr    = NULL;
     Tango::DevLong      tdc_stat_avg_raw_count_val     = 0;
-    ::statistics_t      _tdc_statistics_sc; // structure of surface concept library
+    std::mutex          tdc_stat_values_mutex;         // serializes the writers of the tdc_stat_*_val buffers
+    // history of the raw statistics of the last measurements, see _read_tdc_statistics()
+    struct TDCStatSnapshot {
+        ::statistics_t     stats;
+        long long          timestamp_ms = 0;   // ms since the Unix epoch
+        unsigned long long seq = 0;            // measurement number, starting at 1
+    };
+    static const int    tdc_stat_history_size          = 1024;
+    static const int    tdc_stat_history_width         = 1 + tdc_stat_summarized_size;
+    std::vector<TDCStatSnapshot> tdc_stat_ring;        // preallocated in init_device, guarded by tdc_stat_ring_mutex
+    unsigned long long  tdc_stat_ring_count            = 0; // number of snapshots written so far
+    std::mutex          tdc_stat_ring_mutex;
+    std::atomic<bool>   tdc_stat_publish_pending{false};
+    EncodedFramePtr     tdc_stat_read_snapshot;        // pinned for reads
+    CustomAttr*         tdc_stat_snapshot_attr         = NULL;
+    CustomImageAttr*    tdc_stat_history_attr          = NULL;
+    std::vector<Tango::DevDouble> tdc_stat_history_val;
+    CustomAttr*         tdc_stat_history_length_attr   = NULL;
+    Tango::DevLong      tdc_stat_history_length_val    = 600;
     
     CustomSpectrumAttr* hist_full_t_attr               = NULL;
     CustomSpectrumAttr* hist_accu_full_t_attr          = NULL;
@@ -308,9 +488,80 @@ class SurfaceConceptTDC : public TANGO_BASE_CLASS
     std::mutex          accu_buffers_mutex;
     std::mutex          save_task_busy_mutex;
     
-    ctpl::thread_pool   thread_pool;
+    LaneExecutor        executor;  // see SurfaceConceptTDC_Tasks.cpp
+    int                 lane_preview  = -1;
+    int                 lane_accu     = -1;
+    int                 lane_config   = -1;
+    int                 lane_io       = -1;
+    int                 lane_encode   = -1;  // compression of DevEncoded views
+    CustomSpectrumAttr* server_lane_queue_depth_attr = NULL;
+    std::vector<Tango::DevLong>   server_lane_queue_depth_val;
+    CustomSpectrumAttr* server_lane_latency_attr     = NULL;
+    std::vector<Tango::DevDouble> server_lane_latency_val;
+    CustomSpectrumAttr* server_lane_latency_max_attr = NULL;
+    std::vector<Tango::DevDouble> server_lane_latency_max_val;
+    
+    PipelineTelemetry   telemetry;  // see SurfaceConceptTDC_Telemetry.cpp
+    int                 stage_callback      = -1;  // MeasurementCompleteCallback
+    int                 stage_live_cycle    = -1;  // LiveImageTriggerThreadedAction
+    int                 stage_live_copy     = -1;  // PerformActiveOutputs of the live histograms
+    int                 stage_image_stat    = -1;
+    int                 stage_tdc_stat      = -1;  // PublishTDCStatistics
+    int                 stage_push          = -1;  // push_change_event of histogram frames
+    int                 stage_encode        = -1;
+    int                 stage_accu_cycle    = -1;  // AccuPreviewRefreshThreadedAction
+    int                 stage_integration   = -1;  // IntegrateAccuView
+    int                 stage_file_write    = -1;  // live preview files
+    int                 stage_save          = -1;  // saving of the accumulated data sets
+    int                 task_telemetry_id   = -1;
+    std::atomic<bool>   telemetry_file_pending{false};
+    long                telemetry_file_last_ms = 0;
+    CustomImageAttr*    telemetry_latency_attr = NULL;
+    std::vector<Tango::DevDouble> telemetry_latency_val;
+    CustomSpectrumAttr* telemetry_count_attr = NULL;
+    std::vector<Tango::DevLong64> telemetry_count_val;
+    CustomSpectrumAttr* telemetry_throughput_attr = NULL;
+    std::vector<Tango::DevDouble> telemetry_throughput_val;
+    CustomImageAttr*    telemetry_histogram_attr = NULL;
+    std::vector<Tango::DevLong64> telemetry_histogram_val;
+    CustomSpectrumAttr* telemetry_bucket_bounds_attr = NULL;
+    std::vector<Tango::DevDouble> telemetry_bucket_bounds_val;
+    CustomAttr*         telemetry_file_attr = NULL;
+    Tango::DevString    telemetry_file_val = NULL;
+    std::string         telemetry_file_str;  // guarded by telemetry_file_mutex
+    std::mutex          telemetry_file_mutex;
+    CustomAttr*         telemetry_file_period_attr = NULL;
+    Tango::DevLong      telemetry_file_period_val = 10000;
+    CustomAttr*         telemetry_reset_attr = NULL;
+    Tango::DevBoolean   telemetry_reset_val = false;
+    PipelineTrace       trace;  // timeline of the stages and lane jobs, see DumpTrace
+    CustomAttr*         trace_active_attr = NULL;
+    Tango::DevBoolean   trace_active_val = false;
+    CustomAttr*         trace_buffer_size_attr = NULL;
+    Tango::DevLong      trace_buffer_size_val = 65536;
+    CustomAttr*         server_trace_events_attr = NULL;
+    Tango::DevLong64    server_trace_events_val = 0;
     
     StatPipe            stat_pipe;
+    
+    long                buffer_pool_trim_idle_ms = 30000;  // see SurfaceConceptTDC_Memory.cpp
+    int                 task_buffer_pool_trim_id = -1;
+    CustomAttr*         server_buffer_pool_cachedmem_attr = NULL;
+    Tango::DevLong64    server_buffer_pool_cachedmem_val = 0;
+    CustomAttr*         server_buffer_pool_reuses_attr = NULL;
+    Tango::DevLong64    server_buffer_pool_reuses_val = 0;
+    bool                out_of_core_save_raw = false; // save a file-backed Accu XYT as a copy of the file
+    long long           memory_budget_bytes = 0;  // 0: no budget
+    CustomAttr*         server_memory_budget_attr = NULL;
+    Tango::DevLong64    server_memory_budget_val = 0;
+    CustomAttr*         server_memory_reserved_attr = NULL;
+    Tango::DevLong64    server_memory_reserved_val = 0;
+    CustomAttr*         server_memory_resident_attr = NULL;
+    Tango::DevLong64    server_memory_resident_val = 0;
+    CustomAttr*         info_accu_xyt_admission_attr = NULL;
+    Tango::DevString    info_accu_xyt_admission_val = NULL;
+    CustomAttr*         info_accu_xyt_max_tsize_attr = NULL;
+    Tango::DevLong64    info_accu_xyt_max_tsize_val = -1;
 
 /*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC::Data Members
 
@@ -332,6 +583,17 @@ public:
         string  fullHistTPGMPreviewWidthStr;
         int     fullHistTPGMPreviewWidth;
         string saveBaseDir;
+        // executorLaneWorkers: worker threads per lane and optionally their nice
+        // value, e.g. "Preview:1,Accu:1/5,Config:1,IO:1/10,Encode:1/5"
+        string executorLaneWorkers;
+        // bufferPoolConfig: shared buffer pool options, e.g. "Prefault:false,TrimIdleMs:30000,BudgetMB:0"
+        string bufferPoolConfig;
+        // largeBufferPolicy: allocation of the large data buffers, e.g.
+        // "MinSizeMB:256,HugePages:transparent,Numa:none,NumaNodes:all,PrefaultThreads:0"
+        string largeBufferPolicy;
+        // outOfCoreAccumulation: Accu XYT data buffer in a memory-mapped file
+        // (empty Directory: in memory), e.g. "Directory:/nvme/sctdc,ChunkMB:64,SaveRaw:false"
+        string outOfCoreAccumulation;
 
 //	Attribute data members
 public:
@@ -499,6 +761,14 @@ public:
         virtual bool is_AccumStartAndSaveXY_allowed(const CORBA::Any &any);
         virtual void accum_start_and_save_xy_text();
         virtual bool is_AccumStartAndSaveXYText_allowed(const CORBA::Any &any);        
+        virtual void dump_trace(Tango::DevString argin);
+        virtual bool is_DumpTrace_allowed(const CORBA::Any &any);
+        virtual Tango::DevVarLongArray *get_viewport(const Tango::DevVarLongStringArray *argin);
+        virtual bool is_GetViewport_allowed(const CORBA::Any &any);
+        virtual Tango::DevVarLongArray *get_decimated(const Tango::DevVarLongStringArray *argin);
+        virtual bool is_GetDecimated_allowed(const CORBA::Any &any);
+        virtual Tango::DevEncoded *get_frame_bundle(Tango::DevString argin);
+        virtual bool is_GetFrameBundle_allowed(const CORBA::Any &any);
         virtual void save_thist_accu();
         virtual void save_thist_user_accu();
         bool SaveSpectrum(GeneralHistogram& hist, const std::string path, const std::string filename, bool from_tango_accu_buf);
@@ -528,13 +798,13 @@ private:
     void AddImagePreviewPollingAttribute();
     void ImagePreviewPollingReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void ImagePreviewPollingWriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
-    void ImagePreviewUpdateAction();
-    static void StaticImagePreviewUpdateAction(void* Object);
 
     void LiveImageTriggerAction();
     void LiveImageTriggerThreadedAction();
     void LiveImageTriggerThreadedAction_Hist_User_T();
     void LiveImageTriggerThreadedAction_ImageStat();
+    bool IsLiveOutputHist(const std::string& histname);
+    bool SnapshotLiveBuffers();
     
     static void StaticLiveImageTriggerThreadedAction(void* Object);
 
@@ -542,6 +812,8 @@ private:
     void DiagnosticAttributeReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void DevPropReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void Update_Info_Accu_XYT_Size();
+    void SweepAccuCounters();
+    void CompleteAccuSweep();
     
     void AddAccuPreviewRefreshAttribute();
     void AccuPreviewRefreshReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
@@ -566,9 +838,6 @@ private:
     void SaveXYThreadedAction();
     void SaveXYTextThreadedAction();
     void SaveMeasurementInformation(std::string fullpath);
-    static void StaticSaveThreadedAction(void* Object);
-    static void StaticSaveXYThreadedAction(void* Object);
-    static void StaticSaveXYTextThreadedAction(void* Object);
     void _update_filecounter_and_save_states();
     
     void CountsPerSecUpdate();
@@ -590,6 +859,12 @@ private:
     void AddTDCStatisticsAttributes();
     void TDCStatisticsReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void _read_tdc_statistics();
+    void PublishTDCStatistics();
+    static void SummarizeTDCStatistics(const ::statistics_t&, Tango::DevLong* summarized);
+    static void TDCStatValues(const ::statistics_t& st, TDCStatValueList& values);
+    EncodedFramePtr BuildTDCStatSnapshot();
+    void TDCStatHistoryReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    void TDCStatHistoryWriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
     void _zero_tdc_statistics();
     
     void Hist_Full_T_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
@@ -602,6 +877,10 @@ private:
     void Hist_Live_TAxis_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void Hist_Accu_TAxis_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void Hist_User_Taxis_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    // hand a published histogram frame to Tango without copying it
+    static Tango::DevLong* FrameData(const TangoFramePtr& frame);
+    void SetAttrFrameValue(Tango::Attribute& att, TangoFramePtr frame, bool image);
+    void SetAttrTAxisValue(Tango::Attribute& att, TangoFramePtr frame);
     
     
     void AddSyncHistAttributes();
@@ -624,6 +903,63 @@ private:
     void HistUserTAux_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
     void HistUserTAux_WriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
     
+    void SetupExecutorLanes();
+    void SetupPeriodicTasks();
+    void UpdateLiveTriggerPeriod();
+    void AddViewAttributes();
+    void View_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    void View_WriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
+    bool IsViewConsumed(const std::string& attrname);
+    bool IsHistViewConsumed(const std::string& histname);
+    void MarkHistViewSkipped(const std::string& histname);
+    void NoteViewRead(const std::string& attrname);
+    int  IntegrateAccuView(const std::string& histname);
+    bool IsPipeDemanded(const std::string& histname);
+    void ResetIdlePipes();
+    void ManageIdlePipes();
+    void AddEncodedAttributes();
+    void Encoded_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    void Encoded_WriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
+    EncodedFramePtr EncodeView(const std::string& attrname);
+    EncodedFramePtr EncodeTileUpdate(const std::string& attrname);
+    void NoteEncodeStats(std::size_t raw_bytes, std::size_t out_bytes, double ms); // caller holds encoded_views_mutex
+    void PushEncodedViews(const std::string& histname, bool accu);
+    void PushDerivedViews(const std::string& histname, bool accu);
+    void AddViewportAttributes();
+    void Viewport_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    bool IsViewportSource(const std::string& histname);
+    TangoFramePtr ComputeViewport(ViewportQuery& query);
+    TangoFramePtr DecimateView(const std::string& name, long buckets);
+    void AddBundleAttributes();
+    void Bundle_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    void Bundle_WriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
+    bool IsBundled(const std::string& attrname);
+    void CaptureLiveCycle();
+    bool AddBundleProduct(std::vector<unsigned char>& out, const LiveCycleProducts& products, const std::string& name, bool compress);
+    EncodedFramePtr BuildFrameBundle(const std::vector<std::string>& contents);
+    void PushFrameBundle();
+    void SetupTelemetry();
+    void TelemetryUpdateAction();
+    void WriteTelemetryFile();
+    void AddTelemetryAttributes();
+    void Telemetry_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    void Telemetry_WriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
+    void SetupBufferPool();
+    void SetupLargeBufferPolicy();
+    void BufferPoolTrimAction();
+    void AddMemoryAttributes();
+    void Memory_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    long long MemoryReservedBytes();
+    long long MemoryResidentBytes();
+    bool AvailableBytes(GeneralHistogram* h, std::string& limit, long long& available);
+    bool AdmitHistogramAttr(const std::string histname, const std::string histattrname, long value);
+    long MaxAccuXYTZSize();
+    void SetupOutOfCoreAccumulation();
+    void AddTaskAttributes();
+    void Task_ReadCallback(Tango::DeviceImpl *, Tango::Attribute &);
+    void LiveEventDriven_WriteCallback(Tango::DeviceImpl *, Tango::WAttribute &);
+    long GetMeasurementDuration();
+    
 /*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDC::Additional Method prototypes
 };
 
@@ -752,6 +752,45 @@ void SurfaceConceptTDCClass::command_factory()
 			Tango::OPERATOR);
 	command_list.push_back(pAccumulationStopCmd);
 
+	//	Command DumpTrace
+	DumpTraceClass	*pDumpTraceCmd =
+		new DumpTraceClass("DumpTrace",
+			Tango::DEV_STRING, Tango::DEV_VOID,
+			"Path of the trace file (Chrome trace-event JSON)",
+			"",
+			Tango::EXPERT);
+	command_list.push_back(pDumpTraceCmd);
+
+	//	Command GetViewport
+	GetViewportClass	*pGetViewportCmd =
+		new GetViewportClass("GetViewport",
+			Tango::DEVVAR_LONGSTRINGARRAY, Tango::DEVVAR_LONGARRAY,
+			"x1, y1, x2, y2 (-1: last column/row), width, height; source image, mode (sum, max or sample, optional)",
+			"width, height, x1, y1, x2, y2, bin x, bin y of the binned region, followed by its pixels",
+			Tango::OPERATOR);
+	command_list.push_back(pGetViewportCmd);
+
+	//	Command GetDecimated
+	GetDecimatedClass	*pGetDecimatedCmd =
+		new GetDecimatedClass("GetDecimated",
+			Tango::DEVVAR_LONGSTRINGARRAY, Tango::DEVVAR_LONGARRAY,
+			"number of buckets (usually the width of the plot in pixels); Hist_Full_T_Decimated, "
+			"Hist_Full_Accu_T_Decimated, Hist_Live_T_Decimated, Hist_Accu_T_Decimated, "
+			"Hist_Live_User_T_Decimated or Hist_Accu_User_T_Decimated",
+			"minimum and maximum of each bucket of the time spectrum: min0, max0, min1, max1, ...",
+			Tango::OPERATOR);
+	command_list.push_back(pGetDecimatedCmd);
+
+	//	Command GetFrameBundle
+	GetFrameBundleClass	*pGetFrameBundleCmd =
+		new GetFrameBundleClass("GetFrameBundle",
+			Tango::DEV_STRING, Tango::DEV_ENCODED,
+			"Comma separated list of the products: histogram images and spectra, time axes, "
+			"image statistics (Hist_*_Max, Hist_*_Q998), Counts_Per_Sec, TDC_Stat_*",
+			"The products of the last live cycle in the format BDL1 (see FrameCodec.h)",
+			Tango::OPERATOR);
+	command_list.push_back(pGetFrameBundleCmd);
+
 	/*----- PROTECTED REGION END -----*/	//	SurfaceConceptTDCClass::command_factory_after
 }
 
@@ -864,6 +903,39 @@ CORBA::Any *SaveXyToTextClass::execute(Tango::DeviceImpl *device, TANGO_UNUSED(c
 	return new CORBA::Any();
 }
 
+CORBA::Any *DumpTraceClass::execute(Tango::DeviceImpl *device, const CORBA::Any &in_any)
+{
+	cout2 << "DumpTraceClass::execute(): arrived" << endl;
+	Tango::DevString argin;
+	extract(in_any, argin);
+	((static_cast<SurfaceConceptTDC *>(device))->dump_trace(argin));
+	return new CORBA::Any();
+}
+
+CORBA::Any *GetViewportClass::execute(Tango::DeviceImpl *device, const CORBA::Any &in_any)
+{
+	cout2 << "GetViewportClass::execute(): arrived" << endl;
+	const Tango::DevVarLongStringArray *argin;
+	extract(in_any, argin);
+	return insert((static_cast<SurfaceConceptTDC *>(device))->get_viewport(argin));
+}
+
+CORBA::Any *GetDecimatedClass::execute(Tango::DeviceImpl *device, const CORBA::Any &in_any)
+{
+	cout2 << "GetDecimatedClass::execute(): arrived" << endl;
+	const Tango::DevVarLongStringArray *argin;
+	extract(in_any, argin);
+	return insert((static_cast<SurfaceConceptTDC *>(device))->get_decimated(argin));
+}
+
+CORBA::Any *GetFrameBundleClass::execute(Tango::DeviceImpl *device, const CORBA::Any &in_any)
+{
+	cout2 << "GetFrameBundleClass::execute(): arrived" << endl;
+	Tango::DevString argin;
+	extract(in_any, argin);
+	return insert((static_cast<SurfaceConceptTDC *>(device))->get_frame_bundle(argin));
+}
+
 CORBA::Any *AccumulationStartClass::execute(Tango::DeviceImpl *device, TANGO_UNUSED(const CORBA::Any &in_any))
 {
 	cout2 << "AccumulationStartClass::execute(): arrived" << endl;
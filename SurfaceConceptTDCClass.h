@@ -175,6 +175,94 @@ public:
             {return (static_cast<SurfaceConceptTDC *>(dev))->is_AccumStartAndSaveXYText_allowed(any);}
 };
     
+class DumpTraceClass : public Tango::Command
+{
+public:
+	DumpTraceClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out,
+				   const char        *in_desc,
+				   const char        *out_desc,
+				   Tango::DispLevel  level)
+	:Command(name,in,out,in_desc,out_desc, level)	{};
+
+	DumpTraceClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out)
+	:Command(name,in,out)	{};
+	~DumpTraceClass() {};
+	
+	virtual CORBA::Any *execute (Tango::DeviceImpl *dev, const CORBA::Any &any);
+	virtual bool is_allowed (Tango::DeviceImpl *dev, const CORBA::Any &any)
+            {return (static_cast<SurfaceConceptTDC *>(dev))->is_DumpTrace_allowed(any);}
+};
+
+class GetViewportClass : public Tango::Command
+{
+public:
+	GetViewportClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out,
+				   const char        *in_desc,
+				   const char        *out_desc,
+				   Tango::DispLevel  level)
+	:Command(name,in,out,in_desc,out_desc, level)	{};
+
+	GetViewportClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out)
+	:Command(name,in,out)	{};
+	~GetViewportClass() {};
+	
+	virtual CORBA::Any *execute (Tango::DeviceImpl *dev, const CORBA::Any &any);
+	virtual bool is_allowed (Tango::DeviceImpl *dev, const CORBA::Any &any)
+            {return (static_cast<SurfaceConceptTDC *>(dev))->is_GetViewport_allowed(any);}
+};
+
+class GetDecimatedClass : public Tango::Command
+{
+public:
+	GetDecimatedClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out,
+				   const char        *in_desc,
+				   const char        *out_desc,
+				   Tango::DispLevel  level)
+	:Command(name,in,out,in_desc,out_desc, level)	{};
+
+	GetDecimatedClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out)
+	:Command(name,in,out)	{};
+	~GetDecimatedClass() {};
+	
+	virtual CORBA::Any *execute (Tango::DeviceImpl *dev, const CORBA::Any &any);
+	virtual bool is_allowed (Tango::DeviceImpl *dev, const CORBA::Any &any)
+            {return (static_cast<SurfaceConceptTDC *>(dev))->is_GetDecimated_allowed(any);}
+};
+
+class GetFrameBundleClass : public Tango::Command
+{
+public:
+	GetFrameBundleClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out,
+				   const char        *in_desc,
+				   const char        *out_desc,
+				   Tango::DispLevel  level)
+	:Command(name,in,out,in_desc,out_desc, level)	{};
+
+	GetFrameBundleClass(const char   *name,
+	               Tango::CmdArgType in,
+				   Tango::CmdArgType out)
+	:Command(name,in,out)	{};
+	~GetFrameBundleClass() {};
+	
+	virtual CORBA::Any *execute (Tango::DeviceImpl *dev, const CORBA::Any &any);
+	virtual bool is_allowed (Tango::DeviceImpl *dev, const CORBA::Any &any)
+            {return (static_cast<SurfaceConceptTDC *>(dev))->is_GetFrameBundle_allowed(any);}
+};
+
 class AccumulationStartClass : public Tango::Command
 {
 public:
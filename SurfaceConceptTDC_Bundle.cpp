@@ -0,0 +1,263 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Frame bundle: the products of one live processing cycle (images,
+// spectra, time axes, image statistics, Counts_Per_Sec, TDC statistics)
+// packed into one DevEncoded value of format BDL1 (see FrameCodec.h) with a
+// common sequence number and time stamp, so that a panel needs a single
+// transfer per refresh. The products are captured at the end of the cycle.
+// Frame_Bundle holds a fixed selection and is pushed once per cycle, the
+// GetFrameBundle command packs the selection passed by the client.
+
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "FrameCodec.h"
+#include "Helper.h"
+#include <algorithm>
+#include <chrono>
+
+namespace SurfaceConceptTDC_ns {
+
+    struct BundleFrameDef {
+        const char* name;
+        const char* histname;
+        bool        accu;
+        bool        image;
+        bool        taxis;  // the time axis of the histogram's live frame
+    };
+    
+    static const BundleFrameDef bundle_frame_defs[] = {
+        {"Hist_Live_XY",     "Hist_Live_XY", false, true,  false},
+        {"Hist_Live_XT",     "Hist_Live_XT", false, true,  false},
+        {"Hist_Live_YT",     "Hist_Live_YT", false, true,  false},
+        {"Hist_Accu_XY",     "Hist_Accu_XY", false, true,  false},
+        {"Hist_Accu_XT",     "Hist_Accu_XT", false, true,  false},
+        {"Hist_Accu_YT",     "Hist_Accu_YT", false, true,  false},
+        {"Hist_Full_T",      "Hist_Full_T",  false, false, false},
+        {"Hist_Full_Accu_T", "Hist_Full_T",  true,  false, false},
+        {"Hist_Live_T",      "Hist_Live_T",  false, false, false},
+        {"Hist_Accu_T",      "Hist_Accu_T",  false, false, false},
+        {"Hist_Live_User_T", "Hist_User_T",  false, false, false},
+        {"Hist_Accu_User_T", "Hist_User_T",  true,  false, false},
+        {"Hist_Full_TAxis",  "Hist_Full_T",  false, false, true},
+        {"Hist_Live_TAxis",  "Hist_Live_T",  false, false, true},
+        {"Hist_Accu_TAxis",  "Hist_Accu_T",  false, false, true},
+        {"Hist_User_TAxis",  "Hist_User_T",  false, false, true}
+    };
+
+    static const std::vector<std::string> frame_bundle_contents = {
+        "Hist_Live_XY", "Hist_Live_XT", "Hist_Live_YT",
+        "Hist_Live_XY_Max", "Hist_Live_XY_Q998", "Counts_Per_Sec", "TDC_Stat_Summarized"
+    };
+
+    void SurfaceConceptTDC::AddBundleAttributes() {
+        bundle_format_val = const_cast<Tango::DevString>(BUNDLE_FORMAT);
+        
+        frame_bundle_attr = new CustomAttr("Frame_Bundle", Tango::DEV_ENCODED, Tango::READ, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap1;
+        std::string contents;
+        for (const std::string& name : frame_bundle_contents)
+            contents += (contents.empty() ? "" : ", ") + name;
+        ap1.set_description(std::string("The attributes ")+contents+" of one live cycle packed into one value "
+                "of the format "+BUNDLE_FORMAT+" (see FrameCodec.h), pushed once per live cycle. "
+                "Other selections are returned by the command GetFrameBundle");
+        frame_bundle_attr->set_default_properties(ap1);
+        frame_bundle_attr->set_change_event(true, false); // we will push change events ( so no polling is required )
+        frame_bundle_attr->SetReadCallback(this, &SurfaceConceptTDC::Bundle_ReadCallback);
+        this->add_attribute(frame_bundle_attr);
+        
+        frame_bundle_compressed_attr = new CustomAttr("Frame_Bundle_Compressed", Tango::DEV_BOOLEAN, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap3;
+        ap3.set_description("If true, images and spectra in Frame_Bundle and GetFrameBundle are DZR1 compressed");
+        frame_bundle_compressed_attr->set_default_properties(ap3);
+        frame_bundle_compressed_attr->set_memorized();
+        frame_bundle_compressed_attr->set_memorized_init(true);
+        frame_bundle_compressed_attr->SetReadCallback(this, &SurfaceConceptTDC::Bundle_ReadCallback);
+        frame_bundle_compressed_attr->SetWriteCallback(this, &SurfaceConceptTDC::Bundle_WriteCallback);
+        this->add_attribute(frame_bundle_compressed_attr);
+        
+        server_bundle_size_attr = new CustomAttr("Server_Bundle_Size", Tango::DEV_LONG, Tango::READ, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap4;
+        ap4.set_description("Size of the last frame bundle");
+        ap4.set_unit("bytes");
+        ap4.set_format("%10d");
+        server_bundle_size_attr->set_default_properties(ap4);
+        server_bundle_size_attr->SetReadCallback(this, &SurfaceConceptTDC::Bundle_ReadCallback);
+        this->add_attribute(server_bundle_size_attr);
+    }
+
+    bool SurfaceConceptTDC::IsBundled(const std::string& attrname) {
+        return std::find(frame_bundle_contents.begin(), frame_bundle_contents.end(), attrname)!=frame_bundle_contents.end();
+    }
+
+    void SurfaceConceptTDC::CaptureLiveCycle() {
+        // called at the end of a live cycle: keeps the frames and values of
+        // this cycle together, so that a bundle packed later does not mix
+        // them with products of the next cycle
+        std::shared_ptr<LiveCycleProducts> products = std::make_shared<LiveCycleProducts>();
+        products->seq = live_cycle_seq.load();
+        products->timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        for (const BundleFrameDef& d : bundle_frame_defs) {
+            GeneralHistogram* h = m_hist_map.at(d.histname);
+            TangoFramePtr frame = d.accu ? h->GetTangoAccuFrame() : h->GetTangoFrame();
+            if (frame && !frame->data.empty())
+                products->frames[d.name] = frame;
+        }
+        products->scalars = imagestat_vals;
+        products->scalars["Counts_Per_Sec"] = counts_per_sec_val;
+        if (tdc_statistics_active) {
+            TDCStatSnapshot snap;
+            {
+                std::lock_guard<std::mutex> lock(tdc_stat_ring_mutex);
+                if (tdc_stat_ring_count>0)
+                    snap = tdc_stat_ring[(tdc_stat_ring_count-1) % tdc_stat_history_size];
+            }
+            if (snap.seq>0)
+                TDCStatValues(snap.stats, products->tdc_stats);
+        }
+        std::lock_guard<std::mutex> lock(bundle_mutex);
+        live_cycle_products = products;
+    }
+
+    bool SurfaceConceptTDC::AddBundleProduct(std::vector<unsigned char>& out, const LiveCycleProducts& products,
+            const std::string& name, bool compress) {
+        for (const BundleFrameDef& d : bundle_frame_defs) {
+            if (name.compare(d.name)!=0)
+                continue;
+            auto it = products.frames.find(name);
+            if (it==products.frames.end())
+                return false;
+            const TangoFramePtr& frame = it->second;
+            if (d.taxis)
+                BundleAddDouble(out, name, frame->taxis.data(), frame->taxis.size());
+            else
+                BundleAddInt32(out, name, frame->data.data(), frame->width, d.image ? frame->height : 0, frame->seq, compress);
+            return true;
+        }
+        auto scalar = products.scalars.find(name);
+        if (scalar!=products.scalars.end()) {
+            Tango::DevLong v = scalar->second;
+            BundleAddInt32(out, name, &v, 1, 0, 0, false);
+            return true;
+        }
+        for (auto& s : products.tdc_stats) {
+            if (name.compare(s.first)!=0)
+                continue;
+            BundleAddInt32(out, name, s.second.data(), s.second.size(), 0, 0, false);
+            return true;
+        }
+        return false;
+    }
+
+    SurfaceConceptTDC::EncodedFramePtr SurfaceConceptTDC::BuildFrameBundle(const std::vector<std::string>& contents) {
+        LiveCycleProductsPtr products;
+        {
+            std::lock_guard<std::mutex> lock(bundle_mutex);
+            products = live_cycle_products;
+        }
+        std::shared_ptr<EncodedFrame> bundle = std::make_shared<EncodedFrame>();
+        if (!products) {
+            BundleBegin(bundle->data, 0, 0); // no live cycle yet
+            return bundle;
+        }
+        bundle->seq = products->seq;
+        BundleBegin(bundle->data, products->seq, products->timestamp_ms);
+        for (const std::string& name : contents)
+            AddBundleProduct(bundle->data, *products, name, frame_bundle_compressed_val); // unavailable products are left out
+        server_bundle_size_val = bundle->data.size();
+        return bundle;
+    }
+
+    void SurfaceConceptTDC::PushFrameBundle() {
+        if (!IsViewConsumed("Frame_Bundle"))
+            return;
+        if (bundle_push_pending.exchange(true))
+            return; // the queued job packs the newest cycle
+        executor.Push(lane_encode, [this] {
+            bundle_push_pending = false;
+            EncodedFramePtr bundle = BuildFrameBundle(frame_bundle_contents);
+            try {
+                push_change_event("Frame_Bundle", &bundle_format_val,
+                        const_cast<Tango::DevUChar*>(bundle->data.data()), bundle->data.size());
+            }
+            catch (Tango::DevFailed& e) {
+                std::cout << "DevFailed exception occured in PushFrameBundle(...)" << std::endl;
+                Helper::cout_tango_devfailed_exception(e);
+            }
+        });
+    }
+
+    Tango::DevEncoded* SurfaceConceptTDC::get_frame_bundle(Tango::DevString argin) {
+        // argin: comma separated list of the products (histogram images and
+        // spectra, time axes, Hist_*_Max, Hist_*_Q998, Counts_Per_Sec,
+        // TDC_Stat_*); names of unavailable products are accepted and left out
+        std::vector<std::string> contents;
+        for (const std::string& s : Helper::split(argin, ',')) {
+            std::string name = Helper::trimmed(s);
+            if (name.empty())
+                continue;
+            contents.push_back(name);
+            NoteViewRead(name); // marks the demand only, the following cycles compute it
+        }
+        // packs the products of the last captured live cycle, never waits
+        EncodedFramePtr bundle = BuildFrameBundle(contents);
+        Tango::DevEncoded* argout = new Tango::DevEncoded();
+        argout->encoded_format = CORBA::string_dup(BUNDLE_FORMAT);
+        argout->encoded_data.length(bundle->data.size());
+        std::copy(bundle->data.begin(), bundle->data.end(), argout->encoded_data.get_buffer());
+        return argout;
+    }
+
+    bool SurfaceConceptTDC::is_GetFrameBundle_allowed(const CORBA::Any& any) {
+        return true;
+    }
+
+    void SurfaceConceptTDC::Bundle_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Frame_Bundle")==0) {
+            NoteViewRead(attrname);
+            for (const std::string& name : frame_bundle_contents)
+                NoteViewRead(name); // marks the demand only, see get_frame_bundle
+            EncodedFramePtr bundle = BuildFrameBundle(frame_bundle_contents);
+            std::lock_guard<std::mutex> lock(bundle_mutex);
+            read_bundle = bundle; // keeps the data valid until the next read
+            att.set_value(&bundle_format_val, const_cast<Tango::DevUChar*>(bundle->data.data()), bundle->data.size());
+        }
+        else if (attrname.compare("Frame_Bundle_Compressed")==0) {
+            att.set_value(&frame_bundle_compressed_val);
+        }
+        else if (attrname.compare("Server_Bundle_Size")==0) {
+            att.set_value(&server_bundle_size_val);
+        }
+    }
+
+    void SurfaceConceptTDC::Bundle_WriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Frame_Bundle_Compressed")==0) {
+            att.get_write_value(frame_bundle_compressed_val);
+        }
+    }
+
+} // namespace
@@ -27,6 +27,7 @@
 #include "SurfaceConceptTDC.h"
 #include "SaveXYTtoTiff.h"
 #include "SaveXYtoText.h"
+#include "BufferPool.h"
 #include "Helper.h"
 #include <sstream>
 #include <iomanip>
@@ -50,12 +51,7 @@ namespace SurfaceConceptTDC_ns {
             server_save_file_busy_val = true;
         }
         
-        if (save_thread!=NULL) {
-            delete save_thread;
-            save_thread = NULL;
-        }
-        save_thread = new std::thread(&SurfaceConceptTDC::StaticSaveThreadedAction, this);
-        save_thread->detach();
+        executor.Push(lane_io, [this]{ this->SaveThreadedAction(); });
     }
     
     bool SurfaceConceptTDC::is_SaveXytToTiff_allowed(const CORBA::Any &any) {
@@ -80,12 +76,7 @@ namespace SurfaceConceptTDC_ns {
             server_save_file_busy_val = true;
         }
         
-        if (save_thread!=NULL) {
-            delete save_thread;
-            save_thread = NULL;
-        }
-        save_thread = new std::thread(&SurfaceConceptTDC::StaticSaveXYThreadedAction, this);
-        save_thread->detach();    
+        executor.Push(lane_io, [this]{ this->SaveXYThreadedAction(); });
     }    
     
     bool SurfaceConceptTDC::is_SaveXyToTiff_allowed(const CORBA::Any &any) {
@@ -124,12 +115,7 @@ namespace SurfaceConceptTDC_ns {
             server_save_file_busy_val = true;
         }
         
-        if (save_thread!=NULL) {
-            delete save_thread;
-            save_thread = NULL;
-        }
-        save_thread = new std::thread(&SurfaceConceptTDC::StaticSaveXYTextThreadedAction, this);
-        save_thread->detach();    
+        executor.Push(lane_io, [this]{ this->SaveXYTextThreadedAction(); });
     }    
     
     bool SurfaceConceptTDC::is_SaveXyToText_allowed(const CORBA::Any &any) {
@@ -140,6 +126,7 @@ namespace SurfaceConceptTDC_ns {
     }    
 
     void SurfaceConceptTDC::SaveThreadedAction() {
+        PipelineTelemetry::Scope save_scope(telemetry, stage_save);
         long start = Helper::get_millisec();
         std::string filename(save_filename_val);
         std::replace(filename.begin(), filename.end(), ' ', '_');
@@ -153,10 +140,23 @@ namespace SurfaceConceptTDC_ns {
         std::ostringstream oss;
         oss << std::setfill('0') << std::setw(3) << save_filecounter_val << "_" << filename;
         std::string filename_w_ctr = oss.str();
-        filename_w_ctr = Helper::ensure_extension(filename_w_ctr, ".tif");
-        if (SaveXYTtoTiff(*m_hist_map.at("Hist_Accu_XYT"), directory, filename_w_ctr)) {
+        GeneralHistogram& xyt = *m_hist_map.at("Hist_Accu_XYT");
+        // the sweep must not change the overflow table during the save
+        std::lock_guard<std::mutex> lock(accu_buffers_mutex);
+        CompleteAccuSweep();
+        // out-of-core accumulation: the data set is already in a file, save
+        // a copy of it (a clone on copy-on-write file systems) unless carries
+        // of wrapped voxels have to be added
+        bool raw = out_of_core_save_raw && xyt.IsFileBacked() && xyt.GetNrOverflowVoxels()==0;
+        filename_w_ctr = Helper::ensure_extension(filename_w_ctr, raw ? ".raw" : ".tif");
+        bool saved = false;
+        if (raw)
+            saved = xyt.WritebackDatabuf() && xyt.CloneDatabufTo(Helper::join_pathnames(directory, filename_w_ctr));
+        else
+            saved = SaveXYTtoTiff(xyt, directory, filename_w_ctr);
+        if (saved) {
             long end = Helper::get_millisec();
-            std::cout << "Saved TIFF to file " << filename_w_ctr << " in " << end-start << " milliseconds." << std::endl;
+            std::cout << "Saved " << (raw ? "raw data" : "TIFF") << " to file " << filename_w_ctr << " in " << end-start << " milliseconds." << std::endl;
             save_last_filename = filename_w_ctr;
             // write measurement info
             std::string infofilename = filename_w_ctr.substr(0, filename_w_ctr.length()-4)+"_info.txt";
@@ -167,27 +167,16 @@ namespace SurfaceConceptTDC_ns {
             msg = msg + directory + "/" + filename_w_ctr;
             strncpy(server_message_val, msg.c_str(), STRING_BUF_SIZE-1);
         } else {
-            strncpy(server_message_val, "Error: Failed attempt to save the dataset to a TIFF file", STRING_BUF_SIZE-1);
+            strncpy(server_message_val, raw ? "Error: Failed attempt to save the dataset to a raw file"
+                    : "Error: Failed attempt to save the dataset to a TIFF file", STRING_BUF_SIZE-1);
         }
         // 
         save_task_busy = false;
         server_save_file_busy_val = false;
     }
 
-    void SurfaceConceptTDC::StaticSaveThreadedAction(void* Object) {
-        ((SurfaceConceptTDC*) Object)->SaveThreadedAction();
-    }
-
-    void SurfaceConceptTDC::StaticSaveXYThreadedAction(void* Object) {
-        static_cast<SurfaceConceptTDC*>(Object)->SaveXYThreadedAction();
-    }
-    
-    void SurfaceConceptTDC::StaticSaveXYTextThreadedAction(void* Object) {
-        static_cast<SurfaceConceptTDC*>(Object)->SaveXYTextThreadedAction();
-    }
-    
-
     void SurfaceConceptTDC::SaveXYThreadedAction() {
+        PipelineTelemetry::Scope save_scope(telemetry, stage_save);
         long start = Helper::get_millisec();
         std::string filename(save_filename_val);
         std::replace(filename.begin(), filename.end(), ' ', '_');
@@ -204,7 +193,7 @@ namespace SurfaceConceptTDC_ns {
         filename_w_ctr = Helper::ensure_extension(filename_w_ctr, "_XY.tif");
         if (SaveXYtoTiff(*m_hist_map.at("Hist_Accu_XY"), directory, filename_w_ctr)) {
             long end = Helper::get_millisec();
-            std::cout << "Saved TIFF to file " << filename_w_ctr << " in " << end-start << " milliseconds." << std::endl;
+            std::cout << "Saved XY image to file " << filename_w_ctr << " in " << end-start << " milliseconds." << std::endl;
             save_last_filename = filename_w_ctr;
             // write measurement info
             std::string infofilename = filename_w_ctr.substr(0, filename_w_ctr.length()-4)+"_info.txt";
@@ -224,6 +213,7 @@ namespace SurfaceConceptTDC_ns {
     }
 
     void SurfaceConceptTDC::SaveXYTextThreadedAction() {
+        PipelineTelemetry::Scope save_scope(telemetry, stage_save);
         long start = Helper::get_millisec();
         std::string filename(save_filename_val);
         std::replace(filename.begin(), filename.end(), ' ', '_');
@@ -276,6 +266,10 @@ namespace SurfaceConceptTDC_ns {
         f << "    region of interest y: " << h->roiy1 << " to " << h->roiy2 << std::endl;
         f << "    region of interest t: " << h->roit1 << " to " << h->roit2 << std::endl;
         f << "    modulo: " << h->modulo << std::endl;
+        if (save_last_filename.size()>4 && save_last_filename.substr(save_last_filename.size()-4).compare(".raw")==0) {
+            f << "Raw data: " << h->GetWidth() << " x " << h->GetHeight() << " x " << h->GetZSize()
+                    << " voxels, x fastest, " << h->depth << "-bit unsigned integers, native byte order" << std::endl;
+        }
         f.close();
     }
     
@@ -296,11 +290,20 @@ namespace SurfaceConceptTDC_ns {
         }
         // if this spot is reached, acquisition is not running
         // now is a good time to reallocate memory if necessary (done by SetPipeActive)
-        if (!m_hist_map.at("Hist_Accu_XYT")->GetPipeActive())
-            m_hist_map.at("Hist_Accu_XYT")->SetPipeActive(true);
-        if (!m_hist_map.at("Hist_Accu_XYT")->GetPipeActive()) // succesful?
-            return;
-        m_hist_map.at("Hist_Accu_XYT")->ClearBuffer();
+        {
+            // a sweep or refresh on the Accu lane may still read the cube
+            std::lock_guard<std::mutex> lock(accu_buffers_mutex);
+            if (!m_hist_map.at("Hist_Accu_XYT")->GetPipeActive())
+                m_hist_map.at("Hist_Accu_XYT")->SetPipeActive(true);
+            if (!m_hist_map.at("Hist_Accu_XYT")->GetPipeActive()) // succesful?
+                return;
+            m_hist_map.at("Hist_Accu_XYT")->ClearBuffer();
+            info_accu_xyt_overflow_voxels_val = 0; // the overflow table is cleared with the buffer
+            info_accu_xyt_wrap_risk_val = 0;
+            accu_sweep_start_ms = Helper::get_millisec();
+            accu_sweeps_seen = 0;
+            accu_sweep_final_pending = false;
+        }
         m_hist_map.at("Hist_Full_T")->ZeroTangoAccuBufferDevLong();
         m_hist_map.at("Hist_User_T")->ZeroTangoAccuBufferDevLong();
         _acquisition_start(); 
@@ -417,15 +420,10 @@ namespace SurfaceConceptTDC_ns {
 
 
     bool SurfaceConceptTDC::SaveSpectrum(GeneralHistogram& hist, const std::string path, const std::string filename, bool from_tango_accu_buf) {
-        uint32_t *pthist = (uint32_t*) hist.GetDatabufPointer();
-        Tango::DevLong* p_accuhist = hist.GetTangoAccuBuffer();
-        if (!from_tango_accu_buf && pthist==NULL) return false;
-        if (from_tango_accu_buf && p_accuhist==NULL) return false;
-        if (hist.depth!=32) {
-            std::cout << "SaveSpectrum: bit depths other than 32 not implemented yet!" << std::endl;
-            std::cout << " Cancelling saving of spectrum." << std::endl;
-            return false;
-        }
+        PipelineTelemetry::Scope save_scope(telemetry, stage_save);
+        TangoFramePtr accuframe = hist.GetTangoAccuFrame(); // keeps the accumulated data stable while writing
+        if (!from_tango_accu_buf && hist.GetDatabufPointer()==NULL) return false;
+        if (from_tango_accu_buf && !accuframe) return false;
         std::string fullpath = Helper::join_pathnames(path, filename);
         if (Helper::test_file_exists(fullpath)) {
             std::cout << "SaveSpectrum: file already exists!" << std::endl;
@@ -468,6 +466,8 @@ namespace SurfaceConceptTDC_ns {
         outf << "### START OF DATA" << std::endl;
         
         if (from_tango_accu_buf) {
+            const Tango::DevLong* p_accuhist = accuframe->data.data();
+            if (w>accuframe->width) w = accuframe->width;
             for (int x = 0; x<w; x++) {
                 long xbinned = x+hist.roix1;
                 outf << xbinned << "\t" << xbinned*hist.bint << "\t" << ((double)xbinned*hist.bint)*devprop_pixel_size_t_val*1e-12 << "\t" << p_accuhist[x] << std::endl;
@@ -476,7 +476,7 @@ namespace SurfaceConceptTDC_ns {
         else {
             for (int x = 0; x<w; x++) {
                 long xbinned = x+hist.roix1;
-                outf << xbinned << "\t" << xbinned*hist.bint << "\t" << ((double)xbinned*hist.bint)*devprop_pixel_size_t_val*1e-12 << "\t" << pthist[x] << std::endl;
+                outf << xbinned << "\t" << xbinned*hist.bint << "\t" << ((double)xbinned*hist.bint)*devprop_pixel_size_t_val*1e-12 << "\t" << hist.GetDatabufValue(x) << std::endl;
             }
         }
         outf.close();
@@ -498,6 +498,7 @@ namespace SurfaceConceptTDC_ns {
                     h.second->SetPipeActive(true);
             }
         }
+        BufferPool::Shared().Purge(); // unmap the released buffers
             
     }
 
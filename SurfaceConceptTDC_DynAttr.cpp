@@ -27,6 +27,7 @@
 #include <vector>
 #include <string.h>
 #include <thread>
+#include <chrono>
 #include <iomanip>
 #include <scTDC_types.h>
 #include <scTDC_deprecated.h>
@@ -38,6 +39,7 @@
 #include "Helper.h"
 #include "IntegrateXYT.h"
 #include "SaveAfterAccumModes.h"
+#include "FrameCodec.h"
 
 namespace SurfaceConceptTDC_ns {
 
@@ -337,7 +339,7 @@ void SurfaceConceptTDC::AddImagePreviewPollingAttribute() {
     attrprop2.min_value = "0";
     attrprop2.format    = "%4d";
     attrprop2.unit      = "ms";
-    attrprop2.description = std::string("Period of internal timer which issues updates of live images and accumulation preview.");
+    attrprop2.description = std::string("Period of internal timer which updates the accumulated time. Live images and accumulation preview are updated with the periods given by ExposureLive and Accu_Preview_Refresh.");
     image_preview_polling_attr->set_default_properties(attrprop2);
     image_preview_polling_attr->set_memorized_init(true);
     image_preview_polling_attr->set_memorized();
@@ -380,6 +382,10 @@ void SurfaceConceptTDC::HistogramAttributeWriteCallbackAction(const std::string
     // methods)
     string name = attrname;
     string hist_name = Helper::extract_hist_name(name);
+    // reject configurations whose data buffer exceeds the memory budget
+    // before the running acquisition is stopped for it
+    if (!AdmitHistogramAttr(hist_name, Helper::extract_hist_remainder(name), w_val))
+        return;
     if (std::find(pipeless_histograms.begin(), pipeless_histograms.end(),hist_name)==pipeless_histograms.end()) {
         if (accumulation_running) // do not allow changes to pipe histograms during accumulation
             return;
@@ -394,7 +400,8 @@ void SurfaceConceptTDC::HistogramAttributeWriteCallbackAction(const std::string
     string subatt_name = Helper::extract_hist_remainder(name);
     // the following operation may take longer than 1 second and should be executed in a thread
     // such that the attribute write callback can return before timeout
-    thread_pool.push([this, hist_name, subatt_name, w_val](int id){this->SetHistogramAttrLinked(hist_name, subatt_name, w_val);});
+    // (the config lane has a single worker by default, which keeps the order of the writes)
+    executor.Push(lane_config, [this, hist_name, subatt_name, w_val]{this->SetHistogramAttrLinked(hist_name, subatt_name, w_val);});
     //SetHistogramAttrLinked(hist_name, subatt_name, w_val);
 }
 
@@ -490,44 +497,114 @@ void SurfaceConceptTDC::SetHistogramAttrLinked(const std::string histname, const
 
 void SurfaceConceptTDC::Update_Info_Accu_XYT_Size() {
     GeneralHistogram* h = m_hist_map.at("Hist_Accu_XYT");
-    long sz = h->GetZSize()*h->GetHeight()*h->GetWidth()*4; // 32-bit
+    long sz = h->GetZSize()*h->GetHeight()*h->GetWidth()*(h->depth/8);
     info_accu_xyt_bytesize_val = sz;
     std::string fsz = Helper::Format_Bytesize(sz, 2);
     strncpy(info_accu_xyt_formattedsize_val, fsz.c_str(), STRING_BUF_SIZE-1);
 }
  
+void SurfaceConceptTDC::SweepAccuCounters() {
+    // this function must be called only via accu_sweep_job, which is
+    // requested after every measurement while accumulating; each run
+    // continues the sweep through the Accu XYT cube with at most one chunk
+    // (out-of-core cube) or sweep_bytes_per_call. The sweep only reads the
+    // cube, so it runs on the Accu lane while the next measurement counts.
+    // With 8- or 16-bit counters, it adds the carries of counters that have
+    // wrapped around to the sparse overflow table of the histogram
+    static const long sweep_bytes_per_call = 256L*1048576;
+    GeneralHistogram* h = m_hist_map.at("Hist_Accu_XYT");
+    if (h->depth>=32)
+        return;
+    std::lock_guard<std::mutex> lock(accu_buffers_mutex);
+    if (!accumulation_running) {
+        // the accumulation has stopped after the last measurement
+        CompleteAccuSweep();
+        return;
+    }
+    if (!h->GetPipeActive())
+        return;
+    long slice = h->GetWidth()*h->GetHeight()*(h->depth/8);
+    long max_slices = h->IsFileBacked() ? h->GetChunkZSize() : (slice>0 ? sweep_bytes_per_call/slice : 1);
+    h->SweepCounters(max_slices<1 ? 1 : max_slices);
+    info_accu_xyt_overflow_voxels_val = h->GetNrOverflowVoxels();
+    if (h->GetSweeps()==accu_sweeps_seen)
+        return;
+    // a sweep is complete: a narrow counter wraps around unnoticed if it
+    // gains half of its range between two visits, at most all events
+    // counted during the sweep (the rate includes events outside of the
+    // region of interest)
+    long now = Helper::get_millisec();
+    double max_gain = (double) counts_per_sec_val * (now - accu_sweep_start_ms) / 1000.0;
+    accu_sweep_start_ms = now;
+    accu_sweeps_seen = h->GetSweeps();
+    if (max_gain < (double) (1L << (h->depth-1)))
+        return;
+    if (info_accu_xyt_wrap_risk_val++==0) {
+        std::string msg = "Warning: counts of the Accu XYT buffer may be lost, up to "
+                + std::to_string((long) max_gain) + " events per sweep exceed the range of DEPTH "
+                + std::to_string(h->depth) + "; use DEPTH 32 or shorter exposures";
+        std::cout << "ERROR: SurfaceConceptTDC::SweepAccuCounters:" << std::endl;
+        std::cout << " " << msg << std::endl;
+        strncpy(server_message_val, msg.c_str(), STRING_BUF_SIZE-1);
+    }
+}
+
+void SurfaceConceptTDC::CompleteAccuSweep() {
+    // caller must hold accu_buffers_mutex; once the measurements have
+    // stopped, every narrow counter is visited once more, so that the carries
+    // of wraps since the last visits are in the overflow table before the
+    // cube is integrated or saved
+    if (accumulation_running || !accu_sweep_final_pending.exchange(false))
+        return;
+    GeneralHistogram* h = m_hist_map.at("Hist_Accu_XYT");
+    if (h->depth>=32)
+        return;
+    h->CompleteSweep();
+    info_accu_xyt_overflow_voxels_val = h->GetNrOverflowVoxels();
+}
+
 void SurfaceConceptTDC::LiveImageTriggerAction() {
-    // get time
-    
-    long v = Helper::get_millisec();
-    long delta = v - image_preview_last_timestamp; // correct even if millisec counter has had an overflow
-    
-    if (delta>=0 && delta<m_exposure_live_ms) // if not enough time passed, don't do anything
-        return; // (however, delta < 0 means the time *difference* has overflown)
+    // called by periodic_tasks every m_exposure_live_ms
+    image_preview_last_timestamp = Helper::get_millisec();
 
-    image_preview_last_timestamp = v;
+    // if a refresh is still running, the request is served by one more run
+    // after it has finished (see SetupPeriodicTasks for the job setup)
+    live_preview_refresh_job.Request();
+}
 
-    std::mutex m;
-    m.lock(); // protect the sequence of test and assignment of preview_refresh_task_busy against interference by another thread
-    if (live_preview_refresh_task_busy) {
-        std::cout << "SurfaceConceptTDC::LiveImageTriggerAction skipping concurrent refresh task" << std::endl;
-        m.unlock();
-        return; 
-    }
-    live_preview_refresh_task_busy = true; // the task_busy variable is set to false by the thread after it has finished its tasks
-    m.unlock();
-    if (live_preview_refresh_thread!=NULL) {
-        delete live_preview_refresh_thread;
-        live_preview_refresh_thread = NULL;
-    }
-    
-    //live_preview_refresh_thread = new std::thread(&SurfaceConceptTDC::StaticLiveImageTriggerThreadedAction, this);
-    //live_preview_refresh_thread->detach();
-    thread_pool.push([this](int id){this->LiveImageTriggerThreadedAction();});
+bool SurfaceConceptTDC::IsLiveOutputHist(const std::string& histname) {
+    // the histograms whose data buffers are turned into live frames
+    return histname.find("_Live_")!=std::string::npos || histname.compare("Hist_Full_XY")==0 ||
+            histname.compare("Hist_Full_T")==0 || histname.compare("Hist_User_T")==0;
+}
+
+bool SurfaceConceptTDC::SnapshotLiveBuffers() {
+    // event-driven live mode, called between two measurements: the live
+    // buffers are copied and zeroed before the next measurement starts, so
+    // that every frame holds whole exposures; the refresh job only converts
+    // and pushes the copies. While the job is still busy with the previous
+    // copies, the counts stay in the live buffers for the next frame
+    std::unique_lock<std::mutex> lock(live_snapshot_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || live_snapshot_pending)
+        return false;
+    PipelineTelemetry::Scope copy_scope(telemetry, stage_live_copy);
+    for (auto& hist : m_hist_map)
+        if (IsLiveOutputHist(hist.first))
+            hist.second->TakeSnapshot();
+    live_snapshot_pending = true;
+    return true;
 }
 
 void SurfaceConceptTDC::LiveImageTriggerThreadedAction() {
-    Helper::Finally finalaction([&]{live_preview_refresh_task_busy = false;}); // should work even when exceptions are thrown
+    // this function must be called only via live_preview_refresh_job
+    // in event-driven mode, the frames are computed from the copies taken by
+    // SnapshotLiveBuffers, the live buffers are filled by the next measurement
+    std::lock_guard<std::mutex> snapshot_lock(live_snapshot_mutex);
+    bool from_snapshot = live_snapshot_pending;
+    if (live_event_driven_val && !from_snapshot)
+        return;
+    PipelineTelemetry::Scope cycle_scope(telemetry, stage_live_cycle);
+    long long completion_ns = live_completion_timestamp_ns.exchange(0);
     if (!taxes_initialized && livePreviewModeTangoActive) {
         m_hist_map.at("Hist_Full_T")->ProvideTAxis(hist_full_taxis_attr, devprop_pixel_size_t_val, hist_taxis_unit_internal);
         m_hist_map.at("Hist_Live_T")->ProvideTAxis(hist_live_taxis_attr, devprop_pixel_size_t_val, hist_taxis_unit_internal);
@@ -536,38 +613,56 @@ void SurfaceConceptTDC::LiveImageTriggerThreadedAction() {
         taxes_initialized = true;
     }
     // Statistics of image:
-    LiveImageTriggerThreadedAction_ImageStat();
+    {
+        PipelineTelemetry::Scope stat_scope(telemetry, stage_image_stat);
+        LiveImageTriggerThreadedAction_ImageStat();
+    }
+    // Hist_Full_XY has no attribute of its own, it publishes frames only while viewports query it
+    m_hist_map.at("Hist_Full_XY")->SetTangoFrameOutputActive(IsViewportSource("Hist_Full_XY"));
     // Write Databuffers to Tango attributes and files
     for (auto &hist : m_hist_map) 
     {
-        if (hist.first.find("_Live_")!=std::string::npos || 
-                hist.first.compare("Hist_Full_XY")==0 ||
-                hist.first.compare("Hist_Full_T")==0) {
+        if (IsLiveOutputHist(hist.first) && hist.first.compare("Hist_User_T")!=0) {
             //std::cout << "calling PerformActiveOutputs for " << hist.first << std::endl;
-            hist.second->PerformActiveOutputs();
+            bool consumed = IsHistViewConsumed(hist.first);
+            if (!consumed) MarkHistViewSkipped(hist.first);
+            {
+                PipelineTelemetry::Scope copy_scope(telemetry, stage_live_copy);
+                hist.second->PerformActiveOutputs(consumed); // files and statistics are always written
+            }
             if (livePreviewModeTangoActive) {
                 if (accumulation_running)
                     hist.second->AddToTangoAccuBuffer(); // does nothing if it hasn't been activated before
                 // send live buffer update via push_change_event
-                Tango::DevLong* tbuf = hist.second->GetTangoBuffer();
-                if (tbuf!=NULL) {
-                    int h = hist.second->GetTangoBufferDataHeight();
+                TangoFramePtr frame = consumed ? hist.second->GetTangoFrame() : TangoFramePtr();
+                if (frame && hist.first.compare("Hist_Full_XY")!=0) { // Hist_Full_XY frames only feed the viewport
+                    int h = frame->height;
                     if (h<2) h = 0; // (BAD) handles spectra correctly, but images with height 1 incorrectly!
                     try {
-                        push_change_event(hist.first, tbuf, hist.second->GetTangoBufferDataWidth(), h);
+                        PipelineTelemetry::Scope push_scope(telemetry, stage_push);
+                        push_change_event(hist.first, FrameData(frame), frame->width, h);
                     }
                     catch (Tango::DevFailed e) {
                         std::cout << "DevFailed exception occured in LiveImageTriggerThreadedAction(...)" << std::endl;
                         Helper::cout_tango_devfailed_exception(e);
-                        image_preview_update_thread.Stop();
-                        image_preview_update_thread.Join();
+                        periodic_tasks.Stop();
+                        periodic_tasks.Join();
                     }
                 }
+                if (consumed)
+                    PushDerivedViews(hist.first, false);
             }
-            hist.second->ClearBuffer();
+            if (from_snapshot)
+                hist.second->ReleaseSnapshot();
+            else
+                hist.second->ClearBuffer();
         }
     }
     LiveImageTriggerThreadedAction_Hist_User_T(); // Hist_User_T is just treated separately, did not fit well into the previous for loop
+    live_snapshot_pending = false;
+    live_cycle_seq++;
+    CaptureLiveCycle();
+    PushFrameBundle();
     // update time stamp in live subfolder
     if (livePreviewModeFileActive) {
         std::string timestamp_path = Helper::join_pathnames(this->livePreviewModeFilePath, "live", "timestamp");
@@ -576,30 +671,46 @@ void SurfaceConceptTDC::LiveImageTriggerThreadedAction() {
         fwrite(&v, sizeof(v), 1, f);
         fclose(f);
     }
-    //live_preview_refresh_task_busy = false;
+    if (completion_ns>0) {
+        // event-driven mode: time from the end of the measurement until the frame has been pushed
+        live_completion_latency_val = (Helper::get_nanosec()-completion_ns)*1e-6;
+        if (live_completion_latency_val>live_completion_latency_max_val)
+            live_completion_latency_max_val = live_completion_latency_val;
+    }
 }
 
 void SurfaceConceptTDC::LiveImageTriggerThreadedAction_Hist_User_T() {
     GeneralHistogram* h = m_hist_map.at("Hist_User_T");
-    h->PerformActiveOutputs();
+    bool consumed = IsHistViewConsumed("Hist_User_T");
+    if (!consumed) MarkHistViewSkipped("Hist_User_T");
+    {
+        PipelineTelemetry::Scope copy_scope(telemetry, stage_live_copy);
+        h->PerformActiveOutputs(consumed);
+    }
     if (livePreviewModeTangoActive) {
         if (accumulation_running)
             h->AddToTangoAccuBuffer(); // does nothing if it hasn't been activated before
         // send live buffer update via push_change_event
-        Tango::DevLong* tbuf = h->GetTangoBuffer();
-        if (tbuf!=NULL) {
+        TangoFramePtr frame = consumed ? h->GetTangoFrame() : TangoFramePtr();
+        if (frame) {
             try {
-                push_change_event("Hist_Live_User_T", tbuf, h->GetTangoBufferDataWidth(), 0);
+                PipelineTelemetry::Scope push_scope(telemetry, stage_push);
+                push_change_event("Hist_Live_User_T", FrameData(frame), frame->width, 0);
             }
             catch (Tango::DevFailed e) {
                 std::cout << "DevFailed exception occured in LiveImageTriggerThreadedAction_Hist_User_T(...)" << std::endl;
                 Helper::cout_tango_devfailed_exception(e);
-                image_preview_update_thread.Stop();
-                image_preview_update_thread.Join();
+                periodic_tasks.Stop();
+                periodic_tasks.Join();
             }
         }
+        if (consumed)
+            PushDerivedViews("Hist_User_T", false);
     }
-    h->ClearBuffer();
+    if (live_snapshot_pending)
+        h->ReleaseSnapshot();
+    else
+        h->ClearBuffer();
 }
 
 void SurfaceConceptTDC::LiveImageTriggerThreadedAction_ImageStat() {
@@ -619,41 +730,30 @@ void SurfaceConceptTDC::StaticLiveImageTriggerThreadedAction(void* Object) {
 
 
 void SurfaceConceptTDC::CountsPerSecUpdate() {
-    // Timing logic: perform update only after 1 second since last update has passed
+    // called by periodic_tasks once per second, the actual time passed since
+    // the last call is used for normalization
     long v = Helper::get_millisec();
     long delta = v - counts_per_sec_last_timestamp; // correct even if millisec counter has had an overflow
-    if (delta>=0 && delta<1000) // if not enough time passed, don't do anything
-        return; // (however, delta < 0 means the time *difference* has overflown)
-    counts_per_sec_last_timestamp = v; 
+    counts_per_sec_last_timestamp = v;
+    if (delta<=0)
+        return;
     // now perform update
     GeneralHistogram *h = m_hist_map.at("Hist_Full_Counts");
-    void* buf = h->GetDatabufPointer();
-    if (buf!=NULL) {
-        double c = (double) *((uint32_t*)buf) * 1000.0 / ((double) delta);
+    if (h->GetDatabufPointer()!=NULL) {
+        double c = (double) h->GetDatabufValue(0) * 1000.0 / ((double) delta);
         counts_per_sec_val = (Tango::DevLong) c;
-        *((uint32_t*)buf) = 0;
+        h->ZeroDatabufValue(0);
     }
 }
 
 
-void SurfaceConceptTDC::ImagePreviewUpdateAction() {
-    LiveImageTriggerAction();
-    CountsPerSecUpdate();
-    AccuPreviewRefreshAction();
-    AccumulatedTimeIncrementAction();
-}
-
-void SurfaceConceptTDC::StaticImagePreviewUpdateAction(void* Object) {
-    ((SurfaceConceptTDC*) Object)->ImagePreviewUpdateAction();
-}
-
 void SurfaceConceptTDC::ImagePreviewPollingReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
     att.set_value(&image_preview_polling_val);
 }
 
 void SurfaceConceptTDC::ImagePreviewPollingWriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& att) {
     att.get_write_value(image_preview_polling_val);
-    image_preview_update_thread.SetPeriod(image_preview_polling_val);
+    periodic_tasks.SetPeriod(task_accumulated_time_id, image_preview_polling_val>0 ? image_preview_polling_val : 1);
 }
 
 void SurfaceConceptTDC::AccumulatedTimeIncrementAction() {
@@ -704,66 +804,88 @@ void SurfaceConceptTDC::AccuPreviewRefreshReadCallback(Tango::DeviceImpl*, Tango
     
 void SurfaceConceptTDC::AccuPreviewRefreshWriteCallback(Tango::DeviceImpl*dev, Tango::WAttribute& att) {
     att.get_write_value(accu_preview_refresh_val);
+    periodic_tasks.SetPeriod(task_accu_refresh_id, accu_preview_refresh_val); // 0 disables the refresh
 }
 
 void SurfaceConceptTDC::AccuPreviewRefreshAction() {
+    // called by periodic_tasks every accu_preview_refresh_val milliseconds
     if (accu_preview_refresh_val==0) return;
-
-    long v = Helper::get_millisec();
-
-    long delta = v - accu_preview_refresh_timestamp; // correct even if millisec counter has had an overflow
-    if (delta>=0 && delta<accu_preview_refresh_val) // if not enough time passed, don't do anything
-        return;
-    // if we decide that enough time has passed, update our timestamp
-    accu_preview_refresh_timestamp = v;
+    accu_preview_refresh_timestamp = Helper::get_millisec();
     //std::cout << "SurfaceConceptTDC::PreviewRefreshAccuAction got called: " << v << std::endl;    
     if (m_hist_map.at("Hist_Accu_XYT")->GetDatabufPointer()==NULL)
         return;
-    // make sure the time-consuming integration of data is not concurrently executed several times
-    std::mutex m;
-    m.lock(); // protect the sequence of test and assignment of preview_refresh_task_busy against interference by another thread
-    if (accu_preview_refresh_task_busy) {
-        std::cout << "SurfaceConceptTDC::AccuPreviewRefreshAction skipping concurrent integration task" << std::endl;
-        m.unlock();
-        return; 
-    }
-    accu_preview_refresh_task_busy = true; // the task_busy variable is set to false by the thread after it has finished its tasks
-    m.unlock();
-
-    thread_pool.push([this](int id){this->AccuPreviewRefreshThreadedAction();});
-    
+    // the time-consuming integration of data is never executed concurrently,
+    // requests during a running integration are coalesced into one more run
+    accu_preview_refresh_job.Request();
 }
 
-void SurfaceConceptTDC::AccuPreviewRefreshThreadedAction() {
-    accu_buffers_mutex.lock();
-    Helper::Finally finalaction([&]{accu_preview_refresh_task_busy = false; accu_buffers_mutex.unlock();});  // should work even when exceptions are thrown
-    // this function must be called only from AccuPreviewRefreshAction
-    // -------------------------------------------------------------------------
-    long start = Helper::get_millisec();
-    // Integrate the XYT data set to XY, XT, YT images
-    int xy_retval =
-        IntegrateXYT_T(*m_hist_map.at("Hist_Accu_XYT"), *m_hist_map.at("Hist_Accu_XY"),
+int SurfaceConceptTDC::IntegrateAccuView(const std::string& histname) {
+    // caller must hold accu_buffers_mutex
+    GeneralHistogram& xyt = *m_hist_map.at("Hist_Accu_XYT");
+    GeneralHistogram& target = *m_hist_map.at(histname);
+    if (histname.compare("Hist_Accu_XY")==0)
+        return IntegrateXYT_T(xyt, target,
             m_dyn_attr_long_vals["Hist_Accu_XY_ROI_T1"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_T1"], 
             m_dyn_attr_long_vals["Hist_Accu_XY_ROI_T2"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_T1"]);
-    int xt_retval = 
-    IntegrateXYT_Y(*m_hist_map.at("Hist_Accu_XYT"), *m_hist_map.at("Hist_Accu_XT"),
+    else if (histname.compare("Hist_Accu_XT")==0)
+        return IntegrateXYT_Y(xyt, target,
             m_dyn_attr_long_vals["Hist_Accu_XT_ROI_Y1"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_Y1"], 
             m_dyn_attr_long_vals["Hist_Accu_XT_ROI_Y2"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_Y1"]);
-    int yt_retval = 
-    IntegrateXYT_X(*m_hist_map.at("Hist_Accu_XYT"), *m_hist_map.at("Hist_Accu_YT"),
+    else if (histname.compare("Hist_Accu_YT")==0)
+        return IntegrateXYT_X(xyt, target,
             m_dyn_attr_long_vals["Hist_Accu_YT_ROI_X1"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_X1"], 
             m_dyn_attr_long_vals["Hist_Accu_YT_ROI_X2"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_X1"]);
-    int t_retval = 
-    IntegrateXYT_XY(*m_hist_map.at("Hist_Accu_XYT"), *m_hist_map.at("Hist_Accu_T"),
+    else if (histname.compare("Hist_Accu_T")==0)
+        return IntegrateXYT_XY(xyt, target,
             m_dyn_attr_long_vals["Hist_Accu_T_ROI_X1"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_X1"], 
             m_dyn_attr_long_vals["Hist_Accu_T_ROI_X2"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_X1"],
             m_dyn_attr_long_vals["Hist_Accu_T_ROI_Y1"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_Y1"], 
             m_dyn_attr_long_vals["Hist_Accu_T_ROI_Y2"]-m_dyn_attr_long_vals["Hist_Accu_XYT_ROI_Y1"]);
+    return -1;
+}
+
+void SurfaceConceptTDC::AccuPreviewRefreshThreadedAction() {
+    accu_buffers_mutex.lock();
+    Helper::Finally finalaction([&]{accu_buffers_mutex.unlock();});  // should work even when exceptions are thrown
+    // this function must be called only via accu_preview_refresh_job
+    // -------------------------------------------------------------------------
+    PipelineTelemetry::Scope cycle_scope(telemetry, stage_accu_cycle);
+    long start = Helper::get_millisec();
+    CompleteAccuSweep(); // the final refresh after the last measurement
+    // Integrate the XYT data set to XY, XT, YT images and the T spectrum;
+    // projections that are neither exported to files nor consumed by any
+    // client are skipped and computed after they are read (see NoteViewRead)
+    // once the measurements have stopped, rows of the cube without counts
+    // are flagged once and skipped by all integrations of this refresh
+    GeneralHistogram* xyt = m_hist_map.at("Hist_Accu_XYT");
+    bool occupancy_updated = false;
+    // the occupancy scan and the projections pass through the cube one
+    // after the other, an out-of-core cube is dropped after the last one
+    xyt->BeginZPasses();
+    Helper::Finally invalidate([&]{xyt->InvalidateRowOccupancy(); xyt->EndZPasses();});
+    std::map<std::string, int> retval;
+    for (std::string key : {"Hist_Accu_XY", "Hist_Accu_XT", "Hist_Accu_YT", "Hist_Accu_T"}) {
+        if (livePreviewModeFileActive || IsHistViewConsumed(key)) {
+            PipelineTelemetry::Scope integration_scope(telemetry, stage_integration);
+            if (!occupancy_updated && !accumulation_running) {
+                // while accumulating, counts keep arriving in empty rows and
+                // no rows are skipped
+                long nrows = xyt->GetHeight()*xyt->GetZSize();
+                long occupied = xyt->UpdateRowOccupancy();
+                info_accu_xyt_occupancy_val = nrows>0 ? 100.0*occupied/nrows : 0.0;
+                occupancy_updated = true;
+            }
+            retval[key] = IntegrateAccuView(key);
+        }
+        else {
+            MarkHistViewSkipped(key);
+            retval[key] = -1;
+        }
+    }
     if (livePreviewModeFileActive) {
-        if (xy_retval==0) m_hist_map.at("Hist_Accu_XY")->WriteFile();
-        if (xt_retval==0) m_hist_map.at("Hist_Accu_XT")->WriteFile();
-        if (yt_retval==0) m_hist_map.at("Hist_Accu_YT")->WriteFile();
-        if (t_retval==0) m_hist_map.at("Hist_Accu_T")->WriteFile();
+        PipelineTelemetry::Scope file_scope(telemetry, stage_file_write);
+        for (auto& r : retval)
+            if (r.second==0) m_hist_map.at(r.first)->WriteFile();
         // update time stamp in accu subfolder
         std::string timestamp_path = Helper::join_pathnames(this->livePreviewModeFilePath, "accu", "timestamp");
         FILE *f = fopen(timestamp_path.c_str(), "w");
@@ -773,70 +895,82 @@ void SurfaceConceptTDC::AccuPreviewRefreshThreadedAction() {
     }
     if (livePreviewModeTangoActive) {
         GeneralHistogram* hist = m_hist_map.at("Hist_Accu_T");
-        hist->WriteTangoBuffer();
-        Tango::DevLong* tbuf = hist->GetTangoBuffer();
-        if (tbuf!=NULL) {
-            int h = hist->GetTangoBufferDataHeight();
+        TangoFramePtr frame;
+        if (retval["Hist_Accu_T"]==0) {
+            hist->WriteTangoBuffer();
+            frame = hist->GetTangoFrame();
+        }
+        if (frame) {
+            int h = frame->height;
             if (h<2) h = 0; // (BAD) handles spectra correctly, but images with height 1 incorrectly!
             try {
-                push_change_event("Hist_Accu_T", tbuf, hist->GetTangoBufferDataWidth(), h);
+                PipelineTelemetry::Scope push_scope(telemetry, stage_push);
+                push_change_event("Hist_Accu_T", FrameData(frame), frame->width, h);
             }
             catch (Tango::DevFailed e) {
                 std::cout << "DevFailed exception occured in AccuPreviewRefreshThreadedAction(...)" << std::endl;
                 Helper::cout_tango_devfailed_exception(e);
-                image_preview_update_thread.Stop();
-                image_preview_update_thread.Join();
+                periodic_tasks.Stop();
+                periodic_tasks.Join();
             }
+            PushDerivedViews("Hist_Accu_T", false);
         }
+        // compressed and decimated accumulated spectra (only computed if consumed)
+        PushDerivedViews("Hist_Full_T", true);
+        PushDerivedViews("Hist_User_T", true);
         // Hist_Full_Accu_T
         hist = m_hist_map.at("Hist_Full_T");
-        tbuf = hist->GetTangoAccuBuffer();
-        
-        if (tbuf!=NULL) {
-            int h = hist->GetTangoBufferDataHeight();
+        frame = IsViewConsumed("Hist_Full_Accu_T") ? hist->GetTangoAccuFrame() : TangoFramePtr();
+        if (frame) {
+            int h = frame->height;
             if (h<2) h = 0; // (BAD) handles spectra correctly, but images with height 1 incorrectly!
             try {
-                push_change_event("Hist_Full_Accu_T", tbuf, hist->GetTangoBufferDataWidth(), h);
+                PipelineTelemetry::Scope push_scope(telemetry, stage_push);
+                push_change_event("Hist_Full_Accu_T", FrameData(frame), frame->width, h);
             }
             catch (Tango::DevFailed e) {
                 std::cout << "DevFailed exception occured in AccuPreviewRefreshThreadedAction(...)" << std::endl;
                 Helper::cout_tango_devfailed_exception(e);
-                image_preview_update_thread.Stop(); // <-- NOT THE BEST REACTION
-                image_preview_update_thread.Join(); // server stops working normally
+                periodic_tasks.Stop(); // <-- NOT THE BEST REACTION
+                periodic_tasks.Join(); // server stops working normally
             }
         }
         // Hist_User_Accu_T
         hist = m_hist_map.at("Hist_User_T");
-        tbuf = hist->GetTangoAccuBuffer();
-        
-        if (tbuf!=NULL) {
-            int h = hist->GetTangoBufferDataHeight();
+        frame = IsViewConsumed("Hist_Accu_User_T") ? hist->GetTangoAccuFrame() : TangoFramePtr();
+        if (frame) {
+            int h = frame->height;
             if (h<2) h = 0; // (BAD) handles spectra correctly, but images with height 1 incorrectly!
             try {
-                push_change_event("Hist_Accu_User_T", tbuf, hist->GetTangoBufferDataWidth(), h);
+                PipelineTelemetry::Scope push_scope(telemetry, stage_push);
+                push_change_event("Hist_Accu_User_T", FrameData(frame), frame->width, h);
             }
             catch (Tango::DevFailed e) {
                 std::cout << "DevFailed exception occured in AccuPreviewRefreshThreadedAction(...)" << std::endl;
                 Helper::cout_tango_devfailed_exception(e);
-                image_preview_update_thread.Stop(); // <-- NOT THE BEST REACTION
-                image_preview_update_thread.Join(); // server stops working normally
+                periodic_tasks.Stop(); // <-- NOT THE BEST REACTION
+                periodic_tasks.Join(); // server stops working normally
             }
         }
         // Accumulated Images XY, XT, YT
         for (std::string key : {"Hist_Accu_XY", "Hist_Accu_XT", "Hist_Accu_YT"}) {
+            if (retval[key]!=0)
+                continue;
             hist = m_hist_map.at(key);
             hist->WriteTangoBuffer();
-            tbuf = hist->GetTangoBuffer();
-            if (tbuf!=NULL) {
+            frame = hist->GetTangoFrame();
+            if (frame) {
                 try {
-                    push_change_event(key, tbuf, hist->GetTangoBufferDataWidth(), hist->GetTangoBufferDataHeight());
+                    PipelineTelemetry::Scope push_scope(telemetry, stage_push);
+                    push_change_event(key, FrameData(frame), frame->width, frame->height);
                 }
                 catch (Tango::DevFailed e) {
                     std::cout << "DevFailed exception occured in AccuPreviewRefreshThreadedAction(...)" << std::endl;
                     Helper::cout_tango_devfailed_exception(e);
-                    image_preview_update_thread.Stop(); // <-- NOT THE BEST REACTION
-                    image_preview_update_thread.Join(); // server stops working normally
+                    periodic_tasks.Stop(); // <-- NOT THE BEST REACTION
+                    periodic_tasks.Join(); // server stops working normally
                 }
+                PushDerivedViews(key, false);
             }
         }
     }
@@ -848,6 +982,8 @@ void SurfaceConceptTDC::AccuPreviewRefreshThreadedAction() {
 
 void SurfaceConceptTDC::AccuPreviewRefreshThreadedAction_ImageStat() {
     for (std::string hname : {"Hist_Accu_XY", "Hist_Accu_XT", "Hist_Accu_YT"}) {
+        if (!livePreviewModeFileActive && !IsHistViewConsumed(hname))
+            continue; // not integrated in this run
         GeneralHistogram* h = m_hist_map[hname];
         h->UpdateStatisticsOfDatabuf();
         imagestat_vals[hname+"_Max"] = h->GetStatMax();
@@ -985,6 +1121,35 @@ void SurfaceConceptTDC::AddDiagnosticAttributes() {
     info_accu_xyt_formattedsize_attr->set_default_properties(ap3);
     info_accu_xyt_formattedsize_attr->SetReadCallback(this, &SurfaceConceptTDC::DiagnosticAttributeReadCallback);
     this->add_attribute(info_accu_xyt_formattedsize_attr);
+    
+    info_accu_xyt_overflow_voxels_attr = new CustomAttr("Info_Accu_XYT_Overflow_Voxels", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+    Tango::UserDefaultAttrProp ap4;
+    ap4.set_description("Number of voxels of an 8- or 16-bit Accu XYT Buffer whose counts are partly kept in the overflow table");
+    ap4.set_format("%10d");
+    info_accu_xyt_overflow_voxels_attr->set_default_properties(ap4);
+    info_accu_xyt_overflow_voxels_attr->SetReadCallback(this, &SurfaceConceptTDC::DiagnosticAttributeReadCallback);
+    this->add_attribute(info_accu_xyt_overflow_voxels_attr);
+    
+    info_accu_xyt_wrap_risk_attr = new CustomAttr("Info_Accu_XYT_Wrap_Risk", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+    Tango::UserDefaultAttrProp ap4w;
+    ap4w.set_description("Number of sweeps through an 8- or 16-bit Accu XYT Buffer during which a voxel "
+            "could have gained more counts than half of its range (counts per second times sweep duration); "
+            "counts may have been lost, use DEPTH 32");
+    ap4w.set_format("%10d");
+    info_accu_xyt_wrap_risk_attr->set_default_properties(ap4w);
+    info_accu_xyt_wrap_risk_attr->SetReadCallback(this, &SurfaceConceptTDC::DiagnosticAttributeReadCallback);
+    this->add_attribute(info_accu_xyt_wrap_risk_attr);
+    
+    info_accu_xyt_occupancy_attr = new CustomAttr("Info_Accu_XYT_Occupancy", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+    Tango::UserDefaultAttrProp ap5;
+    ap5.set_description("Share of the rows of the Accu XYT Buffer that hold counts at the last accumulation preview refresh "
+            "after the measurements have stopped, empty rows are skipped by the integration; while accumulating, "
+            "no rows are skipped");
+    ap5.set_unit("%");
+    ap5.set_format("%6.2f");
+    info_accu_xyt_occupancy_attr->set_default_properties(ap5);
+    info_accu_xyt_occupancy_attr->SetReadCallback(this, &SurfaceConceptTDC::DiagnosticAttributeReadCallback);
+    this->add_attribute(info_accu_xyt_occupancy_attr);
 }
 
 void SurfaceConceptTDC::DevPropReadCallback(Tango::DeviceImpl *dev, Tango::Attribute &attr) {
@@ -1026,7 +1191,17 @@ void SurfaceConceptTDC::DiagnosticAttributeReadCallback(Tango::DeviceImpl *dev,
     else if (attrname.compare("Info_Accu_XYT_Formattedsize")==0) {
         attr.set_value(&info_accu_xyt_formattedsize_val);
     }
+    else if (attrname.compare("Info_Accu_XYT_Overflow_Voxels")==0) {
+        attr.set_value(&info_accu_xyt_overflow_voxels_val);
+    }
+    else if (attrname.compare("Info_Accu_XYT_Wrap_Risk")==0) {
+        attr.set_value(&info_accu_xyt_wrap_risk_val);
+    }
+    else if (attrname.compare("Info_Accu_XYT_Occupancy")==0) {
+        attr.set_value(&info_accu_xyt_occupancy_val);
+    }
     else if (attrname.compare("Counts_Per_Sec")==0) {
+        NoteViewRead(attrname);
         attr.set_value(&counts_per_sec_val);
     }
     else if (attrname.compare("Server_Databuffers_ReservedMem")==0) {
@@ -1098,6 +1273,7 @@ void SurfaceConceptTDC::SaveFilecounterWriteCallback(Tango::DeviceImpl* dev, Tan
 }
 
 void SurfaceConceptTDC::MeasurementCompleteCallback(int i) {
+    PipelineTelemetry::Scope callback_scope(telemetry, stage_callback);
     if (i!=1 && i!=2) { // don't print anything for code 1,2 (measurement time has passed or user has stopped)
 		//std::cout << "MeasurementCompleteCallback called with code " << i << std::endl;
         if (i==4) return; // "early notification" : hardware has finished measurement but there is still data to transfer
@@ -1119,6 +1295,20 @@ void SurfaceConceptTDC::MeasurementCompleteCallback(int i) {
     // 
     acquisition_running = false;
     acquisition_running_val = false;
+    
+    if (measurement_event_driven && i!=3) {
+        // the measurement covered exactly one live exposure, copy it before
+        // the next measurement starts and process the copy now
+        live_completion_timestamp_ns = Helper::get_nanosec();
+        if (SnapshotLiveBuffers())
+            live_preview_refresh_job.Request();
+    }
+
+    if (m_hist_map.at("Hist_Accu_XYT")->GetPipeActive()) {
+        // the sweep runs on the Accu lane and does not hold up the restart
+        accu_sweep_final_pending = true;
+        accu_sweep_job.Request();
+    }
 
     if (deferred_xyt_pipe_close_request) {
         deferred_xyt_pipe_close_request = false;
@@ -1158,6 +1348,7 @@ void SurfaceConceptTDC::MeasurementCompleteCallback(int i) {
         return;
     }
     if (user_acquisition_active || user_accumulation_active) {
+        ManageIdlePipes(); // pipes may only be opened or closed between measurements
         _acquisition_start();
     }
 }
@@ -1463,10 +1654,43 @@ void SurfaceConceptTDC::AddTDCStatisticsAttributes() {
     this->add_attribute(tdc_stat_summarized_attr);
     this->add_attribute(tdc_stat_max_raw_count_attr);
     this->add_attribute(tdc_stat_avg_raw_count_attr);
+    
+    if (bundle_format_val==NULL)
+        bundle_format_val = const_cast<Tango::DevString>(BUNDLE_FORMAT);
+    tdc_stat_snapshot_attr = new CustomAttr("TDC_Stat_Snapshot", Tango::DEV_ENCODED, Tango::READ, Tango::AssocWritNotSpec);
+    tdc_stat_snapshot_attr->SetReadCallback(this, &SurfaceConceptTDC::TDCStatHistoryReadCallback);
+    tdc_stat_snapshot_attr->set_change_event(true, false);
+    Tango::UserDefaultAttrProp ap10;
+    ap10.set_description("All TDC_Stat_* attributes of one measurement in one value of the format BDL1 "
+            "(see FrameCodec.h) with the number and time stamp of the measurement, pushed once per measurement");
+    tdc_stat_snapshot_attr->set_default_properties(ap10);
+    this->add_attribute(tdc_stat_snapshot_attr);
+    
+    tdc_stat_history_attr = new CustomImageAttr("TDC_Stat_History", Tango::DEV_DOUBLE, Tango::READ, tdc_stat_history_width, tdc_stat_history_size);
+    tdc_stat_history_attr->SetReadCallback(this, &SurfaceConceptTDC::TDCStatHistoryReadCallback);
+    Tango::UserDefaultAttrProp ap11;
+    ap11.set_description("TDC statistics of the last TDC_Stat_History_Length measurements, one row per measurement "
+            "(oldest first): time in seconds since the Unix epoch followed by the values of TDC_Stat_Summarized");
+    tdc_stat_history_attr->set_default_properties(ap11);
+    this->add_attribute(tdc_stat_history_attr);
+    
+    tdc_stat_history_length_attr = new CustomAttr("TDC_Stat_History_Length", Tango::DEV_LONG, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+    tdc_stat_history_length_attr->SetReadCallback(this, &SurfaceConceptTDC::TDCStatHistoryReadCallback);
+    tdc_stat_history_length_attr->SetWriteCallback(this, &SurfaceConceptTDC::TDCStatHistoryWriteCallback);
+    Tango::UserDefaultAttrProp ap12;
+    ap12.set_description("Number of measurements returned by TDC_Stat_History");
+    ap12.set_format("%6d");
+    ap12.set_min_value("1");
+    ap12.set_max_value(std::to_string(tdc_stat_history_size).c_str());
+    tdc_stat_history_length_attr->set_default_properties(ap12);
+    tdc_stat_history_length_attr->set_memorized();
+    tdc_stat_history_length_attr->set_memorized_init(true);
+    this->add_attribute(tdc_stat_history_length_attr);
 }
 
 void SurfaceConceptTDC::TDCStatisticsReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& attr) {
     std::string attrname = attr.get_name();
+    std::lock_guard<std::mutex> lock(tdc_stat_values_mutex);
     if (attrname.compare("TDC_Stat_Counters")==0) {
         attr.set_value(tdc_stat_counters_val, tdc_stat_counters_size);
     }
@@ -1497,84 +1721,137 @@ void SurfaceConceptTDC::TDCStatisticsReadCallback(Tango::DeviceImpl* dev, Tango:
 }
 
 void SurfaceConceptTDC::_read_tdc_statistics() {
+    // called from the measurement-complete callback: only copy the raw
+    // statistics into the history ring, the conversion and the change events
+    // follow on the Encode lane (PublishTDCStatistics)
     if (!tdc_statistics_active) return;
-    int result = 0;
-    if (m_TDC_id>=0) {
-		//result = ::sc_tdc_get_statistics2(m_TDC_id, &_tdc_statistics_sc); // deprecated
-		result = 0;
-		stat_pipe.GetStatistics(&_tdc_statistics_sc);
-	}
-    else
-        return;
-    if (result!=0) {
-        std::cout << "Error in SurfaceConceptTDC::_read_tdc_statistics():" << std::endl; 
-        std::cout << " sc_tdc_get_statistics2(...) returned error code" << std::endl;
-        Helper::cout_sc_err_message(result);
-        return;
-    }
-    // copy all values (int to Tango::DevLong conversion -> do it element-wise)
+    if (m_TDC_id<0) return;
+    {
+        std::lock_guard<std::mutex> lock(tdc_stat_ring_mutex);
+        TDCStatSnapshot& snap = tdc_stat_ring[tdc_stat_ring_count % tdc_stat_history_size];
+        stat_pipe.GetStatistics(&snap.stats);
+        snap.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        snap.seq = ++tdc_stat_ring_count;
+    }
+    if (!tdc_stat_publish_pending.exchange(true))
+        executor.Push(lane_encode, [this]{ this->PublishTDCStatistics(); });
+}
+
+void SurfaceConceptTDC::SummarizeTDCStatistics(const ::statistics_t& st, Tango::DevLong* summarized) {
+    summarized[0] = 0; // 0 and unused left value is good for bar-graph plotting
+    summarized[1] = st.events_found[0];
+    summarized[2] = 0;
+    summarized[3] = st.counts_read[0][0];
+    summarized[4] = st.counts_read[0][1]>0 ? st.counts_read[0][1] : st.counts_read[0][4];
+    summarized[5] = st.counts_read[0][2]>0 ? st.counts_read[0][2] : st.counts_read[0][8];
+    summarized[6] = st.counts_read[0][3]>0 ? st.counts_read[0][3] : st.counts_read[0][12];
+    summarized[7] = 0;
+    summarized[8] = 0;
+}
+
+void SurfaceConceptTDC::TDCStatValues(const ::statistics_t& st, TDCStatValueList& values) {
+    // all TDC_Stat_* attribute values of one measurement, in the order of
+    // the attributes (int to Tango::DevLong conversion -> element-wise)
+    values.clear();
+    std::vector<Tango::DevLong> v(tdc_stat_counters_size);
     for (int i = 0; i < tdc_stat_counters_size; i++)
-        tdc_stat_counters_val[i] = _tdc_statistics_sc.counters[i/16][i%16];
+        v[i] = st.counters[i/16][i%16];
+    values.push_back(std::make_pair("TDC_Stat_Counters", v));
+    v.resize(tdc_stat_counts_read_size);
     for (int i = 0; i < tdc_stat_counts_read_size; i++)
-        tdc_stat_counts_read_val[i] = _tdc_statistics_sc.counts_read[i/16][i%16];
-    for (int i = 0; i < tdc_stat_counts_received_size; i++)
-        tdc_stat_counts_received_val[i] = _tdc_statistics_sc.counts_received[i/16][i%16];
-    for (int i = 0; i < tdc_stat_events_found_size; i++)
-        tdc_stat_events_found_val[i] = _tdc_statistics_sc.events_found[i];
-    for (int i = 0; i < tdc_stat_events_in_roi_size; i++)
-        tdc_stat_events_in_roi_val[i] = _tdc_statistics_sc.events_in_roi[i];
-    for (int i = 0; i < tdc_stat_events_received_size; i++)
-        tdc_stat_events_received_val[i] = _tdc_statistics_sc.events_received[i];
-    // fill the summarized statistics spectrum
-    tdc_stat_summarized_val[0] = 0.0; // 0 and unused left value is good for bar-graph plotting
-    tdc_stat_summarized_val[1] = tdc_stat_events_found_val[0];
-    tdc_stat_summarized_val[2] = 0;
-    tdc_stat_summarized_val[3] = tdc_stat_counts_read_val[0];
-    if (tdc_stat_counts_read_val[1]>0)
-        tdc_stat_summarized_val[4] = tdc_stat_counts_read_val[1];
-    else
-        tdc_stat_summarized_val[4] = tdc_stat_counts_read_val[4];
-    if (tdc_stat_counts_read_val[2]>0)
-        tdc_stat_summarized_val[5] = tdc_stat_counts_read_val[2];
-    else
-        tdc_stat_summarized_val[5] = tdc_stat_counts_read_val[8];
-    if (tdc_stat_counts_read_val[3]>0)
-        tdc_stat_summarized_val[6] = tdc_stat_counts_read_val[3];
-    else 
-        tdc_stat_summarized_val[6] = tdc_stat_counts_read_val[12];
-    //tdc_stat_summarized_val[6] = tdc_stat_events_received_val[0];
-    //tdc_stat_summarized_val[7] = tdc_stat_events_in_roi_val[0];
-    tdc_stat_summarized_val[7] = 0.0;
-    tdc_stat_summarized_val[8] = 0.0;
+        v[i] = st.counts_read[i/16][i%16];
+    values.push_back(std::make_pair("TDC_Stat_Counts_Read", v));
     // ### calculate maximum and average #######################################
-    tdc_stat_max_raw_count_val = 0;
-    tdc_stat_avg_raw_count_val = 0;
+    Tango::DevLong max_raw_count = 0;
+    Tango::DevLong avg_raw_count = 0;
     Tango::DevLong avg_divisor = 0;
     for (std::size_t i=0; i<64; i++) {
-      if (tdc_stat_counts_read_val[i] > tdc_stat_max_raw_count_val)
-        tdc_stat_max_raw_count_val = tdc_stat_counts_read_val[i];
-      if (tdc_stat_counts_read_val[i] > 0) {
-        tdc_stat_avg_raw_count_val += tdc_stat_counts_read_val[i];
+      if (v[i] > max_raw_count)
+        max_raw_count = v[i];
+      if (v[i] > 0) {
+        avg_raw_count += v[i];
         avg_divisor++;
       }
     }
     if (avg_divisor > 0)
-      tdc_stat_avg_raw_count_val = tdc_stat_avg_raw_count_val / avg_divisor;
+      avg_raw_count = avg_raw_count / avg_divisor;
+    v.resize(tdc_stat_counts_received_size);
+    for (int i = 0; i < tdc_stat_counts_received_size; i++)
+        v[i] = st.counts_received[i/16][i%16];
+    values.push_back(std::make_pair("TDC_Stat_Counts_Received", v));
+    v.resize(tdc_stat_events_found_size);
+    for (int i = 0; i < tdc_stat_events_found_size; i++)
+        v[i] = st.events_found[i];
+    values.push_back(std::make_pair("TDC_Stat_Events_Found", v));
+    v.resize(tdc_stat_events_in_roi_size);
+    for (int i = 0; i < tdc_stat_events_in_roi_size; i++)
+        v[i] = st.events_in_roi[i];
+    values.push_back(std::make_pair("TDC_Stat_Events_In_Roi", v));
+    v.resize(tdc_stat_events_received_size);
+    for (int i = 0; i < tdc_stat_events_received_size; i++)
+        v[i] = st.events_received[i];
+    values.push_back(std::make_pair("TDC_Stat_Events_Received", v));
+    // fill the summarized statistics spectrum
+    v.resize(tdc_stat_summarized_size);
+    SummarizeTDCStatistics(st, v.data());
+    values.push_back(std::make_pair("TDC_Stat_Summarized", v));
+    values.push_back(std::make_pair("TDC_Stat_Max_Raw_Count", std::vector<Tango::DevLong>(1, max_raw_count)));
+    values.push_back(std::make_pair("TDC_Stat_Avg_Raw_Count", std::vector<Tango::DevLong>(1, avg_raw_count)));
+}
+
+void SurfaceConceptTDC::PublishTDCStatistics() {
+    // this function must be called only via the job pushed by _read_tdc_statistics
+    tdc_stat_publish_pending = false;
+    PipelineTelemetry::Scope stat_scope(telemetry, stage_tdc_stat);
+    // the Encode lane may run several publish jobs at once: they fill and
+    // push the shared buffers one after the other, each from its own copy
+    // of the newest measurement (taken in this order, so that an older one
+    // is never published after a newer one)
+    std::lock_guard<std::mutex> values_lock(tdc_stat_values_mutex);
+    ::statistics_t st;
+    {
+        std::lock_guard<std::mutex> lock(tdc_stat_ring_mutex);
+        if (tdc_stat_ring_count==0) return;
+        st = tdc_stat_ring[(tdc_stat_ring_count-1) % tdc_stat_history_size].stats;
+    }
+    // copy all values into the attribute buffers
+    TDCStatValueList values;
+    TDCStatValues(st, values);
+    const std::vector<Tango::DevLong*> bufs = {tdc_stat_counters_val, tdc_stat_counts_read_val,
+            tdc_stat_counts_received_val, tdc_stat_events_found_val, tdc_stat_events_in_roi_val,
+            tdc_stat_events_received_val, tdc_stat_summarized_val,
+            &tdc_stat_max_raw_count_val, &tdc_stat_avg_raw_count_val};
+    for (std::size_t i=0; i<bufs.size(); i++)
+        std::copy(values[i].second.begin(), values[i].second.end(), bufs[i]);
     // ### push change events ##################################################
+    // one consolidated event; the single attributes only for their subscribers
+    EncodedFramePtr snapshot = BuildTDCStatSnapshot();
     try {
-        //std::cout << "sending TDC statistics change events" << std::endl;
-        //long t1 = Helper::get_millisec();
-        push_change_event("TDC_Stat_Counters", tdc_stat_counters_val, tdc_stat_counters_size, 0);
-        push_change_event("TDC_Stat_Counts_Read", tdc_stat_counts_read_val, tdc_stat_counts_read_size, 0);
-        push_change_event("TDC_Stat_Counts_Received", tdc_stat_counts_received_val, tdc_stat_counts_received_size, 0);
-        push_change_event("TDC_Stat_Events_Found", tdc_stat_events_found_val, tdc_stat_events_found_size, 0);
-        push_change_event("TDC_Stat_Events_In_Roi", tdc_stat_events_in_roi_val, tdc_stat_events_in_roi_size, 0);
-        push_change_event("TDC_Stat_Events_Received", tdc_stat_events_received_val, tdc_stat_events_received_size, 0);
-        push_change_event("TDC_Stat_Summarized", tdc_stat_summarized_val, tdc_stat_summarized_size, 0);
-        push_change_event("TDC_Stat_Max_Raw_Count", &tdc_stat_max_raw_count_val, 1, 0);
-        push_change_event("TDC_Stat_Avg_Raw_Count", &tdc_stat_avg_raw_count_val, 1, 0);
-        //long t2 = Helper::get_millisec();
-        //std::cout << "sending TDC statistics took " << t2-t1 << " ms" << std::endl;
+        push_change_event("TDC_Stat_Snapshot", &bundle_format_val,
+                const_cast<Tango::DevUChar*>(snapshot->data.data()), snapshot->data.size());
+        Tango::MultiAttribute* attrs = get_device_attr();
+        auto subscribed = [attrs](const char* name) {
+            return attrs->get_attr_by_name(name).change_event_subscribed();
+        };
+        if (subscribed("TDC_Stat_Counters"))
+            push_change_event("TDC_Stat_Counters", tdc_stat_counters_val, tdc_stat_counters_size, 0);
+        if (subscribed("TDC_Stat_Counts_Read"))
+            push_change_event("TDC_Stat_Counts_Read", tdc_stat_counts_read_val, tdc_stat_counts_read_size, 0);
+        if (subscribed("TDC_Stat_Counts_Received"))
+            push_change_event("TDC_Stat_Counts_Received", tdc_stat_counts_received_val, tdc_stat_counts_received_size, 0);
+        if (subscribed("TDC_Stat_Events_Found"))
+            push_change_event("TDC_Stat_Events_Found", tdc_stat_events_found_val, tdc_stat_events_found_size, 0);
+        if (subscribed("TDC_Stat_Events_In_Roi"))
+            push_change_event("TDC_Stat_Events_In_Roi", tdc_stat_events_in_roi_val, tdc_stat_events_in_roi_size, 0);
+        if (subscribed("TDC_Stat_Events_Received"))
+            push_change_event("TDC_Stat_Events_Received", tdc_stat_events_received_val, tdc_stat_events_received_size, 0);
+        if (subscribed("TDC_Stat_Summarized"))
+            push_change_event("TDC_Stat_Summarized", tdc_stat_summarized_val, tdc_stat_summarized_size, 0);
+        if (subscribed("TDC_Stat_Max_Raw_Count"))
+            push_change_event("TDC_Stat_Max_Raw_Count", &tdc_stat_max_raw_count_val, 1, 0);
+        if (subscribed("TDC_Stat_Avg_Raw_Count"))
+            push_change_event("TDC_Stat_Avg_Raw_Count", &tdc_stat_avg_raw_count_val, 1, 0);
     }
     catch (Tango::DevFailed e) {
         std::cout << "Tango exception while pushing change events" << std::endl;
@@ -1588,7 +1865,69 @@ void SurfaceConceptTDC::_read_tdc_statistics() {
     
 }
 
+SurfaceConceptTDC::EncodedFramePtr SurfaceConceptTDC::BuildTDCStatSnapshot() {
+    // packs the newest measurement of the ring, not the attribute buffers
+    // which PublishTDCStatistics may be rewriting
+    std::shared_ptr<EncodedFrame> snapshot = std::make_shared<EncodedFrame>();
+    TDCStatSnapshot snap;
+    {
+        std::lock_guard<std::mutex> lock(tdc_stat_ring_mutex);
+        if (tdc_stat_ring_count>0)
+            snap = tdc_stat_ring[(tdc_stat_ring_count-1) % tdc_stat_history_size];
+    }
+    snapshot->seq = snap.seq;
+    BundleBegin(snapshot->data, snap.seq, snap.timestamp_ms);
+    if (snap.seq==0)
+        return snapshot; // no measurement yet
+    TDCStatValueList values;
+    TDCStatValues(snap.stats, values);
+    for (auto& v : values)
+        BundleAddInt32(snapshot->data, v.first, v.second.data(), v.second.size(), 0, 0, false);
+    return snapshot;
+}
+
+void SurfaceConceptTDC::TDCStatHistoryReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& attr) {
+    std::string attrname = attr.get_name();
+    if (attrname.compare("TDC_Stat_Snapshot")==0) {
+        tdc_stat_read_snapshot = BuildTDCStatSnapshot(); // keeps the data valid until the next read
+        attr.set_value(&bundle_format_val, const_cast<Tango::DevUChar*>(tdc_stat_read_snapshot->data.data()),
+                tdc_stat_read_snapshot->data.size());
+    }
+    else if (attrname.compare("TDC_Stat_History")==0) {
+        // one row per measurement, oldest first: time in s since the Unix epoch, TDC_Stat_Summarized
+        tdc_stat_history_val.clear();
+        long rows = 0;
+        {
+            std::lock_guard<std::mutex> lock(tdc_stat_ring_mutex);
+            unsigned long long n = std::min(tdc_stat_ring_count, (unsigned long long) tdc_stat_history_length_val);
+            n = std::min(n, (unsigned long long) tdc_stat_history_size);
+            Tango::DevLong summarized[tdc_stat_summarized_size];
+            for (unsigned long long i = tdc_stat_ring_count-n; i<tdc_stat_ring_count; i++) {
+                const TDCStatSnapshot& snap = tdc_stat_ring[i % tdc_stat_history_size];
+                SummarizeTDCStatistics(snap.stats, summarized);
+                tdc_stat_history_val.push_back(snap.timestamp_ms*1e-3);
+                tdc_stat_history_val.insert(tdc_stat_history_val.end(), summarized, summarized+tdc_stat_summarized_size);
+                rows++;
+            }
+        }
+        if (rows==0)
+            tdc_stat_history_val.assign(tdc_stat_history_width, 0.0);
+        attr.set_value(tdc_stat_history_val.data(), tdc_stat_history_width, rows>0 ? rows : 1);
+    }
+    else if (attrname.compare("TDC_Stat_History_Length")==0) {
+        attr.set_value(&tdc_stat_history_length_val);
+    }
+}
+
+void SurfaceConceptTDC::TDCStatHistoryWriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& attr) {
+    std::string attrname = attr.get_name();
+    if (attrname.compare("TDC_Stat_History_Length")==0) {
+        attr.get_write_value(tdc_stat_history_length_val);
+    }
+}
+
 void SurfaceConceptTDC::_zero_tdc_statistics() {
+    std::lock_guard<std::mutex> lock(tdc_stat_values_mutex);
     for (int i = 0; i < tdc_stat_counters_size; i++)
         tdc_stat_counters_val[i] = 0;
     for (int i = 0; i < tdc_stat_counts_read_size; i++)
@@ -1607,57 +1946,60 @@ void SurfaceConceptTDC::_zero_tdc_statistics() {
     tdc_stat_max_raw_count_val = 0;
 }
 
-void SurfaceConceptTDC::Hist_Full_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    //std::cout << "Hist_Full_T_ReadCallback(...) got called" << std::endl;
-    GeneralHistogram* h = m_hist_map.at("Hist_Full_T");
-    Tango::DevLong* tbuf = h->GetTangoBuffer();
-    if (tbuf!=NULL) {
-        //std::cout << "Hist_Full_T_ReadCallback(...) sent real data" << std::endl;
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    }
-    else {
-        //std::cout << "Hist_Full_T_ReadCallback(...) sent dummy buffer" << std::endl;
-        Tango::DevLong dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
+Tango::DevLong* SurfaceConceptTDC::FrameData(const TangoFramePtr& frame) {
+    // Tango only reads through the pointer, the frame itself stays immutable
+    return const_cast<Tango::DevLong*>(frame->data.data());
+}
+
+void SurfaceConceptTDC::SetAttrFrameValue(Tango::Attribute& att, TangoFramePtr frame, bool image) {
+    static Tango::DevLong dummybuf[4] = {0,0,0,0};
+    if (!frame || frame->data.empty()) {
+        att.set_value(dummybuf, 2, image?2:0);
+        return;
     }
+    // set_value does not copy; the frame is pinned until the next read of
+    // this attribute so that Tango can marshal it after the callback returned
+    {
+        std::lock_guard<std::mutex> lock(read_frames_mutex);
+        read_frames[att.get_name()] = frame;
+    }
+    if (image)
+        att.set_value(FrameData(frame), frame->width, frame->height);
+    else
+        att.set_value(FrameData(frame), frame->width);
 }
 
-void SurfaceConceptTDC::Hist_Full_Accu_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_Full_T");
-    Tango::DevLong* tbuf = h->GetTangoAccuBuffer();
-    if (tbuf!=NULL) {
-        //std::cout << "Hist_Full_T_ReadCallback(...) sent real data" << std::endl;
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    }
-    else {
-        //std::cout << "Hist_Full_T_ReadCallback(...) sent dummy buffer" << std::endl;
-        Tango::DevLong dummybuf[2] = {0,0};
+void SurfaceConceptTDC::SetAttrTAxisValue(Tango::Attribute& att, TangoFramePtr frame) {
+    static Tango::DevDouble dummybuf[2] = {0,0};
+    if (!frame || frame->taxis.empty()) {
         att.set_value(dummybuf, 2, 0);
+        return;
     }
+    {
+        std::lock_guard<std::mutex> lock(read_frames_mutex);
+        read_frames[att.get_name()] = frame;
+    }
+    att.set_value(const_cast<Tango::DevDouble*>(frame->taxis.data()), frame->taxis.size());
+}
+
+void SurfaceConceptTDC::Hist_Full_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+    NoteViewRead(att.get_name());
+    SetAttrFrameValue(att, m_hist_map.at("Hist_Full_T")->GetTangoFrame(), false);
+}
+
+void SurfaceConceptTDC::Hist_Full_Accu_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+    NoteViewRead(att.get_name());
+    SetAttrFrameValue(att, m_hist_map.at("Hist_Full_T")->GetTangoAccuFrame(), false);
 }
 
 void SurfaceConceptTDC::Hist_Live_User_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_User_T");
-    Tango::DevLong* tbuf = h->GetTangoBuffer();
-    if (tbuf!=NULL) {
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    }
-    else {
-        Tango::DevLong dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrFrameValue(att, m_hist_map.at("Hist_User_T")->GetTangoFrame(), false);
 }
 
 void SurfaceConceptTDC::Hist_Accu_User_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_User_T");
-    Tango::DevLong* tbuf = h->GetTangoAccuBuffer();
-    if (tbuf!=NULL) {
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    }
-    else {
-        Tango::DevLong dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrFrameValue(att, m_hist_map.at("Hist_User_T")->GetTangoAccuFrame(), false);
 }
 
 void SurfaceConceptTDC::HistUserTAux_ReadCallback(Tango::DeviceImpl*, Tango::Attribute& att) {
@@ -1693,74 +2035,34 @@ void SurfaceConceptTDC::HistUserTAux_WriteCallback(Tango::DeviceImpl*, Tango::WA
 
 
 void SurfaceConceptTDC::Hist_Live_T_ReadCallback(Tango::DeviceImpl*, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_Live_T");
-    Tango::DevLong* tbuf = h->GetTangoBuffer();
-    if (tbuf!=NULL) {
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    }
-    else {
-        Tango::DevLong dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrFrameValue(att, m_hist_map.at("Hist_Live_T")->GetTangoFrame(), false);
 }
 
 
 void SurfaceConceptTDC::Hist_Accu_T_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_Accu_T");
-    Tango::DevLong* tbuf = h->GetTangoBuffer();
-    if (tbuf!=NULL) {
-        //std::cout << "Hist_Full_T_ReadCallback(...) sent real data" << std::endl;
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    }
-    else {
-        //std::cout << "Hist_Full_T_ReadCallback(...) sent dummy buffer" << std::endl;
-        Tango::DevLong dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrFrameValue(att, m_hist_map.at("Hist_Accu_T")->GetTangoFrame(), false);
 }
 
 void SurfaceConceptTDC::Hist_Full_TAxis_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_Full_T");
-    Tango::DevDouble* tbuf = h->getTAxis();
-    if (tbuf!=NULL)
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    else {
-        Tango::DevDouble dummybuf[2] = {0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrTAxisValue(att, m_hist_map.at("Hist_Full_T")->GetTangoFrame());
 }
 
 void SurfaceConceptTDC::Hist_Accu_TAxis_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_Accu_T");
-    Tango::DevDouble* tbuf = h->getTAxis();
-    if (tbuf!=NULL)
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    else {
-        Tango::DevDouble dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrTAxisValue(att, m_hist_map.at("Hist_Accu_T")->GetTangoFrame());
 }
 
 void SurfaceConceptTDC::Hist_Live_TAxis_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_Live_T");
-    Tango::DevDouble* tbuf = h->getTAxis();
-    if (tbuf!=NULL)
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    else {
-        Tango::DevDouble dummybuf[2] = {0,0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrTAxisValue(att, m_hist_map.at("Hist_Live_T")->GetTangoFrame());
 }
 
 void SurfaceConceptTDC::Hist_User_Taxis_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
-    GeneralHistogram* h = m_hist_map.at("Hist_User_T");
-    Tango::DevDouble* tbuf = h->getTAxis();
-    if (tbuf!=NULL)
-        att.set_value(tbuf, h->GetTangoBufferDataWidth());
-    else {
-        Tango::DevDouble dummybuf[2] = {0};
-        att.set_value(dummybuf, 2, 0);
-    }
+    NoteViewRead(att.get_name());
+    SetAttrTAxisValue(att, m_hist_map.at("Hist_User_T")->GetTangoFrame());
 }
 
 void SurfaceConceptTDC::AddHistUserTAuxAttributes() {
@@ -0,0 +1,331 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Compressed (DevEncoded) variants of the histogram views for clients behind
+// slow links. Frames are encoded with the DZR1 codec (see FrameCodec.h) on
+// the Encode lane of the executor; an encoded frame is cached until the
+// histogram publishes a new frame, so pushes and reads share one encoding.
+// The *_Tiles views push TIL1 updates that only contain the tiles changed
+// since the previous push; reading them returns a keyframe.
+
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "FrameCodec.h"
+#include "Helper.h"
+
+namespace SurfaceConceptTDC_ns {
+
+    struct EncodedViewDef {
+        const char* name;
+        const char* histname;
+        bool        accu;
+        bool        spectrum;  // only exists if the Tango live preview is active
+        bool        tiles;
+        const char* description;
+    };
+    
+    static const EncodedViewDef encoded_view_defs[] = {
+        {"Hist_Live_XY_Encoded",     "Hist_Live_XY", false, false, false, "Hist_Live_XY"},
+        {"Hist_Live_XT_Encoded",     "Hist_Live_XT", false, false, false, "Hist_Live_XT"},
+        {"Hist_Live_YT_Encoded",     "Hist_Live_YT", false, false, false, "Hist_Live_YT"},
+        {"Hist_Accu_XY_Encoded",     "Hist_Accu_XY", false, false, false, "Hist_Accu_XY"},
+        {"Hist_Accu_XT_Encoded",     "Hist_Accu_XT", false, false, false, "Hist_Accu_XT"},
+        {"Hist_Accu_YT_Encoded",     "Hist_Accu_YT", false, false, false, "Hist_Accu_YT"},
+        {"Hist_Full_T_Encoded",      "Hist_Full_T",  false, true,  false, "Hist_Full_T"},
+        {"Hist_Full_Accu_T_Encoded", "Hist_Full_T",  true,  true,  false, "Hist_Full_Accu_T"},
+        {"Hist_Live_T_Encoded",      "Hist_Live_T",  false, true,  false, "Hist_Live_T"},
+        {"Hist_Accu_T_Encoded",      "Hist_Accu_T",  false, true,  false, "Hist_Accu_T"},
+        {"Hist_Live_User_T_Encoded", "Hist_User_T",  false, true,  false, "Hist_Live_User_T"},
+        {"Hist_Accu_User_T_Encoded", "Hist_User_T",  true,  true,  false, "Hist_Accu_User_T"},
+        {"Hist_Live_XY_Tiles",       "Hist_Live_XY", false, false, true,  "Hist_Live_XY"},
+        {"Hist_Live_XT_Tiles",       "Hist_Live_XT", false, false, true,  "Hist_Live_XT"},
+        {"Hist_Live_YT_Tiles",       "Hist_Live_YT", false, false, true,  "Hist_Live_YT"},
+        {"Hist_Accu_XY_Tiles",       "Hist_Accu_XY", false, false, true,  "Hist_Accu_XY"},
+        {"Hist_Accu_XT_Tiles",       "Hist_Accu_XT", false, false, true,  "Hist_Accu_XT"},
+        {"Hist_Accu_YT_Tiles",       "Hist_Accu_YT", false, false, true,  "Hist_Accu_YT"}
+    };
+
+    void SurfaceConceptTDC::AddEncodedAttributes() {
+        encoded_format_val = const_cast<Tango::DevString>(DZR_FORMAT);
+        tile_format_val = const_cast<Tango::DevString>(TILE_FORMAT);
+        for (const EncodedViewDef& d : encoded_view_defs) {
+            if (d.spectrum && !livePreviewModeTangoActive)
+                continue;
+            CustomAttr* attr = new CustomAttr(d.name, Tango::DEV_ENCODED, Tango::READ, Tango::AssocWritNotSpec);
+            Tango::UserDefaultAttrProp ap;
+            if (d.tiles)
+                ap.set_description(std::string(d.description)+" as tile updates in the format "+TILE_FORMAT
+                        +": change events contain the tiles changed since the previous event, "
+                        "reading returns a keyframe with all tiles (see FrameCodec.h)");
+            else
+                ap.set_description(std::string(d.description)+" compressed losslessly in the format "+DZR_FORMAT
+                        +" (delta and zero run coding, see FrameCodec.h)");
+            attr->set_default_properties(ap);
+            attr->set_change_event(true, false); // we will push change events ( so no polling is required )
+            attr->SetReadCallback(this, &SurfaceConceptTDC::Encoded_ReadCallback);
+            this->add_attribute(attr);
+            EncodedView& v = encoded_views[d.name];
+            v.histname = d.histname;
+            v.accu = d.accu;
+            v.tiles = d.tiles;
+        }
+        
+        Tango::UserDefaultAttrProp ap1;
+        server_encode_ratio_attr = new CustomAttr("Server_Encode_Ratio", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap1.set_description("Ratio of raw to compressed bytes of all frames and tile updates encoded for the "
+                "*_Encoded and *_Tiles attributes");
+        ap1.set_format("%8.2f");
+        server_encode_ratio_attr->set_default_properties(ap1);
+        server_encode_ratio_attr->SetReadCallback(this, &SurfaceConceptTDC::Encoded_ReadCallback);
+        this->add_attribute(server_encode_ratio_attr);
+        
+        Tango::UserDefaultAttrProp ap2;
+        ap2.set_unit("ms");
+        ap2.set_format("%8.3f");
+        server_encode_time_attr = new CustomAttr("Server_Encode_Time", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap2.set_description("Time needed to encode one frame (moving average)");
+        server_encode_time_attr->set_default_properties(ap2);
+        server_encode_time_attr->SetReadCallback(this, &SurfaceConceptTDC::Encoded_ReadCallback);
+        this->add_attribute(server_encode_time_attr);
+        server_encode_time_max_attr = new CustomAttr("Server_Encode_Time_Max", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap2.set_description("Maximum time needed to encode one frame");
+        server_encode_time_max_attr->set_default_properties(ap2);
+        server_encode_time_max_attr->SetReadCallback(this, &SurfaceConceptTDC::Encoded_ReadCallback);
+        this->add_attribute(server_encode_time_max_attr);
+        
+        tiles_size_attr = new CustomAttr("Tiles_Size", Tango::DEV_LONG, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap3;
+        ap3.set_description("Edge length of the square tiles of the *_Tiles attributes in pixels");
+        ap3.set_format("%6d");
+        ap3.set_min_value("8");
+        tiles_size_attr->set_default_properties(ap3);
+        tiles_size_attr->set_memorized();
+        tiles_size_attr->set_memorized_init(true);
+        tiles_size_attr->SetReadCallback(this, &SurfaceConceptTDC::Encoded_ReadCallback);
+        tiles_size_attr->SetWriteCallback(this, &SurfaceConceptTDC::Encoded_WriteCallback);
+        this->add_attribute(tiles_size_attr);
+        
+        server_tiles_changed_attr = new CustomAttr("Server_Tiles_Changed", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap4;
+        ap4.set_description("Fraction of the tiles contained in the last pushed tile update");
+        ap4.set_unit("%");
+        ap4.set_format("%6.2f");
+        server_tiles_changed_attr->set_default_properties(ap4);
+        server_tiles_changed_attr->SetReadCallback(this, &SurfaceConceptTDC::Encoded_ReadCallback);
+        this->add_attribute(server_tiles_changed_attr);
+    }
+
+    void SurfaceConceptTDC::NoteEncodeStats(std::size_t raw_bytes, std::size_t out_bytes, double ms) {
+        encode_raw_bytes += raw_bytes;
+        encode_out_bytes += out_bytes;
+        server_encode_ratio_val = encode_out_bytes>0 ? (double) encode_raw_bytes/encode_out_bytes : 0.0;
+        server_encode_time_val = server_encode_time_val>0.0 ? 0.9*server_encode_time_val+0.1*ms : ms;
+        if (ms>server_encode_time_max_val)
+            server_encode_time_max_val = ms;
+    }
+
+    SurfaceConceptTDC::EncodedFramePtr SurfaceConceptTDC::EncodeView(const std::string& attrname) {
+        std::string histname;
+        bool accu = false;
+        bool tiles = false;
+        EncodedFramePtr cached;
+        {
+            std::lock_guard<std::mutex> lock(encoded_views_mutex);
+            auto it = encoded_views.find(attrname);
+            if (it==encoded_views.end())
+                return EncodedFramePtr();
+            histname = it->second.histname;
+            accu = it->second.accu;
+            tiles = it->second.tiles;
+            cached = it->second.frame;
+        }
+        GeneralHistogram* h = m_hist_map.at(histname);
+        TangoFramePtr frame = accu ? h->GetTangoAccuFrame() : h->GetTangoFrame();
+        if (!frame || (tiles && frame->data.empty()))
+            return cached;
+        if (cached && cached->seq==frame->seq)
+            return cached;
+        long long start = Helper::get_nanosec();
+        std::shared_ptr<EncodedFrame> enc = std::make_shared<EncodedFrame>();
+        enc->seq = frame->seq;
+        int ret = 0;
+        if (tiles)
+            ret = EncodeTileDelta(frame->data.data(), NULL, frame->width, frame->height, tiles_size_val,
+                    frame->seq, 0, enc->data)<0 ? -1 : 0;
+        else
+            ret = EncodeDeltaZeroRun(frame->data.data(), frame->width, frame->height, enc->data);
+        if (ret!=0) {
+            std::cout << "ERROR: SurfaceConceptTDC::EncodeView:" << std::endl;
+            std::cout << " failed to encode " << attrname << std::endl;
+            return cached;
+        }
+        long long duration = Helper::get_nanosec()-start;
+        telemetry.Record(stage_encode, duration);
+        double ms = duration*1e-6;
+        std::lock_guard<std::mutex> lock(encoded_views_mutex);
+        EncodedView& v = encoded_views[attrname];
+        if (!v.frame || v.frame->seq!=enc->seq) {
+            v.frame = enc;
+            NoteEncodeStats(frame->data.size()*sizeof(Tango::DevLong), enc->data.size(), ms);
+        }
+        return v.frame;
+    }
+
+    SurfaceConceptTDC::EncodedFramePtr SurfaceConceptTDC::EncodeTileUpdate(const std::string& attrname) {
+        // only called from the encode job of the view (one at a time per view)
+        std::string histname;
+        bool accu = false;
+        TangoFramePtr base;
+        {
+            std::lock_guard<std::mutex> lock(encoded_views_mutex);
+            EncodedView& v = encoded_views[attrname];
+            histname = v.histname;
+            accu = v.accu;
+            base = v.base;
+        }
+        GeneralHistogram* h = m_hist_map.at(histname);
+        TangoFramePtr frame = accu ? h->GetTangoAccuFrame() : h->GetTangoFrame();
+        if (!frame || frame->data.empty() || (base && base->seq==frame->seq))
+            return EncodedFramePtr();
+        if (!base || base->width!=frame->width || base->height!=frame->height) {
+            // no previous frame of this size: the update is a keyframe
+            EncodedFramePtr key = EncodeView(attrname);
+            if (!key || key->seq!=frame->seq)
+                return EncodedFramePtr();
+            std::lock_guard<std::mutex> lock(encoded_views_mutex);
+            encoded_views[attrname].base = frame;
+            server_tiles_changed_val = 100.0;
+            return key;
+        }
+        long long start = Helper::get_nanosec();
+        std::shared_ptr<EncodedFrame> enc = std::make_shared<EncodedFrame>();
+        enc->seq = frame->seq;
+        long tile = tiles_size_val;
+        long ntiles = EncodeTileDelta(frame->data.data(), base->data.data(), frame->width, frame->height,
+                tile, frame->seq, base->seq, enc->data);
+        if (ntiles<0) {
+            std::cout << "ERROR: SurfaceConceptTDC::EncodeTileUpdate:" << std::endl;
+            std::cout << " failed to encode " << attrname << std::endl;
+            return EncodedFramePtr();
+        }
+        long long duration = Helper::get_nanosec()-start;
+        telemetry.Record(stage_encode, duration);
+        double ms = duration*1e-6;
+        long total = ((frame->width+tile-1)/tile) * ((frame->height+tile-1)/tile);
+        std::lock_guard<std::mutex> lock(encoded_views_mutex);
+        encoded_views[attrname].base = frame;
+        server_tiles_changed_val = total>0 ? 100.0*ntiles/total : 0.0;
+        NoteEncodeStats(frame->data.size()*sizeof(Tango::DevLong), enc->data.size(), ms);
+        return enc;
+    }
+
+    void SurfaceConceptTDC::PushEncodedViews(const std::string& histname, bool accu) {
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(encoded_views_mutex);
+            for (auto& v : encoded_views)
+                if (v.second.histname.compare(histname)==0 && v.second.accu==accu && !v.second.pending)
+                    names.push_back(v.first);
+        }
+        for (const std::string& name : names) {
+            if (!IsViewConsumed(name))
+                continue;
+            bool tiles = false;
+            {
+                std::lock_guard<std::mutex> lock(encoded_views_mutex);
+                EncodedView& v = encoded_views[name];
+                v.pending = true; // later frames are picked up by the queued job
+                tiles = v.tiles;
+            }
+            executor.Push(lane_encode, [this, name, tiles] {
+                {
+                    std::lock_guard<std::mutex> lock(encoded_views_mutex);
+                    encoded_views[name].pending = false;
+                }
+                EncodedFramePtr enc = tiles ? EncodeTileUpdate(name) : EncodeView(name);
+                if (!enc)
+                    return;
+                {
+                    std::lock_guard<std::mutex> lock(encoded_views_mutex);
+                    EncodedView& v = encoded_views[name];
+                    if (v.pushed_seq==enc->seq)
+                        return; // unchanged since the last push (e.g. accumulation paused)
+                    v.pushed_seq = enc->seq;
+                }
+                try {
+                    push_change_event(name, tiles ? &tile_format_val : &encoded_format_val,
+                            const_cast<Tango::DevUChar*>(enc->data.data()), enc->data.size());
+                }
+                catch (Tango::DevFailed& e) {
+                    std::cout << "DevFailed exception occured in PushEncodedViews(...)" << std::endl;
+                    Helper::cout_tango_devfailed_exception(e);
+                }
+            });
+        }
+    }
+
+    void SurfaceConceptTDC::Encoded_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Server_Encode_Ratio")==0) {
+            att.set_value(&server_encode_ratio_val);
+        }
+        else if (attrname.compare("Server_Encode_Time")==0) {
+            att.set_value(&server_encode_time_val);
+        }
+        else if (attrname.compare("Server_Encode_Time_Max")==0) {
+            att.set_value(&server_encode_time_max_val);
+        }
+        else if (attrname.compare("Tiles_Size")==0) {
+            att.set_value(&tiles_size_val);
+        }
+        else if (attrname.compare("Server_Tiles_Changed")==0) {
+            att.set_value(&server_tiles_changed_val);
+        }
+        else {
+            NoteViewRead(attrname);
+            EncodedFramePtr enc = EncodeView(attrname); // a keyframe for tile views
+            static Tango::DevUChar empty = 0;
+            std::lock_guard<std::mutex> lock(encoded_views_mutex);
+            Tango::DevString* format = encoded_views[attrname].tiles ? &tile_format_val : &encoded_format_val;
+            read_encoded[attrname] = enc; // keeps the data valid until the next read
+            if (enc)
+                att.set_value(format, const_cast<Tango::DevUChar*>(enc->data.data()), enc->data.size());
+            else
+                att.set_value(format, &empty, 0);
+        }
+    }
+
+    void SurfaceConceptTDC::Encoded_WriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Tiles_Size")==0) {
+            att.get_write_value(tiles_size_val);
+            // cached keyframes have the old tile size; updates carry their tile size
+            std::lock_guard<std::mutex> lock(encoded_views_mutex);
+            for (auto& v : encoded_views)
+                if (v.second.tiles)
+                    v.second.frame.reset();
+        }
+    }
+
+} // namespace
@@ -87,15 +87,8 @@ namespace SurfaceConceptTDC_ns {
         std::string name = attr.get_name();
         GeneralHistogram* h = NULL;
         h = m_hist_map.at(name);
-        Tango::DevLong* tbuf = h->GetTangoBuffer();
-        if (tbuf!=NULL) {
-            attr.set_value(tbuf, h->GetTangoBufferDataWidth(), h->GetTangoBufferDataHeight());
-        }
-        else {
-            //std::cout << "sending dummy buffer for attribute " << name << std::endl;
-            Tango::DevLong dummybuf[4] = {0,0,0,0};
-            attr.set_value(dummybuf, 2, 2);
-        }
+        NoteViewRead(name);
+        SetAttrFrameValue(attr, h->GetTangoFrame(), true);
     }
 
 }
\ No newline at end of file
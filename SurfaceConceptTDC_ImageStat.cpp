@@ -48,6 +48,7 @@ namespace SurfaceConceptTDC_ns {
     }
     
     void SurfaceConceptTDC::ImageStat_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        NoteViewRead(att.get_name());
         att.set_value(&(imagestat_vals[att.get_name()]));
     }
 
@@ -0,0 +1,389 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Memory management of the data buffers: configuration of the shared buffer
+// pool (see BufferPool.h) from the BufferPool and LargeBufferPolicy device
+// properties, the periodic trimming of idle pool buffers, the memory budget
+// with the admission control of histogram configurations, the out-of-core
+// accumulation (OutOfCoreAccumulation property) and the memory attributes
+
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "Helper.h"
+#include "BufferPool.h"
+#include "MappedFileBuffer.h"
+#include <fstream>
+#include <unistd.h>
+
+namespace SurfaceConceptTDC_ns {
+
+    void SurfaceConceptTDC::SetupBufferPool() {
+        // parse bufferPoolConfig, e.g. "Prefault:false,TrimIdleMs:30000,BudgetMB:0"
+        bool prefault = false;
+        long trim_idle_ms = 30000;
+        long budget_mb = 0;
+        for (std::string entry : Helper::split(bufferPoolConfig, ',')) {
+            std::vector<std::string> kv = Helper::split(entry, ':');
+            if (kv.size()!=2) {
+                if (Helper::trimmed(entry).size()>0)
+                    std::cout << "BufferPool: ignoring invalid entry " << entry << std::endl;
+                continue;
+            }
+            std::string key = Helper::trimmed(kv[0]);
+            std::string value = Helper::trimmed(kv[1]);
+            if (key.compare("Prefault")==0 && (value.compare("true")==0 || value.compare("false")==0))
+                prefault = value.compare("true")==0;
+            else if (key.compare("TrimIdleMs")==0 || key.compare("BudgetMB")==0) {
+                try {
+                    long v = std::stol(value);
+                    if (key.compare("TrimIdleMs")==0)
+                        trim_idle_ms = v;
+                    else
+                        budget_mb = v<0 ? 0 : v;
+                }
+                catch (std::exception& e) {
+                    std::cout << "BufferPool: ignoring invalid entry " << entry << std::endl;
+                }
+            }
+            else
+                std::cout << "BufferPool: ignoring invalid entry " << entry << std::endl;
+        }
+        BufferPool::Shared().SetPrefault(prefault);
+        buffer_pool_trim_idle_ms = trim_idle_ms; // <=0: never trim
+        memory_budget_bytes = ((long long) budget_mb)*1048576; // 0: no budget
+        SetupLargeBufferPolicy();
+    }
+
+    void SurfaceConceptTDC::SetupLargeBufferPolicy() {
+        // parse largeBufferPolicy, e.g.
+        // "MinSizeMB:256,HugePages:transparent,Numa:interleave,NumaNodes:local,PrefaultThreads:4"
+        BufferPool::LargePolicy policy;
+        std::string nodes("all");
+        for (std::string entry : Helper::split(largeBufferPolicy, ',')) {
+            std::vector<std::string> kv = Helper::split(entry, ':');
+            if (kv.size()!=2) {
+                if (Helper::trimmed(entry).size()>0)
+                    std::cout << "LargeBufferPolicy: ignoring invalid entry " << entry << std::endl;
+                continue;
+            }
+            std::string key = Helper::trimmed(kv[0]);
+            std::string value = Helper::trimmed(kv[1]);
+            bool valid = true;
+            if (key.compare("HugePages")==0) {
+                if (value.compare("none")==0) policy.hugepages = BufferPool::HUGEPAGES_NONE;
+                else if (value.compare("transparent")==0) policy.hugepages = BufferPool::HUGEPAGES_TRANSPARENT;
+                else if (value.compare("explicit")==0) policy.hugepages = BufferPool::HUGEPAGES_EXPLICIT;
+                else valid = false;
+            }
+            else if (key.compare("Numa")==0) {
+                if (value.compare("none")==0) policy.numa = BufferPool::NUMA_NONE;
+                else if (value.compare("bind")==0) policy.numa = BufferPool::NUMA_BIND;
+                else if (value.compare("interleave")==0) policy.numa = BufferPool::NUMA_INTERLEAVE;
+                else valid = false;
+            }
+            else if (key.compare("NumaNodes")==0) {
+                nodes = value; // all, local or a list like 0-1 or 0+2
+                valid = value.compare("all")==0 || value.compare("local")==0
+                        || !BufferPool::ParseNodeList(value).empty();
+            }
+            else if (key.compare("MinSizeMB")==0 || key.compare("PrefaultThreads")==0) {
+                long v = -1;
+                try {
+                    v = std::stol(value);
+                }
+                catch (std::exception& e) {
+                    v = -1;
+                }
+                if (key.compare("MinSizeMB")==0 && v>=0)
+                    policy.min_bytes = v*1048576;
+                else if (key.compare("PrefaultThreads")==0 && v>=0 && v<=256)
+                    policy.prefault_threads = (int) v;
+                else valid = false;
+            }
+            else valid = false;
+            if (!valid)
+                std::cout << "LargeBufferPolicy: ignoring invalid entry " << entry << std::endl;
+        }
+        if (nodes.compare("local")==0)
+            policy.numa_nodes = BufferPool::LocalNumaNodes();
+        else if (nodes.compare("all")!=0)
+            policy.numa_nodes = BufferPool::ParseNodeList(nodes);
+        BufferPool::Shared().SetLargePolicy(policy);
+    }
+
+    void SurfaceConceptTDC::SetupOutOfCoreAccumulation() {
+        // parse outOfCoreAccumulation, e.g. "Directory:/nvme/sctdc,ChunkMB:64,SaveRaw:false"
+        std::string directory;
+        long chunk_mb = 64;
+        bool save_raw = false;
+        for (std::string entry : Helper::split(outOfCoreAccumulation, ',')) {
+            std::size_t colon = entry.find(':'); // the directory may be empty
+            if (colon==std::string::npos) {
+                if (Helper::trimmed(entry).size()>0)
+                    std::cout << "OutOfCoreAccumulation: ignoring invalid entry " << entry << std::endl;
+                continue;
+            }
+            std::string key = Helper::trimmed(entry.substr(0, colon));
+            std::string value = Helper::trimmed(entry.substr(colon+1));
+            if (key.compare("Directory")==0)
+                directory = value;
+            else if (key.compare("SaveRaw")==0 && (value.compare("true")==0 || value.compare("false")==0))
+                save_raw = value.compare("true")==0;
+            else if (key.compare("ChunkMB")==0) {
+                try {
+                    chunk_mb = std::stol(value);
+                    if (chunk_mb<1)
+                        chunk_mb = 1;
+                }
+                catch (std::exception& e) {
+                    std::cout << "OutOfCoreAccumulation: ignoring invalid entry " << entry << std::endl;
+                }
+            }
+            else
+                std::cout << "OutOfCoreAccumulation: ignoring invalid entry " << entry << std::endl;
+        }
+        std::string backing_file;
+        if (directory.size()>0) {
+            if (!Helper::ensure_directory_exists(directory)) {
+                std::cout << "ERROR: SurfaceConceptTDC::SetupOutOfCoreAccumulation:" << std::endl;
+                std::cout << " cannot create " << directory << ", accumulating in memory" << std::endl;
+            }
+            else // one file per server process
+                backing_file = Helper::join_pathnames(directory,
+                        "SurfaceConceptTDC_Hist_Accu_XYT_" + std::to_string(getpid()) + ".xyt");
+        }
+        out_of_core_save_raw = save_raw && backing_file.size()>0;
+        m_hist_map.at("Hist_Accu_XYT")->SetBackingFile(backing_file, chunk_mb*1048576);
+        if (backing_file.size()>0)
+            INFO_STREAM << "Accu XYT data buffer in " << backing_file << std::endl;
+    }
+
+    void SurfaceConceptTDC::BufferPoolTrimAction() {
+        // the madvise calls may take a while for big buffers, keep them off
+        // the scheduler thread
+        if (buffer_pool_trim_idle_ms<=0 || BufferPool::Shared().GetBytesCachedResident()==0)
+            return;
+        long idle_ms = buffer_pool_trim_idle_ms;
+        executor.Push(lane_config, [idle_ms]{ BufferPool::Shared().Trim(idle_ms); });
+    }
+
+    long long SurfaceConceptTDC::MemoryReservedBytes() {
+        // data buffers and the buffers derived from them (Tango frames,
+        // previews), and the released pool buffers that stay resident
+        // until the trim task returns them to the system
+        long long sum = BufferPool::Shared().GetBytesInUse()
+                + BufferPool::Shared().GetBytesCachedResident();
+        for (auto& h : m_hist_map)
+            sum += h.second->GetAuxiliaryMemory();
+        return sum;
+    }
+
+    long long SurfaceConceptTDC::MemoryResidentBytes() {
+        // resident set size of the whole server process
+        std::ifstream f("/proc/self/statm");
+        long long pages = 0, resident = 0;
+        if (!(f >> pages >> resident))
+            return 0;
+        return resident*sysconf(_SC_PAGESIZE);
+    }
+
+    bool SurfaceConceptTDC::AvailableBytes(GeneralHistogram* h, std::string& limit, long long& available) {
+        // the bytes the data buffer of h may take, including its current
+        // buffer (0 if the limit is already exceeded); returns false if
+        // there is no limit. A file-backed buffer (out-of-core accumulation)
+        // only uses the page cache and is limited by the disk
+        available = 0;
+        if (h->GetBackingFile().size()>0) {
+            std::string file = h->GetBackingFile();
+            long free = MappedFileBuffer::FreeDiskSpace(file.substr(0, file.rfind('/')+1));
+            limit = "the free disk space";
+            if (free<0)
+                return false;
+            available = free + (h->IsFileBacked() ? h->GetDatabufSize() : 0); // the file is replaced
+            return true;
+        }
+        if (memory_budget_bytes<=0)
+            return false;
+        limit = "the budget of " + Helper::Format_Bytesize(memory_budget_bytes, 2);
+        available = memory_budget_bytes - (MemoryReservedBytes() - h->GetDatabufSize());
+        if (available<0)
+            available = 0; // budget already exceeded
+        return true;
+    }
+
+    bool SurfaceConceptTDC::AdmitHistogramAttr(const std::string histname, const std::string histattrname, long value) {
+        // checks whether the data buffer of the histogram still fits into the
+        // memory budget (see AvailableBytes) after the attribute has been set; only the histogram
+        // itself is considered, the linked Accu histograms are small compared
+        // to the Accu XYT buffer
+        if (m_hist_map.count(histname)==0)
+            return true;
+        GeneralHistogram* h = m_hist_map.at(histname);
+        std::string limit;
+        long long available = 0;
+        if (!AvailableBytes(h, limit, available))
+            return true;
+        long zsize = 1;
+        long needed = h->ProjectedDatabufSize(histattrname, value, &zsize);
+        if (BufferPool::SizeClass(needed)<=h->GetDatabufSize())
+            return true; // fits into the current buffer
+        std::string msg;
+        if (BufferPool::SizeClass(needed)<=available) {
+            if (histname.compare("Hist_Accu_XYT")==0) {
+                msg = "accepted: " + Helper::Format_Bytesize(needed, 2) + " of "
+                        + Helper::Format_Bytesize(available, 2) + " available";
+                strncpy(info_accu_xyt_admission_val, msg.c_str(), STRING_BUF_SIZE-1);
+            }
+            return true;
+        }
+        msg = "rejected " + histname + "_" + histattrname + "=" + std::to_string(value) + ": "
+                + Helper::Format_Bytesize(needed, 2) + " needed, "
+                + Helper::Format_Bytesize(available, 2) + " of " + limit + " available";
+        if (zsize>1 && available>0) {
+            // suggest a coarser time axis: the largest T size that fits
+            // (size classes round up by at most 1/8), or the binning
+            // factor that keeps the time range
+            long slice = needed/zsize;
+            long maxt = slice>0 ? (long) ((available*8/9)/slice) : 0;
+            if (maxt>0) {
+                long factor = (zsize+maxt-1)/maxt;
+                msg += "; use ROI_TSIZE <= " + std::to_string(maxt)
+                        + " or BIN_T x" + std::to_string(factor) + " with ROI_TSIZE " + std::to_string((zsize+factor-1)/factor);
+            }
+            else
+                msg += "; reduce the X/Y region of interest";
+        }
+        if (h->depth>8 && BufferPool::SizeClass(needed/2)<=available)
+            msg += "; DEPTH " + std::to_string(h->depth/2) + " would fit";
+        std::cout << "ERROR: SurfaceConceptTDC::AdmitHistogramAttr:" << std::endl;
+        std::cout << " " << msg << std::endl;
+        if (histname.find("Accu")!=std::string::npos)
+            strncpy(info_accu_xyt_admission_val, msg.c_str(), STRING_BUF_SIZE-1);
+        strncpy(server_message_val, msg.c_str(), STRING_BUF_SIZE-1);
+        return false;
+    }
+
+    long SurfaceConceptTDC::MaxAccuXYTZSize() {
+        // the largest T size of the Accu XYT buffer within the budget (or
+        // the free disk space), for the current X/Y region and depth
+        // (-1: no limit)
+        if (m_hist_map.count("Hist_Accu_XYT")==0)
+            return -1;
+        GeneralHistogram* h = m_hist_map.at("Hist_Accu_XYT");
+        std::string limit;
+        long long available = 0;
+        if (!AvailableBytes(h, limit, available))
+            return -1;
+        long zsize = h->GetZSize();
+        long slice = zsize>0 ? h->ProjectedDatabufSize("", 0)/zsize : 0;
+        if (slice<=0 || available<=0)
+            return 0;
+        return (long) ((available*8/9)/slice);
+    }
+
+    void SurfaceConceptTDC::AddMemoryAttributes() {
+        Tango::UserDefaultAttrProp ap;
+        ap.set_format("%11d");
+        ap.set_unit("MB");
+        ap.set_description("Memory of released data buffers kept in the buffer pool for reuse "
+                "(pages of buffers idle for longer than TrimIdleMs are returned to the system)");
+        server_buffer_pool_cachedmem_attr = new CustomAttr("Server_Buffer_Pool_CachedMem", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        server_buffer_pool_cachedmem_attr->set_default_properties(ap);
+        server_buffer_pool_cachedmem_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(server_buffer_pool_cachedmem_attr);
+
+        Tango::UserDefaultAttrProp ap2;
+        ap2.set_format("%10d");
+        ap2.set_description("Number of data buffer allocations served from the buffer pool without a new mapping");
+        server_buffer_pool_reuses_attr = new CustomAttr("Server_Buffer_Pool_Reuses", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        server_buffer_pool_reuses_attr->set_default_properties(ap2);
+        server_buffer_pool_reuses_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(server_buffer_pool_reuses_attr);
+
+        Tango::UserDefaultAttrProp ap3;
+        ap3.set_format("%11d");
+        ap3.set_unit("MB");
+        ap3.set_description("Memory budget for the data buffers and the Tango frames and previews derived from them (BudgetMB of the BufferPool property, 0: no budget)");
+        server_memory_budget_attr = new CustomAttr("Server_Memory_Budget", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        server_memory_budget_attr->set_default_properties(ap3);
+        server_memory_budget_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(server_memory_budget_attr);
+        ap3.set_description("Memory reserved for the data buffers and the Tango frames and previews derived from them, and released buffers not yet trimmed, counted against the budget");
+        server_memory_reserved_attr = new CustomAttr("Server_Memory_Reserved", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        server_memory_reserved_attr->set_default_properties(ap3);
+        server_memory_reserved_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(server_memory_reserved_attr);
+        ap3.set_description("Resident memory of the server process");
+        server_memory_resident_attr = new CustomAttr("Server_Memory_Resident", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        server_memory_resident_attr->set_default_properties(ap3);
+        server_memory_resident_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(server_memory_resident_attr);
+
+        Tango::UserDefaultAttrProp ap4;
+        ap4.set_description("Result of the last memory budget check of a configuration change of the Accu histograms, with suggestions for rejected changes");
+        info_accu_xyt_admission_attr = new CustomAttr("Info_Accu_XYT_Admission", Tango::DEV_STRING, Tango::READ, Tango::AssocWritNotSpec);
+        info_accu_xyt_admission_attr->set_default_properties(ap4);
+        info_accu_xyt_admission_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(info_accu_xyt_admission_attr);
+
+        Tango::UserDefaultAttrProp ap5;
+        ap5.set_format("%10d");
+        ap5.set_description("Largest T size of the Accu XYT Buffer that fits into the memory budget (or the free disk space for out-of-core accumulation) for the current X/Y region and depth (-1: no limit)");
+        info_accu_xyt_max_tsize_attr = new CustomAttr("Info_Accu_XYT_Max_TSize", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        info_accu_xyt_max_tsize_attr->set_default_properties(ap5);
+        info_accu_xyt_max_tsize_attr->SetReadCallback(this, &SurfaceConceptTDC::Memory_ReadCallback);
+        this->add_attribute(info_accu_xyt_max_tsize_attr);
+    }
+
+    void SurfaceConceptTDC::Memory_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Server_Memory_Budget")==0) {
+            server_memory_budget_val = memory_budget_bytes/1048576;
+            att.set_value(&server_memory_budget_val);
+        }
+        else if (attrname.compare("Server_Memory_Reserved")==0) {
+            server_memory_reserved_val = MemoryReservedBytes()/1048576;
+            att.set_value(&server_memory_reserved_val);
+        }
+        else if (attrname.compare("Server_Memory_Resident")==0) {
+            server_memory_resident_val = MemoryResidentBytes()/1048576;
+            att.set_value(&server_memory_resident_val);
+        }
+        else if (attrname.compare("Info_Accu_XYT_Admission")==0) {
+            att.set_value(&info_accu_xyt_admission_val);
+        }
+        else if (attrname.compare("Info_Accu_XYT_Max_TSize")==0) {
+            info_accu_xyt_max_tsize_val = MaxAccuXYTZSize();
+            att.set_value(&info_accu_xyt_max_tsize_val);
+        }
+        else if (attrname.compare("Server_Buffer_Pool_CachedMem")==0) {
+            server_buffer_pool_cachedmem_val = BufferPool::Shared().GetBytesCachedResident()/1048576;
+            att.set_value(&server_buffer_pool_cachedmem_val);
+        }
+        else if (attrname.compare("Server_Buffer_Pool_Reuses")==0) {
+            server_buffer_pool_reuses_val = BufferPool::Shared().GetNrReuses();
+            att.set_value(&server_buffer_pool_reuses_val);
+        }
+    }
+}
@@ -321,6 +321,10 @@ namespace SurfaceConceptTDC_ns {
         else if (attrname.substr(0,3).compare("ROI")==0) {
             // REGION OF INTEREST   
             attrname = attrname.substr(4); // discard ROI_
+            // the Accu XYT buffer decides whether the synchronized ROI fits into
+            // the memory budget; check before any of the histograms is changed
+            if (!AdmitHistogramAttr("Hist_Accu_XYT", "ROI_"+attrname, w_val))
+                return;
             if (attrname.compare("X1")==0 || attrname.compare("X2")==0) {
                 for (std::string targetattr : {"Hist_Live_XY_ROI_",
                         "Hist_Live_XT_ROI_","Hist_Accu_XYT_ROI_"})
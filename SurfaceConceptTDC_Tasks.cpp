@@ -0,0 +1,276 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Worker lanes and periodic tasks of the device server (live images, counts
+// per second, accumulated preview, accumulated time), the coalescing refresh
+// jobs, and their diagnostic attributes
+
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "Helper.h"
+
+namespace SurfaceConceptTDC_ns {
+
+    void SurfaceConceptTDC::SetupExecutorLanes() {
+        // the lanes are created and started only once (init_device may be
+        // called again by the Init command)
+        if (executor.IsStarted())
+            return;
+        lane_preview = executor.AddLane("Preview", 1, 0);
+        lane_accu    = executor.AddLane("Accu", 1, 5);
+        lane_config  = executor.AddLane("Config", 1, 0);
+        lane_io      = executor.AddLane("IO", 1, 10);
+        lane_encode  = executor.AddLane("Encode", 1, 5);
+        // parse executorLaneWorkers, e.g. "Preview:1,Accu:2/5,Config:1,IO:1/10,Encode:2",
+        // the optional value after the slash is the nice value of the lane
+        for (std::string entry : Helper::split(executorLaneWorkers, ',')) {
+            std::vector<std::string> kv = Helper::split(entry, ':');
+            if (kv.size()!=2) {
+                if (Helper::trimmed(entry).size()>0)
+                    std::cout << "ExecutorLaneWorkers: ignoring invalid entry " << entry << std::endl;
+                continue;
+            }
+            std::string name = Helper::trimmed(kv[0]);
+            int lane = executor.FindLane(name);
+            std::vector<std::string> wn = Helper::split(kv[1], '/');
+            int workers = 0;
+            int nice_value = 0;
+            bool has_nice = wn.size()==2;
+            try {
+                workers = std::stoi(wn.at(0));
+                if (has_nice)
+                    nice_value = std::stoi(wn.at(1));
+            }
+            catch (std::exception& e) {
+                workers = 0;
+            }
+            if (lane<0 || workers<1 || workers>64 || wn.size()>2 || nice_value<-20 || nice_value>19) {
+                std::cout << "ExecutorLaneWorkers: ignoring invalid entry " << entry << std::endl;
+                continue;
+            }
+            if (lane==lane_config && workers>1) {
+                // the configuration writes must be applied in order
+                std::cout << "ExecutorLaneWorkers: the Config lane runs with one worker, limiting " << entry << std::endl;
+                workers = 1;
+            }
+            executor.SetLaneWorkers(lane, workers);
+            if (has_nice)
+                executor.SetLaneNice(lane, nice_value);
+        }
+        executor.Start();
+        int n = executor.GetNrLanes();
+        server_lane_queue_depth_val.assign(n, 0);
+        server_lane_latency_val.assign(n, 0.0);
+        server_lane_latency_max_val.assign(n, 0.0);
+    }
+
+    void SurfaceConceptTDC::SetupPeriodicTasks() {
+        // init_device may be called several times (Init command), the tasks
+        // are registered only once and keep their periods
+        if (periodic_tasks.GetNrTasks()>0)
+            return;
+        live_preview_refresh_job.SetFunction([this]{ this->LiveImageTriggerThreadedAction(); });
+        live_preview_refresh_job.SetSubmitter([this](std::function<void()> f){ executor.Push(lane_preview, f); });
+        accu_preview_refresh_job.SetFunction([this]{ this->AccuPreviewRefreshThreadedAction(); });
+        accu_preview_refresh_job.SetSubmitter([this](std::function<void()> f){ executor.Push(lane_accu, f); });
+        accu_sweep_job.SetFunction([this]{ this->SweepAccuCounters(); });
+        accu_sweep_job.SetSubmitter([this](std::function<void()> f){ executor.Push(lane_accu, f); });
+        task_live_trigger_id = periodic_tasks.AddTask("Live", 1000,
+                [this]{ this->LiveImageTriggerAction(); });
+        task_counts_per_sec_id = periodic_tasks.AddTask("Counts_Per_Sec", 1000,
+                [this]{ this->CountsPerSecUpdate(); });
+        task_accu_refresh_id = periodic_tasks.AddTask("Accu_Refresh", accu_preview_refresh_val,
+                [this]{ this->AccuPreviewRefreshAction(); });
+        task_accumulated_time_id = periodic_tasks.AddTask("Accumulated_Time", 200,
+                [this]{ this->AccumulatedTimeIncrementAction(); });
+        task_telemetry_id = periodic_tasks.AddTask("Telemetry", 1000,
+                [this]{ this->TelemetryUpdateAction(); });
+        task_buffer_pool_trim_id = periodic_tasks.AddTask("Buffer_Pool_Trim", 1000,
+                [this]{ this->BufferPoolTrimAction(); });
+        UpdateLiveTriggerPeriod();
+        server_task_overruns_val.assign(periodic_tasks.GetNrTasks(), 0);
+    }
+    
+    void SurfaceConceptTDC::UpdateLiveTriggerPeriod() {
+        long p = m_exposure_live_ms;
+        if (p<10) p = 10; // keep the refresh rate sane for tiny exposures
+        if (live_event_driven_val)
+            p = 0; // live frames are triggered by MeasurementCompleteCallback
+        periodic_tasks.SetPeriod(task_live_trigger_id, p);
+    }
+    
+    long SurfaceConceptTDC::GetMeasurementDuration() {
+        // in event-driven live mode, every measurement is one live frame
+        if (!live_event_driven_val)
+            return 1000;
+        return m_exposure_live_ms<10 ? 10 : m_exposure_live_ms;
+    }
+    
+    void SurfaceConceptTDC::LiveEventDriven_WriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& att) {
+        att.get_write_value(live_event_driven_val);
+        // takes effect for the measurement duration when the next measurement is started
+        UpdateLiveTriggerPeriod();
+        live_completion_latency_max_val = 0.0;
+    }
+    
+    void SurfaceConceptTDC::AddTaskAttributes() {
+        server_task_overruns_attr = new CustomSpectrumAttr("Server_Task_Overruns", Tango::DEV_LONG, Tango::READ, 16);
+        Tango::UserDefaultAttrProp ap;
+        ap.set_description("Number of missed deadlines of the periodic tasks, in the order "
+                "Live, Counts_Per_Sec, Accu_Refresh, Accumulated_Time, Telemetry, Buffer_Pool_Trim");
+        ap.set_format("%10d");
+        server_task_overruns_attr->set_default_properties(ap);
+        server_task_overruns_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(server_task_overruns_attr);
+        
+        Tango::UserDefaultAttrProp ap2;
+        ap2.set_format("%10d");
+        live_preview_refresh_coalesced_attr = new CustomAttr("Server_Live_Refresh_Coalesced", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        ap2.set_description("Number of live refresh requests that arrived during a running refresh and were served by one subsequent refresh");
+        live_preview_refresh_coalesced_attr->set_default_properties(ap2);
+        live_preview_refresh_coalesced_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(live_preview_refresh_coalesced_attr);
+        live_preview_refresh_skipped_attr = new CustomAttr("Server_Live_Refresh_Skipped", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        ap2.set_description("Number of live refresh requests that were merged into an already pending refresh");
+        live_preview_refresh_skipped_attr->set_default_properties(ap2);
+        live_preview_refresh_skipped_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(live_preview_refresh_skipped_attr);
+        accu_preview_refresh_coalesced_attr = new CustomAttr("Server_Accu_Refresh_Coalesced", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        ap2.set_description("Number of accumulated preview refresh requests that arrived during a running integration and were served by one subsequent integration");
+        accu_preview_refresh_coalesced_attr->set_default_properties(ap2);
+        accu_preview_refresh_coalesced_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(accu_preview_refresh_coalesced_attr);
+        accu_preview_refresh_skipped_attr = new CustomAttr("Server_Accu_Refresh_Skipped", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        ap2.set_description("Number of accumulated preview refresh requests that were merged into an already pending integration");
+        accu_preview_refresh_skipped_attr->set_default_properties(ap2);
+        accu_preview_refresh_skipped_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(accu_preview_refresh_skipped_attr);
+        
+        server_lane_queue_depth_attr = new CustomSpectrumAttr("Server_Lane_Queue_Depth", Tango::DEV_LONG, Tango::READ, 16);
+        Tango::UserDefaultAttrProp ap3;
+        ap3.set_description("Number of queued jobs per worker lane, in the order Preview, Accu, Config, IO, Encode");
+        ap3.set_format("%6d");
+        server_lane_queue_depth_attr->set_default_properties(ap3);
+        server_lane_queue_depth_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(server_lane_queue_depth_attr);
+        
+        Tango::UserDefaultAttrProp ap4;
+        ap4.set_unit("ms");
+        ap4.set_format("%8.3f");
+        server_lane_latency_attr = new CustomSpectrumAttr("Server_Lane_Latency", Tango::DEV_DOUBLE, Tango::READ, 16);
+        ap4.set_description("Average time jobs wait in the queue of each worker lane (moving average), in the order Preview, Accu, Config, IO, Encode");
+        server_lane_latency_attr->set_default_properties(ap4);
+        server_lane_latency_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(server_lane_latency_attr);
+        server_lane_latency_max_attr = new CustomSpectrumAttr("Server_Lane_Latency_Max", Tango::DEV_DOUBLE, Tango::READ, 16);
+        ap4.set_description("Maximum time a job waited in the queue of each worker lane, in the order Preview, Accu, Config, IO, Encode");
+        server_lane_latency_max_attr->set_default_properties(ap4);
+        server_lane_latency_max_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(server_lane_latency_max_attr);
+        
+        live_event_driven_attr = new CustomAttr("Live_Event_Driven", Tango::DEV_BOOLEAN, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap5;
+        ap5.set_description("If true, every measurement lasts one live exposure and the live images are "
+                "processed and pushed as soon as the measurement is complete. If false, the live images "
+                "are updated by a timer with the period of the live exposure.");
+        live_event_driven_attr->set_default_properties(ap5);
+        live_event_driven_attr->set_memorized();
+        live_event_driven_attr->set_memorized_init(true);
+        live_event_driven_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        live_event_driven_attr->SetWriteCallback(this, &SurfaceConceptTDC::LiveEventDriven_WriteCallback);
+        this->add_attribute(live_event_driven_attr);
+        
+        Tango::UserDefaultAttrProp ap6;
+        ap6.set_unit("ms");
+        ap6.set_format("%8.3f");
+        live_completion_latency_attr = new CustomAttr("Server_Live_Completion_Latency", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap6.set_description("Event-driven live mode: time from the completion of the last measurement until its live images had been pushed");
+        live_completion_latency_attr->set_default_properties(ap6);
+        live_completion_latency_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(live_completion_latency_attr);
+        live_completion_latency_max_attr = new CustomAttr("Server_Live_Completion_Latency_Max", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap6.set_description("Event-driven live mode: maximum time from the completion of a measurement until its live images had been pushed");
+        live_completion_latency_max_attr->set_default_properties(ap6);
+        live_completion_latency_max_attr->SetReadCallback(this, &SurfaceConceptTDC::Task_ReadCallback);
+        this->add_attribute(live_completion_latency_max_attr);
+    }
+    
+    void SurfaceConceptTDC::Task_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Server_Task_Overruns")==0) {
+            int n = periodic_tasks.GetNrTasks();
+            server_task_overruns_val.resize(n);
+            for (int i = 0; i<n; i++)
+                server_task_overruns_val[i] = periodic_tasks.GetOverruns(i);
+            att.set_value(server_task_overruns_val.data(), n);
+        }
+        else if (attrname.compare("Server_Lane_Queue_Depth")==0) {
+            int n = executor.GetNrLanes();
+            server_lane_queue_depth_val.resize(n);
+            for (int i = 0; i<n; i++)
+                server_lane_queue_depth_val[i] = executor.GetQueueDepth(i);
+            att.set_value(server_lane_queue_depth_val.data(), n);
+        }
+        else if (attrname.compare("Server_Lane_Latency")==0) {
+            int n = executor.GetNrLanes();
+            server_lane_latency_val.resize(n);
+            for (int i = 0; i<n; i++)
+                server_lane_latency_val[i] = executor.GetMeanLatency(i);
+            att.set_value(server_lane_latency_val.data(), n);
+        }
+        else if (attrname.compare("Server_Lane_Latency_Max")==0) {
+            int n = executor.GetNrLanes();
+            server_lane_latency_max_val.resize(n);
+            for (int i = 0; i<n; i++)
+                server_lane_latency_max_val[i] = executor.GetMaxLatency(i);
+            att.set_value(server_lane_latency_max_val.data(), n);
+        }
+        else if (attrname.compare("Live_Event_Driven")==0) {
+            att.set_value(&live_event_driven_val);
+        }
+        else if (attrname.compare("Server_Live_Completion_Latency")==0) {
+            att.set_value(&live_completion_latency_val);
+        }
+        else if (attrname.compare("Server_Live_Completion_Latency_Max")==0) {
+            att.set_value(&live_completion_latency_max_val);
+        }
+        else if (attrname.compare("Server_Live_Refresh_Coalesced")==0) {
+            live_preview_refresh_coalesced_val = live_preview_refresh_job.GetCoalescedCount();
+            att.set_value(&live_preview_refresh_coalesced_val);
+        }
+        else if (attrname.compare("Server_Live_Refresh_Skipped")==0) {
+            live_preview_refresh_skipped_val = live_preview_refresh_job.GetSkippedCount();
+            att.set_value(&live_preview_refresh_skipped_val);
+        }
+        else if (attrname.compare("Server_Accu_Refresh_Coalesced")==0) {
+            accu_preview_refresh_coalesced_val = accu_preview_refresh_job.GetCoalescedCount();
+            att.set_value(&accu_preview_refresh_coalesced_val);
+        }
+        else if (attrname.compare("Server_Accu_Refresh_Skipped")==0) {
+            accu_preview_refresh_skipped_val = accu_preview_refresh_job.GetSkippedCount();
+            att.set_value(&accu_preview_refresh_skipped_val);
+        }
+    }
+
+} // namespace
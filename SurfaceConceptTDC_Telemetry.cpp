@@ -0,0 +1,362 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Latency histograms, throughput and queue depths of the processing stages
+// (see PipelineTelemetry.h), exposed as attributes and as a text snapshot file
+// in the Prometheus exposition format; opt-in timeline tracing of the stages
+// and lane jobs (see PipelineTrace.h), dumped by the DumpTrace command
+
+#include <cstdio>
+#include <algorithm>
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "Helper.h"
+
+namespace SurfaceConceptTDC_ns {
+
+    static const int telemetry_max_stages = 32;
+    static const int telemetry_latency_columns = 6; // mean, p50, p90, p99, p99.9, max
+
+    void SurfaceConceptTDC::SetupTelemetry() {
+        // the stages are registered only once (init_device may be called again
+        // by the Init command)
+        if (telemetry.GetNrStages()>0)
+            return;
+        telemetry.SetTrace(&trace);
+        executor.SetTrace(&trace); // before SetupExecutorLanes starts the workers
+        stage_callback    = telemetry.AddStage("Callback");
+        stage_live_cycle  = telemetry.AddStage("Live_Cycle");
+        stage_live_copy   = telemetry.AddStage("Live_Copy");
+        stage_image_stat  = telemetry.AddStage("Image_Stat");
+        stage_tdc_stat    = telemetry.AddStage("TDC_Stat");
+        stage_push        = telemetry.AddStage("Push");
+        stage_encode      = telemetry.AddStage("Encode");
+        stage_accu_cycle  = telemetry.AddStage("Accu_Cycle");
+        stage_integration = telemetry.AddStage("Integration");
+        stage_file_write  = telemetry.AddStage("File_Write");
+        stage_save        = telemetry.AddStage("Save");
+    }
+
+    void SurfaceConceptTDC::TelemetryUpdateAction() {
+        // called by periodic_tasks once per second
+        telemetry.UpdateRates();
+        if (telemetry_file_period_val<=0)
+            return;
+        long now = Helper::get_millisec();
+        if (now-telemetry_file_last_ms < telemetry_file_period_val)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(telemetry_file_mutex);
+            if (telemetry_file_str.empty())
+                return;
+        }
+        telemetry_file_last_ms = now;
+        if (!telemetry_file_pending.exchange(true))
+            executor.Push(lane_io, [this]{ this->WriteTelemetryFile(); });
+    }
+
+    void SurfaceConceptTDC::WriteTelemetryFile() {
+        // this function must be called only via the job pushed by TelemetryUpdateAction
+        telemetry_file_pending = false;
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(telemetry_file_mutex);
+            path = telemetry_file_str;
+        }
+        if (path.empty())
+            return;
+        std::string out;
+        telemetry.FormatPrometheus("sctdc", out);
+        char line[256];
+        out += "# HELP sctdc_lane_queue_depth Number of queued jobs per worker lane\n";
+        out += "# TYPE sctdc_lane_queue_depth gauge\n";
+        for (int i = 0; i<executor.GetNrLanes(); i++) {
+            snprintf(line, sizeof(line), "sctdc_lane_queue_depth{lane=\"%s\"} %ld\n",
+                    executor.GetLaneName(i).c_str(), executor.GetQueueDepth(i));
+            out += line;
+        }
+        out += "# HELP sctdc_lane_latency_seconds Average time jobs wait in the queue of a worker lane\n";
+        out += "# TYPE sctdc_lane_latency_seconds gauge\n";
+        for (int i = 0; i<executor.GetNrLanes(); i++) {
+            snprintf(line, sizeof(line), "sctdc_lane_latency_seconds{lane=\"%s\"} %.6g\n",
+                    executor.GetLaneName(i).c_str(), executor.GetMeanLatency(i)*1e-3);
+            out += line;
+        }
+        out += "# HELP sctdc_task_overruns_total Missed deadlines of the periodic tasks\n";
+        out += "# TYPE sctdc_task_overruns_total counter\n";
+        for (int i = 0; i<periodic_tasks.GetNrTasks(); i++) {
+            snprintf(line, sizeof(line), "sctdc_task_overruns_total{task=\"%s\"} %ld\n",
+                    periodic_tasks.GetTaskName(i).c_str(), periodic_tasks.GetOverruns(i));
+            out += line;
+        }
+        // write to a temporary file and rename it, so readers never see a partial snapshot
+        std::string tmppath = path+".tmp";
+        FILE* f = fopen(tmppath.c_str(), "w");
+        if (f==NULL) {
+            std::cout << "ERROR: SurfaceConceptTDC::WriteTelemetryFile:" << std::endl;
+            std::cout << " could not open " << tmppath << " for writing" << std::endl;
+            return;
+        }
+        size_t written = fwrite(out.data(), 1, out.size(), f);
+        fclose(f);
+        if (written!=out.size() || rename(tmppath.c_str(), path.c_str())!=0) {
+            std::cout << "ERROR: SurfaceConceptTDC::WriteTelemetryFile:" << std::endl;
+            std::cout << " could not write " << path << std::endl;
+        }
+    }
+
+    void SurfaceConceptTDC::AddTelemetryAttributes() {
+        std::string order = "Callback, Live_Cycle, Live_Copy, Image_Stat, TDC_Stat, Push, Encode, "
+                "Accu_Cycle, Integration, File_Write, Save";
+        telemetry_latency_attr = new CustomImageAttr("Telemetry_Latency", Tango::DEV_DOUBLE, Tango::READ,
+                telemetry_latency_columns, telemetry_max_stages);
+        Tango::UserDefaultAttrProp ap1;
+        ap1.set_description(("Duration of the processing stages since the last reset, one row per stage in the order "
+                +order+"; columns: mean, median, 90%, 99%, 99.9% quantile (upper bounds with 12.5% resolution), maximum").c_str());
+        ap1.set_unit("us");
+        ap1.set_format("%10.1f");
+        telemetry_latency_attr->set_default_properties(ap1);
+        telemetry_latency_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        this->add_attribute(telemetry_latency_attr);
+        
+        telemetry_count_attr = new CustomSpectrumAttr("Telemetry_Count", Tango::DEV_LONG64, Tango::READ, telemetry_max_stages);
+        Tango::UserDefaultAttrProp ap2;
+        ap2.set_description(("Number of runs of the processing stages since the last reset, in the order "+order).c_str());
+        ap2.set_format("%12d");
+        telemetry_count_attr->set_default_properties(ap2);
+        telemetry_count_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        this->add_attribute(telemetry_count_attr);
+        
+        telemetry_throughput_attr = new CustomSpectrumAttr("Telemetry_Throughput", Tango::DEV_DOUBLE, Tango::READ, telemetry_max_stages);
+        Tango::UserDefaultAttrProp ap3;
+        ap3.set_description(("Runs of the processing stages per second during the last second, in the order "+order).c_str());
+        ap3.set_unit("1/s");
+        ap3.set_format("%10.2f");
+        telemetry_throughput_attr->set_default_properties(ap3);
+        telemetry_throughput_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        this->add_attribute(telemetry_throughput_attr);
+        
+        telemetry_histogram_attr = new CustomImageAttr("Telemetry_Histogram", Tango::DEV_LONG64, Tango::READ,
+                PipelineTelemetry::NR_BUCKETS, telemetry_max_stages);
+        Tango::UserDefaultAttrProp ap4;
+        ap4.set_description(("Latency histograms of the processing stages, one row per stage in the order "
+                +order+"; the upper bounds of the buckets are given by Telemetry_Histogram_Bounds").c_str());
+        telemetry_histogram_attr->set_default_properties(ap4);
+        telemetry_histogram_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        this->add_attribute(telemetry_histogram_attr);
+        
+        telemetry_bucket_bounds_attr = new CustomSpectrumAttr("Telemetry_Histogram_Bounds", Tango::DEV_DOUBLE, Tango::READ,
+                PipelineTelemetry::NR_BUCKETS);
+        Tango::UserDefaultAttrProp ap5;
+        ap5.set_description("Upper bounds of the buckets of Telemetry_Histogram");
+        ap5.set_unit("us");
+        ap5.set_format("%12.3f");
+        telemetry_bucket_bounds_attr->set_default_properties(ap5);
+        telemetry_bucket_bounds_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        this->add_attribute(telemetry_bucket_bounds_attr);
+        
+        telemetry_file_attr = new CustomAttr("Telemetry_File", Tango::DEV_STRING, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap6;
+        ap6.set_description("Path of a file that is periodically overwritten with a snapshot of the telemetry "
+                "in the Prometheus text format (e.g. for the textfile collector of node_exporter); empty = off");
+        telemetry_file_attr->set_default_properties(ap6);
+        telemetry_file_attr->set_memorized();
+        telemetry_file_attr->set_memorized_init(true);
+        telemetry_file_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        telemetry_file_attr->SetWriteCallback(this, &SurfaceConceptTDC::Telemetry_WriteCallback);
+        this->add_attribute(telemetry_file_attr);
+        
+        telemetry_file_period_attr = new CustomAttr("Telemetry_File_Period", Tango::DEV_LONG, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap7;
+        ap7.set_description("Period of the updates of Telemetry_File, 0 disables the updates");
+        ap7.set_unit("ms");
+        ap7.set_format("%8d");
+        ap7.set_min_value("0");
+        telemetry_file_period_attr->set_default_properties(ap7);
+        telemetry_file_period_attr->set_memorized();
+        telemetry_file_period_attr->set_memorized_init(true);
+        telemetry_file_period_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        telemetry_file_period_attr->SetWriteCallback(this, &SurfaceConceptTDC::Telemetry_WriteCallback);
+        this->add_attribute(telemetry_file_period_attr);
+        
+        telemetry_reset_attr = new CustomAttr("Telemetry_Reset", Tango::DEV_BOOLEAN, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap8;
+        ap8.set_description("Writing true clears the latency histograms and counters of all stages");
+        telemetry_reset_attr->set_default_properties(ap8);
+        telemetry_reset_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        telemetry_reset_attr->SetWriteCallback(this, &SurfaceConceptTDC::Telemetry_WriteCallback);
+        this->add_attribute(telemetry_reset_attr);
+        
+        trace_active_attr = new CustomAttr("Trace_Active", Tango::DEV_BOOLEAN, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap9;
+        ap9.set_description("If true, the processing stages and worker lane jobs of all threads are recorded "
+                "for the DumpTrace command; switching it on discards the previously recorded events");
+        trace_active_attr->set_default_properties(ap9);
+        trace_active_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        trace_active_attr->SetWriteCallback(this, &SurfaceConceptTDC::Telemetry_WriteCallback);
+        this->add_attribute(trace_active_attr);
+        
+        trace_buffer_size_attr = new CustomAttr("Trace_Buffer_Size", Tango::DEV_LONG, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap10;
+        ap10.set_description("Number of trace events kept per thread (the oldest are overwritten, "
+                "24 bytes per event), takes effect when Trace_Active is switched on");
+        ap10.set_format("%10d");
+        ap10.set_min_value("1024");
+        ap10.set_max_value("16777216");
+        trace_buffer_size_attr->set_default_properties(ap10);
+        trace_buffer_size_attr->set_memorized();
+        trace_buffer_size_attr->set_memorized_init(true);
+        trace_buffer_size_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        trace_buffer_size_attr->SetWriteCallback(this, &SurfaceConceptTDC::Telemetry_WriteCallback);
+        this->add_attribute(trace_buffer_size_attr);
+        
+        server_trace_events_attr = new CustomAttr("Server_Trace_Events", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap11;
+        ap11.set_description("Number of trace events currently held in the buffers of all threads");
+        ap11.set_format("%10d");
+        server_trace_events_attr->set_default_properties(ap11);
+        server_trace_events_attr->SetReadCallback(this, &SurfaceConceptTDC::Telemetry_ReadCallback);
+        this->add_attribute(server_trace_events_attr);
+    }
+
+    void SurfaceConceptTDC::Telemetry_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        int n = telemetry.GetNrStages();
+        if (attrname.compare("Telemetry_Latency")==0) {
+            telemetry_latency_val.resize(n*telemetry_latency_columns);
+            for (int i = 0; i<n; i++) {
+                Tango::DevDouble* row = &telemetry_latency_val[i*telemetry_latency_columns];
+                row[0] = telemetry.GetMeanMicros(i);
+                row[1] = telemetry.GetQuantileMicros(i, 0.5);
+                row[2] = telemetry.GetQuantileMicros(i, 0.9);
+                row[3] = telemetry.GetQuantileMicros(i, 0.99);
+                row[4] = telemetry.GetQuantileMicros(i, 0.999);
+                row[5] = telemetry.GetMaxMicros(i);
+            }
+            att.set_value(telemetry_latency_val.data(), telemetry_latency_columns, n);
+        }
+        else if (attrname.compare("Telemetry_Count")==0) {
+            telemetry_count_val.resize(n);
+            for (int i = 0; i<n; i++)
+                telemetry_count_val[i] = telemetry.GetCount(i);
+            att.set_value(telemetry_count_val.data(), n);
+        }
+        else if (attrname.compare("Telemetry_Throughput")==0) {
+            telemetry_throughput_val.resize(n);
+            for (int i = 0; i<n; i++)
+                telemetry_throughput_val[i] = telemetry.GetRate(i);
+            att.set_value(telemetry_throughput_val.data(), n);
+        }
+        else if (attrname.compare("Telemetry_Histogram")==0) {
+            telemetry_histogram_val.resize(n*PipelineTelemetry::NR_BUCKETS);
+            std::vector<long long> counts;
+            for (int i = 0; i<n; i++) {
+                telemetry.GetBuckets(i, counts);
+                std::copy(counts.begin(), counts.end(), telemetry_histogram_val.begin()+i*PipelineTelemetry::NR_BUCKETS);
+            }
+            att.set_value(telemetry_histogram_val.data(), PipelineTelemetry::NR_BUCKETS, n);
+        }
+        else if (attrname.compare("Telemetry_Histogram_Bounds")==0) {
+            telemetry_bucket_bounds_val.resize(PipelineTelemetry::NR_BUCKETS);
+            for (int i = 0; i<PipelineTelemetry::NR_BUCKETS; i++)
+                telemetry_bucket_bounds_val[i] = PipelineTelemetry::BucketUpperMicros(i);
+            att.set_value(telemetry_bucket_bounds_val.data(), PipelineTelemetry::NR_BUCKETS);
+        }
+        else if (attrname.compare("Telemetry_File")==0) {
+            std::lock_guard<std::mutex> lock(telemetry_file_mutex);
+            telemetry_file_val = const_cast<Tango::DevString>(telemetry_file_str.c_str());
+            att.set_value(&telemetry_file_val);
+        }
+        else if (attrname.compare("Telemetry_File_Period")==0) {
+            att.set_value(&telemetry_file_period_val);
+        }
+        else if (attrname.compare("Telemetry_Reset")==0) {
+            att.set_value(&telemetry_reset_val);
+        }
+        else if (attrname.compare("Trace_Active")==0) {
+            trace_active_val = trace.IsActive();
+            att.set_value(&trace_active_val);
+        }
+        else if (attrname.compare("Trace_Buffer_Size")==0) {
+            att.set_value(&trace_buffer_size_val);
+        }
+        else if (attrname.compare("Server_Trace_Events")==0) {
+            server_trace_events_val = trace.GetNrEvents();
+            att.set_value(&server_trace_events_val);
+        }
+    }
+
+    void SurfaceConceptTDC::Telemetry_WriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Telemetry_File")==0) {
+            Tango::DevString w_val;
+            att.get_write_value(w_val);
+            std::lock_guard<std::mutex> lock(telemetry_file_mutex);
+            telemetry_file_str = Helper::trimmed(w_val);
+        }
+        else if (attrname.compare("Telemetry_File_Period")==0) {
+            att.get_write_value(telemetry_file_period_val);
+        }
+        else if (attrname.compare("Telemetry_Reset")==0) {
+            Tango::DevBoolean w_val = false;
+            att.get_write_value(w_val);
+            if (w_val)
+                telemetry.Reset();
+        }
+        else if (attrname.compare("Trace_Active")==0) {
+            att.get_write_value(trace_active_val);
+            trace.SetActive(trace_active_val);
+        }
+        else if (attrname.compare("Trace_Buffer_Size")==0) {
+            att.get_write_value(trace_buffer_size_val);
+            trace.SetBufferSize(trace_buffer_size_val);
+        }
+    }
+
+    void SurfaceConceptTDC::dump_trace(Tango::DevString argin) {
+        std::string path = Helper::trimmed(argin);
+        if (path.empty()) {
+            strncpy(server_message_val, "Error: DumpTrace needs the path of the trace file", STRING_BUF_SIZE-1);
+            return;
+        }
+        // written by the IO lane, tracing goes on meanwhile
+        executor.Push(lane_io, [this, path]{
+            long n = trace.WriteChromeJson(path);
+            std::string msg;
+            if (n<0) {
+                std::cout << "ERROR: SurfaceConceptTDC::dump_trace:" << std::endl;
+                std::cout << " could not write " << path << std::endl;
+                msg = "Error: Failed attempt to write the trace to "+path;
+            }
+            else
+                msg = "Trace with "+std::to_string(n)+" events written to "+path;
+            strncpy(server_message_val, msg.c_str(), STRING_BUF_SIZE-1);
+        });
+    }
+
+    bool SurfaceConceptTDC::is_DumpTrace_allowed(const CORBA::Any& any) {
+        return true;
+    }
+
+} // namespace
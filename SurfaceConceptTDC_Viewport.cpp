@@ -0,0 +1,268 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Viewport queries: the GetViewport command takes a source image, a region
+// and a target resolution and returns the region binned to at most that
+// resolution, so that every client can look at its own region. Results are
+// cached per source frame and query.
+// The GetDecimated command reduces a long time spectrum to the minimum and
+// maximum per bucket for plotting, with the number of buckets passed by the
+// client.
+
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "ViewportBinning.h"
+#include "Helper.h"
+#include <algorithm>
+
+namespace SurfaceConceptTDC_ns {
+
+    static const std::vector<std::string> viewport_sources = {
+        "Hist_Live_XY", "Hist_Live_XT", "Hist_Live_YT",
+        "Hist_Accu_XY", "Hist_Accu_XT", "Hist_Accu_YT",
+        "Hist_Full_XY"
+    };
+    
+    static const std::size_t viewport_cache_size = 8;
+    static const std::size_t decimated_cache_size = 8;
+    
+    struct DecimatedViewDef {
+        const char* name;
+        const char* histname;
+        bool        accu;
+    };
+    
+    static const DecimatedViewDef decimated_view_defs[] = {
+        {"Hist_Full_T_Decimated",      "Hist_Full_T", false},
+        {"Hist_Full_Accu_T_Decimated", "Hist_Full_T", true},
+        {"Hist_Live_T_Decimated",      "Hist_Live_T", false},
+        {"Hist_Accu_T_Decimated",      "Hist_Accu_T", false},
+        {"Hist_Live_User_T_Decimated", "Hist_User_T", false},
+        {"Hist_Accu_User_T_Decimated", "Hist_User_T", true}
+    };
+
+    void SurfaceConceptTDC::AddViewportAttributes() {
+        server_viewport_cache_hits_attr = new CustomAttr("Server_Viewport_Cache_Hits", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap5;
+        ap5.set_description("Number of GetViewport results that were served from the cache");
+        ap5.set_format("%10d");
+        server_viewport_cache_hits_attr->set_default_properties(ap5);
+        server_viewport_cache_hits_attr->SetReadCallback(this, &SurfaceConceptTDC::Viewport_ReadCallback);
+        this->add_attribute(server_viewport_cache_hits_attr);
+    }
+
+    bool SurfaceConceptTDC::IsViewportSource(const std::string& histname) {
+        // sources are kept up to date while viewport queries (or GetDecimated
+        // for spectra) read them
+        // (Hist_Full_XY only publishes frames for viewports)
+        std::lock_guard<std::mutex> lock(viewport_mutex);
+        auto it = viewport_source_read_ms.find(histname);
+        return it!=viewport_source_read_ms.end() && Helper::get_millisec()-it->second < lazy_views_timeout_val;
+    }
+
+    TangoFramePtr SurfaceConceptTDC::ComputeViewport(ViewportQuery& query) {
+        TangoFramePtr src = m_hist_map.at(query.source)->GetTangoFrame();
+        if (!src || src->data.empty())
+            return TangoFramePtr();
+        query.seq = src->seq;
+        {
+            std::lock_guard<std::mutex> lock(viewport_mutex);
+            for (auto& c : viewport_cache)
+                if (c.first==query) {
+                    server_viewport_cache_hits++;
+                    query = c.first;
+                    return c.second;
+                }
+        }
+        long x2 = query.x2<0 ? src->width-1 : query.x2;
+        long y2 = query.y2<0 ? src->height-1 : query.y2;
+        std::shared_ptr<TangoFrame> frame = std::make_shared<TangoFrame>();
+        int ret = BinImageRegion(src->data.data(), src->width, src->height, query.x1, query.y1, x2, y2,
+                std::min(query.width, (long) hist_images_max_xsize), std::min(query.height, (long) hist_images_max_ysize),
+                query.mode, frame->data, frame->width, frame->height,
+                query.binx, query.biny);
+        if (ret!=0)
+            return TangoFramePtr(); // region outside of the image
+        frame->seq = src->seq;
+        std::lock_guard<std::mutex> lock(viewport_mutex);
+        viewport_cache.push_front(std::make_pair(query, TangoFramePtr(frame)));
+        if (viewport_cache.size()>viewport_cache_size)
+            viewport_cache.pop_back();
+        return frame;
+    }
+
+    Tango::DevVarLongArray* SurfaceConceptTDC::get_viewport(const Tango::DevVarLongStringArray* argin) {
+        // argin: x1, y1, x2, y2, width, height (longs) and source, mode
+        // (strings, the mode is optional); argout: width, height, x1, y1,
+        // x2, y2, bin x, bin y of the binned region followed by its pixels
+        // row by row, empty if there is no result
+        Tango::DevVarLongArray* argout = new Tango::DevVarLongArray();
+        argout->length(0);
+        ViewportQuery query;
+        std::string msg;
+        if (argin->lvalue.length()!=6 || argin->svalue.length()<1 || argin->svalue.length()>2)
+            msg = "GetViewport needs x1, y1, x2, y2, width, height and the source (optionally the mode)";
+        else {
+            query.source = std::string(argin->svalue[0]);
+            query.x1 = argin->lvalue[0];
+            query.y1 = argin->lvalue[1];
+            query.x2 = argin->lvalue[2];
+            query.y2 = argin->lvalue[3];
+            query.width = argin->lvalue[4];
+            query.height = argin->lvalue[5];
+            if (std::find(viewport_sources.begin(), viewport_sources.end(), query.source)==viewport_sources.end())
+                msg = "unknown viewport source " + query.source;
+            else if (argin->svalue.length()>1 && !ViewportModeFromString(std::string(argin->svalue[1]), query.mode))
+                msg = "unknown viewport mode " + std::string(argin->svalue[1]);
+            else if (query.width<1 || query.height<1 || query.x1<-1 || query.y1<-1 || query.x2<-1 || query.y2<-1)
+                msg = "invalid viewport region or size";
+        }
+        if (!msg.empty()) {
+            std::cout << "ERROR: SurfaceConceptTDC::get_viewport:" << std::endl;
+            std::cout << " " << msg << std::endl;
+            msg = "Error: " + msg;
+            strncpy(server_message_val, msg.c_str(), STRING_BUF_SIZE-1);
+            return argout;
+        }
+        {
+            std::lock_guard<std::mutex> lock(viewport_mutex);
+            viewport_source_read_ms[query.source] = Helper::get_millisec();
+        }
+        // the query is served from the last frame of the source, the next
+        // live cycle or refresh brings a skipped source up to date
+        NoteViewRead(query.source);
+        TangoFramePtr frame = ComputeViewport(query);
+        if (!frame)
+            return argout;
+        long x1 = std::max(query.x1, 0L);
+        long y1 = std::max(query.y1, 0L);
+        const Tango::DevLong header[8] = {(Tango::DevLong) frame->width, (Tango::DevLong) frame->height,
+                (Tango::DevLong) x1, (Tango::DevLong) y1,
+                (Tango::DevLong) (x1 + frame->width*query.binx - 1), (Tango::DevLong) (y1 + frame->height*query.biny - 1),
+                (Tango::DevLong) query.binx, (Tango::DevLong) query.biny};
+        argout->length(8+frame->data.size());
+        for (int i=0; i<8; i++)
+            (*argout)[i] = header[i];
+        for (std::size_t i=0; i<frame->data.size(); i++)
+            (*argout)[8+i] = frame->data[i];
+        return argout;
+    }
+
+    bool SurfaceConceptTDC::is_GetViewport_allowed(const CORBA::Any& any) {
+        return true;
+    }
+
+    void SurfaceConceptTDC::Viewport_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Server_Viewport_Cache_Hits")==0) {
+            server_viewport_cache_hits_val = server_viewport_cache_hits.load();
+            att.set_value(&server_viewport_cache_hits_val);
+        }
+    }
+
+    TangoFramePtr SurfaceConceptTDC::DecimateView(const std::string& name, long buckets) {
+        const DecimatedViewDef* def = NULL;
+        for (const DecimatedViewDef& d : decimated_view_defs)
+            if (name.compare(d.name)==0)
+                def = &d;
+        if (def==NULL)
+            return TangoFramePtr();
+        GeneralHistogram* h = m_hist_map.at(def->histname);
+        TangoFramePtr src = def->accu ? h->GetTangoAccuFrame() : h->GetTangoFrame();
+        if (!src || src->data.empty())
+            return TangoFramePtr();
+        {
+            std::lock_guard<std::mutex> lock(viewport_mutex);
+            for (auto& c : decimated_cache)
+                if (c.name==name && c.buckets==buckets && c.frame->seq==src->seq)
+                    return c.frame;
+        }
+        std::shared_ptr<TangoFrame> frame = std::make_shared<TangoFrame>();
+        long n = DecimateMinMax(src->data.data(), src->data.size(), buckets, frame->data);
+        if (n<0)
+            return TangoFramePtr();
+        frame->width = frame->data.size();
+        frame->height = 1;
+        frame->seq = src->seq;
+        DecimatedResult result;
+        result.name = name;
+        result.buckets = buckets;
+        result.frame = frame;
+        std::lock_guard<std::mutex> lock(viewport_mutex);
+        decimated_cache.push_front(result);
+        if (decimated_cache.size()>decimated_cache_size)
+            decimated_cache.pop_back();
+        return frame;
+    }
+
+    Tango::DevVarLongArray* SurfaceConceptTDC::get_decimated(const Tango::DevVarLongStringArray* argin) {
+        // argin: number of buckets (long) and the name of the decimated
+        // spectrum (string); argout: min0, max0, min1, max1, ... of the
+        // buckets, empty if there is no result
+        Tango::DevVarLongArray* argout = new Tango::DevVarLongArray();
+        argout->length(0);
+        std::string msg;
+        std::string name;
+        std::string histname;
+        long buckets = 0;
+        if (argin->lvalue.length()!=1 || argin->svalue.length()!=1)
+            msg = "GetDecimated needs the number of buckets and the name of the spectrum";
+        else {
+            name = std::string(argin->svalue[0]);
+            buckets = argin->lvalue[0];
+            for (const DecimatedViewDef& d : decimated_view_defs)
+                if (name.compare(d.name)==0)
+                    histname = d.histname;
+            if (histname.empty())
+                msg = "unknown decimated spectrum " + name;
+            else if (buckets<1 || buckets>decimation_max_width)
+                msg = "the number of buckets must be between 1 and " + std::to_string(decimation_max_width);
+        }
+        if (!msg.empty()) {
+            std::cout << "ERROR: SurfaceConceptTDC::get_decimated:" << std::endl;
+            std::cout << " " << msg << std::endl;
+            msg = "Error: " + msg;
+            strncpy(server_message_val, msg.c_str(), STRING_BUF_SIZE-1);
+            return argout;
+        }
+        {
+            // the source histogram is kept up to date like a viewport source
+            std::lock_guard<std::mutex> lock(viewport_mutex);
+            viewport_source_read_ms[histname] = Helper::get_millisec();
+        }
+        NoteViewRead(histname); // the next cycle or refresh computes a skipped spectrum
+        TangoFramePtr frame = DecimateView(name, buckets);
+        if (!frame)
+            return argout;
+        argout->length(frame->data.size());
+        for (std::size_t i=0; i<frame->data.size(); i++)
+            (*argout)[i] = frame->data[i];
+        return argout;
+    }
+
+    bool SurfaceConceptTDC::is_GetDecimated_allowed(const CORBA::Any& any) {
+        return true;
+    }
+
+} // namespace
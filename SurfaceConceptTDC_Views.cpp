@@ -0,0 +1,338 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Demand tracking of the exported histogram views: views that no client has
+// subscribed to and that have not been read recently are neither converted
+// nor pushed; a read marks the demand and returns the last computed view, the
+// next live frame or accumulation preview refresh brings it up to date.
+// Hardware pipes whose views stay unconsumed are closed after an idle
+// timeout and reopened between two measurements when they are demanded again.
+
+#include "SurfaceConceptTDC.h"
+#include "CustomAttr.h"
+#include "Helper.h"
+#include <algorithm>
+
+namespace SurfaceConceptTDC_ns {
+
+    // the Tango attributes fed by each histogram
+    static const std::map<std::string, std::vector<std::string> > hist_view_attrs = {
+        {"Hist_Live_XY", {"Hist_Live_XY", "Hist_Live_XY_Max", "Hist_Live_XY_Q998", "Hist_Live_XY_Encoded", "Hist_Live_XY_Tiles"}},
+        {"Hist_Live_XT", {"Hist_Live_XT", "Hist_Live_XT_Max", "Hist_Live_XT_Q998", "Hist_Live_XT_Encoded", "Hist_Live_XT_Tiles"}},
+        {"Hist_Live_YT", {"Hist_Live_YT", "Hist_Live_YT_Max", "Hist_Live_YT_Q998", "Hist_Live_YT_Encoded", "Hist_Live_YT_Tiles"}},
+        {"Hist_Accu_XY", {"Hist_Accu_XY", "Hist_Accu_XY_Max", "Hist_Accu_XY_Q998", "Hist_Accu_XY_Encoded", "Hist_Accu_XY_Tiles"}},
+        {"Hist_Accu_XT", {"Hist_Accu_XT", "Hist_Accu_XT_Max", "Hist_Accu_XT_Q998", "Hist_Accu_XT_Encoded", "Hist_Accu_XT_Tiles"}},
+        {"Hist_Accu_YT", {"Hist_Accu_YT", "Hist_Accu_YT_Max", "Hist_Accu_YT_Q998", "Hist_Accu_YT_Encoded", "Hist_Accu_YT_Tiles"}},
+        {"Hist_Live_T",  {"Hist_Live_T", "Hist_Live_TAxis", "Hist_Live_T_Encoded"}},
+        {"Hist_Accu_T",  {"Hist_Accu_T", "Hist_Accu_TAxis", "Hist_Accu_T_Encoded"}},
+        {"Hist_Full_T",  {"Hist_Full_T", "Hist_Full_TAxis", "Hist_Full_T_Encoded"}},
+        {"Hist_User_T",  {"Hist_Live_User_T", "Hist_User_TAxis", "Hist_Live_User_T_Encoded"}},
+        {"Hist_Full_Counts", {"Counts_Per_Sec"}}
+    };
+
+    bool SurfaceConceptTDC::IsViewConsumed(const std::string& attrname) {
+        if (!lazy_views_val)
+            return true;
+        if (attrname.compare("Frame_Bundle")!=0 && IsBundled(attrname) && IsViewConsumed("Frame_Bundle"))
+            return true;
+        {
+            std::lock_guard<std::mutex> lock(view_demand_mutex);
+            auto it = view_demand.find(attrname);
+            if (it!=view_demand.end() && it->second.last_read_ms>=0 &&
+                    Helper::get_millisec()-it->second.last_read_ms < lazy_views_timeout_val)
+                return true;
+        }
+        try {
+            return get_device_attr()->get_attr_by_name(attrname.c_str()).change_event_subscribed();
+        }
+        catch (Tango::DevFailed& e) {
+            return false; // no such attribute, e.g. if the Tango live preview is disabled
+        }
+    }
+
+    bool SurfaceConceptTDC::IsHistViewConsumed(const std::string& histname) {
+        if (IsViewportSource(histname))
+            return true;
+        auto it = hist_view_attrs.find(histname);
+        if (it==hist_view_attrs.end())
+            return IsViewConsumed(histname);
+        for (const std::string& attrname : it->second)
+            if (IsViewConsumed(attrname))
+                return true;
+        return false;
+    }
+
+    void SurfaceConceptTDC::MarkHistViewSkipped(const std::string& histname) {
+        auto it = hist_view_attrs.find(histname);
+        if (it==hist_view_attrs.end())
+            return; // not exported to Tango
+        server_views_skipped++;
+        std::lock_guard<std::mutex> lock(view_demand_mutex);
+        for (const std::string& attrname : it->second)
+            view_demand[attrname].stale = true;
+    }
+
+    void SurfaceConceptTDC::NoteViewRead(const std::string& attrname) {
+        std::string histname;
+        for (auto& hv : hist_view_attrs)
+            for (const std::string& a : hv.second)
+                if (a.compare(attrname)==0)
+                    histname = hv.first;
+        bool stale = false;
+        {
+            std::lock_guard<std::mutex> lock(view_demand_mutex);
+            ViewDemand& d = view_demand[attrname];
+            d.last_read_ms = Helper::get_millisec();
+            stale = d.stale;
+            d.stale = false;
+            if (pipes_idle_closed.count(histname)>0) {
+                stale = true;
+                long long expected = 0; // keep the time of the first request
+                pipe_reopen_request_ns.compare_exchange_strong(expected, Helper::get_nanosec());
+            }
+        }
+        // never wait or integrate inside a Tango read (the device is
+        // serialized): the read returns the last computed view, live views
+        // are produced again with the next live frame (a closed pipe is
+        // reopened after the next measurement and delivers with the one
+        // after), accumulated projections with one more refresh
+        if (!stale || histname.find("Hist_Accu_")!=0)
+            return;
+        if (m_hist_map.at("Hist_Accu_XYT")->GetDatabufPointer()!=NULL)
+            accu_preview_refresh_job.Request();
+    }
+
+    void SurfaceConceptTDC::PushDerivedViews(const std::string& histname, bool accu) {
+        // views computed on the Encode lane from a newly published frame
+        PushEncodedViews(histname, accu);
+    }
+
+    bool SurfaceConceptTDC::IsPipeDemanded(const std::string& histname) {
+        if (!lazy_pipes_val)
+            return true;
+        GeneralHistogram* h = m_hist_map.at(histname);
+        if (h->GetFileOutputActive() || h->GetPGMOutputActive())
+            return true;
+        // the accumulated spectra are summed up from the live pipes
+        if (accumulation_running && (histname.compare("Hist_Full_T")==0 || histname.compare("Hist_User_T")==0))
+            return true;
+        return IsHistViewConsumed(histname);
+    }
+
+    void SurfaceConceptTDC::ResetIdlePipes() {
+        long now = Helper::get_millisec();
+        std::lock_guard<std::mutex> lock(view_demand_mutex);
+        pipes_idle_closed.clear();
+        for (auto& hv : hist_view_attrs)
+            pipe_last_demand_ms[hv.first] = now;
+        pipe_reopen_request_ns = 0;
+    }
+
+    void SurfaceConceptTDC::ManageIdlePipes() {
+        // must only be called between two measurements (closing a pipe during
+        // a measurement may crash the library)
+        long now = Helper::get_millisec();
+        for (auto& hv : hist_view_attrs) {
+            const std::string& histname = hv.first;
+            if (std::find(pipeless_histograms.begin(), pipeless_histograms.end(), histname)!=pipeless_histograms.end())
+                continue;
+            GeneralHistogram* h = m_hist_map.at(histname);
+            bool demanded = IsPipeDemanded(histname);
+            bool idle_closed = false;
+            long last_demand = now;
+            {
+                std::lock_guard<std::mutex> lock(view_demand_mutex);
+                idle_closed = pipes_idle_closed.count(histname)>0;
+                if (demanded)
+                    pipe_last_demand_ms[histname] = now;
+                last_demand = pipe_last_demand_ms[histname];
+            }
+            if (idle_closed && demanded) {
+                h->SetPipeActive(true);
+                if (!h->GetPipeActive())
+                    continue; // try again after the next measurement
+                {
+                    std::lock_guard<std::mutex> lock(view_demand_mutex);
+                    pipes_idle_closed.erase(histname);
+                }
+                server_pipe_reopens++;
+                long long requested = pipe_reopen_request_ns.exchange(0);
+                if (requested>0) {
+                    server_pipe_reopen_latency_val = (Helper::get_nanosec()-requested)*1e-6;
+                    if (server_pipe_reopen_latency_val>server_pipe_reopen_latency_max_val)
+                        server_pipe_reopen_latency_max_val = server_pipe_reopen_latency_val;
+                }
+            }
+            else if (!idle_closed && !demanded && h->GetPipeActive() && now-last_demand>=lazy_pipes_timeout_val) {
+                h->SetPipeActive(false);
+                std::lock_guard<std::mutex> lock(view_demand_mutex);
+                pipes_idle_closed.insert(histname);
+            }
+        }
+    }
+
+    void SurfaceConceptTDC::AddViewAttributes() {
+        lazy_views_attr = new CustomAttr("Lazy_Views", Tango::DEV_BOOLEAN, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap1;
+        ap1.set_description("If true (default false), histogram views (images, spectra, time axes, image statistics) "
+                "are only computed and pushed while a client subscribes to their change events "
+                "or has read them within Lazy_Views_Timeout. A read of a skipped view returns the "
+                "last computed one; it is brought up to date by the next live frame (live views) "
+                "or one more accumulation preview refresh (accumulated views).");
+        lazy_views_attr->set_default_properties(ap1);
+        lazy_views_attr->set_memorized();
+        lazy_views_attr->set_memorized_init(true);
+        lazy_views_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        lazy_views_attr->SetWriteCallback(this, &SurfaceConceptTDC::View_WriteCallback);
+        this->add_attribute(lazy_views_attr);
+        
+        lazy_views_timeout_attr = new CustomAttr("Lazy_Views_Timeout", Tango::DEV_LONG, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap2;
+        ap2.set_description("Time after the last read of a histogram view until it is no longer kept up to date "
+                "(unless a client subscribes to its change events)");
+        ap2.set_unit("ms");
+        ap2.set_format("%8d");
+        ap2.set_min_value("100");
+        lazy_views_timeout_attr->set_default_properties(ap2);
+        lazy_views_timeout_attr->set_memorized();
+        lazy_views_timeout_attr->set_memorized_init(true);
+        lazy_views_timeout_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        lazy_views_timeout_attr->SetWriteCallback(this, &SurfaceConceptTDC::View_WriteCallback);
+        this->add_attribute(lazy_views_timeout_attr);
+        
+        server_views_skipped_attr = new CustomAttr("Server_Views_Skipped", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap3;
+        ap3.set_description("Number of histogram views that were not computed because no client consumed them");
+        ap3.set_format("%10d");
+        server_views_skipped_attr->set_default_properties(ap3);
+        server_views_skipped_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        this->add_attribute(server_views_skipped_attr);
+        
+        lazy_pipes_attr = new CustomAttr("Lazy_Pipes", Tango::DEV_BOOLEAN, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap4;
+        ap4.set_description("If true (default false), live histogram pipes whose views are not consumed (see Lazy_Views), "
+                "that have no file output and no running accumulation depending on them, are closed "
+                "after Lazy_Pipes_Timeout. They are reopened between two measurements as soon as "
+                "they are demanded again.");
+        lazy_pipes_attr->set_default_properties(ap4);
+        lazy_pipes_attr->set_memorized();
+        lazy_pipes_attr->set_memorized_init(true);
+        lazy_pipes_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        lazy_pipes_attr->SetWriteCallback(this, &SurfaceConceptTDC::View_WriteCallback);
+        this->add_attribute(lazy_pipes_attr);
+        
+        lazy_pipes_timeout_attr = new CustomAttr("Lazy_Pipes_Timeout", Tango::DEV_LONG, Tango::READ_WRITE, Tango::AssocWritNotSpec);
+        Tango::UserDefaultAttrProp ap5;
+        ap5.set_description("Time a histogram pipe has to stay without demand before it is closed");
+        ap5.set_unit("ms");
+        ap5.set_format("%8d");
+        ap5.set_min_value("1000");
+        lazy_pipes_timeout_attr->set_default_properties(ap5);
+        lazy_pipes_timeout_attr->set_memorized();
+        lazy_pipes_timeout_attr->set_memorized_init(true);
+        lazy_pipes_timeout_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        lazy_pipes_timeout_attr->SetWriteCallback(this, &SurfaceConceptTDC::View_WriteCallback);
+        this->add_attribute(lazy_pipes_timeout_attr);
+        
+        Tango::UserDefaultAttrProp ap6;
+        ap6.set_format("%10d");
+        server_pipes_idle_attr = new CustomAttr("Server_Pipes_Idle", Tango::DEV_LONG, Tango::READ, Tango::AssocWritNotSpec);
+        ap6.set_description("Number of histogram pipes that are currently closed for lack of demand");
+        server_pipes_idle_attr->set_default_properties(ap6);
+        server_pipes_idle_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        this->add_attribute(server_pipes_idle_attr);
+        server_pipe_reopens_attr = new CustomAttr("Server_Pipe_Reopens", Tango::DEV_LONG64, Tango::READ, Tango::AssocWritNotSpec);
+        ap6.set_description("Number of times an idle histogram pipe was reopened on demand");
+        server_pipe_reopens_attr->set_default_properties(ap6);
+        server_pipe_reopens_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        this->add_attribute(server_pipe_reopens_attr);
+        
+        Tango::UserDefaultAttrProp ap7;
+        ap7.set_unit("ms");
+        ap7.set_format("%8.3f");
+        server_pipe_reopen_latency_attr = new CustomAttr("Server_Pipe_Reopen_Latency", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap7.set_description("Time from the first read of a view of an idle pipe until the pipe was open again "
+                "(its data follows with the next live frame)");
+        server_pipe_reopen_latency_attr->set_default_properties(ap7);
+        server_pipe_reopen_latency_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        this->add_attribute(server_pipe_reopen_latency_attr);
+        server_pipe_reopen_latency_max_attr = new CustomAttr("Server_Pipe_Reopen_Latency_Max", Tango::DEV_DOUBLE, Tango::READ, Tango::AssocWritNotSpec);
+        ap7.set_description("Maximum time from the first read of a view of an idle pipe until the pipe was open again");
+        server_pipe_reopen_latency_max_attr->set_default_properties(ap7);
+        server_pipe_reopen_latency_max_attr->SetReadCallback(this, &SurfaceConceptTDC::View_ReadCallback);
+        this->add_attribute(server_pipe_reopen_latency_max_attr);
+    }
+
+    void SurfaceConceptTDC::View_ReadCallback(Tango::DeviceImpl* dev, Tango::Attribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Lazy_Views")==0) {
+            att.set_value(&lazy_views_val);
+        }
+        else if (attrname.compare("Lazy_Views_Timeout")==0) {
+            att.set_value(&lazy_views_timeout_val);
+        }
+        else if (attrname.compare("Server_Views_Skipped")==0) {
+            server_views_skipped_val = server_views_skipped.load();
+            att.set_value(&server_views_skipped_val);
+        }
+        else if (attrname.compare("Lazy_Pipes")==0) {
+            att.set_value(&lazy_pipes_val);
+        }
+        else if (attrname.compare("Lazy_Pipes_Timeout")==0) {
+            att.set_value(&lazy_pipes_timeout_val);
+        }
+        else if (attrname.compare("Server_Pipes_Idle")==0) {
+            std::lock_guard<std::mutex> lock(view_demand_mutex);
+            server_pipes_idle_val = pipes_idle_closed.size();
+            att.set_value(&server_pipes_idle_val);
+        }
+        else if (attrname.compare("Server_Pipe_Reopens")==0) {
+            server_pipe_reopens_val = server_pipe_reopens.load();
+            att.set_value(&server_pipe_reopens_val);
+        }
+        else if (attrname.compare("Server_Pipe_Reopen_Latency")==0) {
+            att.set_value(&server_pipe_reopen_latency_val);
+        }
+        else if (attrname.compare("Server_Pipe_Reopen_Latency_Max")==0) {
+            att.set_value(&server_pipe_reopen_latency_max_val);
+        }
+    }
+
+    void SurfaceConceptTDC::View_WriteCallback(Tango::DeviceImpl* dev, Tango::WAttribute& att) {
+        std::string attrname = att.get_name();
+        if (attrname.compare("Lazy_Views")==0) {
+            att.get_write_value(lazy_views_val);
+        }
+        else if (attrname.compare("Lazy_Views_Timeout")==0) {
+            att.get_write_value(lazy_views_timeout_val);
+        }
+        else if (attrname.compare("Lazy_Pipes")==0) {
+            att.get_write_value(lazy_pipes_val); // idle pipes are reopened after the next measurement
+        }
+        else if (attrname.compare("Lazy_Pipes_Timeout")==0) {
+            att.get_write_value(lazy_pipes_timeout_val);
+        }
+    }
+
+} // namespace
@@ -0,0 +1,131 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "ViewportBinning.h"
+#include <algorithm>
+#include <limits>
+
+namespace SurfaceConceptTDC_ns {
+
+    int BinImageRegion(const int32_t* src, long srcw, long srch, long x1, long y1, long x2, long y2,
+            long maxw, long maxh, ViewportMode mode, std::vector<int32_t>& out, long& outw, long& outh,
+            long& binx, long& biny) {
+        if (src==NULL || srcw<=0 || srch<=0 || maxw<=0 || maxh<=0)
+            return -1;
+        x1 = std::max(x1, 0L);
+        y1 = std::max(y1, 0L);
+        x2 = std::min(x2, srcw-1);
+        y2 = std::min(y2, srch-1);
+        if (x2<x1 || y2<y1)
+            return -1;
+        long ww = x2-x1+1;
+        long wh = y2-y1+1;
+        binx = (ww+maxw-1)/maxw;
+        biny = (wh+maxh-1)/maxh;
+        outw = (ww+binx-1)/binx;
+        outh = (wh+biny-1)/biny;
+        out.resize(outw*outh);
+        if (mode==VIEWPORT_SAMPLE) {
+            for (long oy = 0; oy<outh; oy++) {
+                const int32_t* row = src + (y1+oy*biny)*srcw + x1;
+                int32_t* o = &out[oy*outw];
+                for (long ox = 0; ox<outw; ox++)
+                    o[ox] = row[ox*binx];
+            }
+            return 0;
+        }
+        // first reduce the rows of a bin into a line buffer (contiguous inner
+        // loops that the compiler vectorizes), then the columns of the line
+        const int32_t maxval = std::numeric_limits<int32_t>::max();
+        std::vector<int64_t> line(ww);
+        int64_t* l = line.data();
+        for (long oy = 0; oy<outh; oy++) {
+            long ys = y1+oy*biny;
+            long ye = std::min(ys+biny, y2+1);
+            const int32_t* row = src + ys*srcw + x1;
+            for (long x = 0; x<ww; x++)
+                l[x] = row[x];
+            for (long y = ys+1; y<ye; y++) {
+                row = src + y*srcw + x1;
+                if (mode==VIEWPORT_MAX)
+                    for (long x = 0; x<ww; x++)
+                        l[x] = std::max(l[x], (int64_t) row[x]);
+                else
+                    for (long x = 0; x<ww; x++)
+                        l[x] += row[x];
+            }
+            int32_t* o = &out[oy*outw];
+            for (long ox = 0; ox<outw; ox++) {
+                long xs = ox*binx;
+                long xe = std::min(xs+binx, ww);
+                int64_t v = l[xs];
+                for (long x = xs+1; x<xe; x++)
+                    v = mode==VIEWPORT_MAX ? std::max(v, l[x]) : v+l[x];
+                o[ox] = (int32_t) std::min(v, (int64_t) maxval);
+            }
+        }
+        return 0;
+    }
+    
+    long DecimateMinMax(const int32_t* data, long n, long buckets, std::vector<int32_t>& out) {
+        if (data==NULL || n<=0 || buckets<=0)
+            return -1;
+        buckets = std::min(buckets, n);
+        out.resize(2*buckets);
+        for (long i = 0; i<buckets; i++) {
+            long s = (long) ((long long) i*n/buckets);
+            long e = (long) ((long long) (i+1)*n/buckets);
+            // branch-free reductions over contiguous bins, vectorized by the compiler
+            int32_t vmin = data[s], vmax = data[s];
+            for (long j = s+1; j<e; j++) {
+                vmin = std::min(vmin, data[j]);
+                vmax = std::max(vmax, data[j]);
+            }
+            out[2*i] = vmin;
+            out[2*i+1] = vmax;
+        }
+        return buckets;
+    }
+    
+    bool ViewportModeFromString(const std::string& s, ViewportMode& mode) {
+        if (s.compare("sum")==0)
+            mode = VIEWPORT_SUM;
+        else if (s.compare("max")==0)
+            mode = VIEWPORT_MAX;
+        else if (s.compare("sample")==0)
+            mode = VIEWPORT_SAMPLE;
+        else
+            return false;
+        return true;
+    }
+    
+    std::string ViewportModeToString(ViewportMode mode) {
+        switch (mode) {
+            case VIEWPORT_MAX:    return "max";
+            case VIEWPORT_SAMPLE: return "sample";
+            default:              return "sum";
+        }
+    }
+    
+}
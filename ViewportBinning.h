@@ -0,0 +1,74 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2016-2018 Surface Concept GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/* 
+ * File:   ViewportBinning.h
+ *
+ * Reduction of image regions and long spectra to screen size
+ */
+
+#ifndef VIEWPORTBINNING_H
+#define	VIEWPORTBINNING_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace SurfaceConceptTDC_ns {
+
+    enum ViewportMode {
+        VIEWPORT_SUM    = 0,  // sum of the pixels of a bin (saturates at the DevLong maximum)
+        VIEWPORT_MAX    = 1,  // maximum of the pixels of a bin, keeps isolated peaks visible
+        VIEWPORT_SAMPLE = 2   // first pixel of a bin (decimation)
+    };
+    
+    /**
+     * Bin the region [x1,x2] x [y1,y2] (limits included) of a row-major image
+     * with integer factors, so that the result is not larger than maxw x maxh.
+     * The region is clipped to the image.
+     * @param src      source image with srcw x srch pixels
+     * @param out      result with outw x outh pixels (resized)
+     * @param binx     bin factor that was used in x (out)
+     * @param biny     bin factor that was used in y (out)
+     * @return         0 if successful, -1 if the region is empty or the arguments are illegal
+     */
+    int BinImageRegion(const int32_t* src, long srcw, long srch, long x1, long y1, long x2, long y2,
+            long maxw, long maxh, ViewportMode mode, std::vector<int32_t>& out, long& outw, long& outh,
+            long& binx, long& biny);
+    
+    /**
+     * Reduce a spectrum to the minimum and maximum of each of (at most)
+     * buckets equally sized buckets, so that narrow peaks stay visible.
+     * Bucket i covers the bins [i*n/buckets, (i+1)*n/buckets).
+     * @param out      min0, max0, min1, max1, ... (resized to twice the number of buckets)
+     * @return         number of buckets, -1 if the arguments are illegal
+     */
+    long DecimateMinMax(const int32_t* data, long n, long buckets, std::vector<int32_t>& out);
+    
+    // "sum", "max", "sample" <-> ViewportMode, returns false for unknown names
+    bool ViewportModeFromString(const std::string& s, ViewportMode& mode);
+    std::string ViewportModeToString(ViewportMode mode);
+    
+}
+
+#endif	/* VIEWPORTBINNING_H */